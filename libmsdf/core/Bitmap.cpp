@@ -83,5 +83,6 @@ void Bitmap<T>::place(int x, int y, const Bitmap<T>& src )
 
 template class Bitmap<float>;
 template class Bitmap<FloatRGB>;
+template class Bitmap<FloatRGBA>;
 
 }
@@ -41,6 +41,18 @@ FontHandle * loadFont(FreetypeHandle *library, const char *filename) {
     return handle;
 }
 
+FontHandle * loadFontData(FreetypeHandle *library, const unsigned char *data, long size) {
+    if (!library)
+        return NULL;
+    FontHandle *handle = new FontHandle;
+    FT_Error error = FT_New_Memory_Face(library->library, data, size, 0, &handle->face);
+    if (error) {
+        delete handle;
+        return NULL;
+    }
+    return handle;
+}
+
 void destroyFont(FontHandle *font) {
     FT_Done_Face(font->face);
     delete font;
@@ -63,7 +75,7 @@ bool getFontWhitespaceWidth(double &spaceAdvance, double &tabAdvance, FontHandle
     return true;
 }
 
-bool loadGlyph(Shape &output, FontHandle *font, int unicode, double *advance) {
+static bool readOutline(Shape &output, FontHandle *font, double *advance) {
     enum PointType {
         NONE = 0,
         PATH_POINT,
@@ -72,11 +84,6 @@ bool loadGlyph(Shape &output, FontHandle *font, int unicode, double *advance) {
         CUBIC_POINT2
     };
 
-    if (!font)
-        return false;
-    FT_Error error = FT_Load_Char(font->face, unicode, FT_LOAD_NO_SCALE);
-    if (error)
-        return false;
     output.contours.clear();
     output.inverseYAxis = false;
     if (advance)
@@ -163,6 +170,24 @@ bool loadGlyph(Shape &output, FontHandle *font, int unicode, double *advance) {
     return true;
 }
 
+bool loadGlyph(Shape &output, FontHandle *font, int unicode, double *advance) {
+    if (!font)
+        return false;
+    FT_Error error = FT_Load_Char(font->face, unicode, FT_LOAD_NO_SCALE);
+    if (error)
+        return false;
+    return readOutline(output, font, advance);
+}
+
+bool loadGlyphByIndex(Shape &output, FontHandle *font, unsigned glyphIndex, double *advance) {
+    if (!font)
+        return false;
+    FT_Error error = FT_Load_Glyph(font->face, glyphIndex, FT_LOAD_NO_SCALE);
+    if (error)
+        return false;
+    return readOutline(output, font, advance);
+}
+
 bool getKerning(double &output, FontHandle *font, int unicode1, int unicode2) {
     FT_Vector kerning;
     if (FT_Get_Kerning(font->face, FT_Get_Char_Index(font->face, unicode1), FT_Get_Char_Index(font->face, unicode2), FT_KERNING_UNSCALED, &kerning)) {
@@ -29,6 +29,8 @@ FreetypeHandle * initializeFreetype();
 void deinitializeFreetype(FreetypeHandle *library);
 /// Loads a font file and returns its handle
 FontHandle * loadFont(FreetypeHandle *library, const char *filename);
+/// Loads a font from memory. The data must outlive the returned handle
+FontHandle * loadFontData(FreetypeHandle *library, const unsigned char *data, long size);
 /// Unloads a font file
 void destroyFont(FontHandle *font);
 /// Returns the size of one EM in the font's coordinate system
@@ -37,6 +39,8 @@ bool getFontScale(double &output, FontHandle *font);
 bool getFontWhitespaceWidth(double &spaceAdvance, double &tabAdvance, FontHandle *font);
 /// Loads the shape prototype of a glyph from font file
 bool loadGlyph(Shape &output, FontHandle *font, int unicode, double *advance = NULL);
+/// Loads the shape prototype of a glyph by its index in the font rather than by character
+bool loadGlyphByIndex(Shape &output, FontHandle *font, unsigned glyphIndex, double *advance = NULL);
 /// Returns the kerning distance adjustment between two specific glyphs.
 bool getKerning(double &output, FontHandle *font, int unicode1, int unicode2);
 
@@ -0,0 +1,1146 @@
+#include "import-sfnt.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace msdfgen {
+
+#define REQUIRE(cond) { if (!(cond)) return false; }
+
+// loadGlyph divides FreeType's unscaled outlines by 64 as if they were 26.6, so do the same here to get identical shapes
+static const double OUTLINE_SCALE = 1./64.;
+// composite glyphs and charstring subroutines nest, real fonts stay well below these
+static const int MAX_COMPOSITE_DEPTH = 16;
+static const int MAX_SUBR_DEPTH = 10;
+static const int CHARSTRING_STACK_SIZE = 48;
+
+static unsigned readU16(const unsigned char *p) {
+    return unsigned(p[0])<<8 | p[1];
+}
+
+static int readS16(const unsigned char *p) {
+    return (short) readU16(p);
+}
+
+static unsigned long readU32(const unsigned char *p) {
+    return (unsigned long) p[0]<<24 | (unsigned long) p[1]<<16 | (unsigned long) p[2]<<8 | p[3];
+}
+
+static unsigned long readOffset(const unsigned char *p, unsigned offSize) {
+    unsigned long offset = 0;
+    for (unsigned i = 0; i < offSize; ++i)
+        offset = offset<<8 | p[i];
+    return offset;
+}
+
+struct SfntTable {
+    const unsigned char *data;
+    size_t size;
+};
+
+/// A CFF INDEX, an array of variable length objects
+struct CffIndex {
+    const unsigned char *offsets;
+    /// Offsets are relative to the byte before the first object
+    const unsigned char *base;
+    unsigned count;
+    unsigned offSize;
+};
+
+class SfntFont {
+public:
+    unsigned numGlyphs;
+    unsigned numHMetrics;
+    SfntTable hmtx;
+    /// The Unicode subtable of the cmap, format 4 or 12
+    SfntTable cmap;
+    unsigned cmapFormat;
+
+    bool cff;
+    // TrueType outlines
+    SfntTable loca, glyf;
+    bool longLoca;
+    // CFF outlines
+    const unsigned char *cffEnd;
+    CffIndex charStrings;
+    CffIndex globalSubrs;
+    /// Local subroutines of each font dict, or of the only private dict when not CID-keyed
+    std::vector<CffIndex> localSubrs;
+    /// NULL when not CID-keyed
+    const unsigned char *fdSelect;
+};
+
+static bool parseCffIndex(CffIndex &index, const unsigned char *p, const unsigned char *end, const unsigned char **next) {
+    REQUIRE(end-p >= 2);
+    index.count = readU16(p);
+    if (index.count == 0) {
+        index.offsets = NULL;
+        index.base = NULL;
+        index.offSize = 0;
+        if (next)
+            *next = p+2;
+        return true;
+    }
+    REQUIRE(end-p >= 3);
+    index.offSize = p[2];
+    REQUIRE(index.offSize >= 1 && index.offSize <= 4);
+    index.offsets = p+3;
+    REQUIRE(size_t(end-index.offsets) >= size_t(index.count+1)*index.offSize);
+    index.base = index.offsets+(index.count+1)*index.offSize-1;
+    unsigned long dataSize = readOffset(index.offsets+index.count*index.offSize, index.offSize);
+    REQUIRE(dataSize >= 1 && dataSize <= size_t(end-index.base));
+    if (next)
+        *next = index.base+dataSize;
+    return true;
+}
+
+static bool getCffObject(const CffIndex &index, unsigned i, const unsigned char *&data, size_t &size) {
+    REQUIRE(i < index.count);
+    unsigned long start = readOffset(index.offsets+i*index.offSize, index.offSize);
+    unsigned long end = readOffset(index.offsets+(i+1)*index.offSize, index.offSize);
+    unsigned long last = readOffset(index.offsets+index.count*index.offSize, index.offSize);
+    REQUIRE(start >= 1 && start <= end && end <= last);
+    data = index.base+start;
+    size = end-start;
+    return true;
+}
+
+/// Looks up one operator in a CFF DICT. Two byte operators are given as 1200+n. Returns the number of operands, or -1 if the operator isn't there
+static int findCffDictOperator(const unsigned char *p, const unsigned char *end, int op, double *operands, int maxOperands) {
+    int count = 0;
+    while (p < end) {
+        unsigned b0 = *p++;
+        if (b0 <= 21) {
+            int current = b0;
+            if (b0 == 12) {
+                if (p >= end)
+                    return -1;
+                current = 1200+*p++;
+            }
+            if (current == op)
+                return count;
+            count = 0;
+            continue;
+        }
+
+        double value;
+        if (b0 == 28) {
+            if (end-p < 2)
+                return -1;
+            value = readS16(p);
+            p += 2;
+        } else if (b0 == 29) {
+            if (end-p < 4)
+                return -1;
+            value = (double) (int) readU32(p);
+            p += 4;
+        } else if (b0 == 30) {
+            // real number, packed as nibbles
+            char buffer[64];
+            size_t length = 0;
+            bool done = false;
+            while (!done && p < end) {
+                unsigned nibbles[2] = { unsigned(*p>>4), unsigned(*p&0xf) };
+                ++p;
+                for (int i = 0; i < 2 && !done; ++i) {
+                    const char *text = "";
+                    switch (nibbles[i]) {
+                        case 0xa: text = "."; break;
+                        case 0xb: text = "E"; break;
+                        case 0xc: text = "E-"; break;
+                        case 0xe: text = "-"; break;
+                        case 0xf: done = true; break;
+                        case 0xd: break;
+                        default: buffer[length < sizeof(buffer)-1 ? length++ : length] = char('0'+nibbles[i]); break;
+                    }
+                    for (; *text && length < sizeof(buffer)-1; ++text)
+                        buffer[length++] = *text;
+                }
+            }
+            buffer[length] = '\0';
+            value = strtod(buffer, NULL);
+        } else if (b0 >= 32 && b0 <= 246) {
+            value = int(b0)-139;
+        } else if (b0 >= 247 && b0 <= 250) {
+            if (p >= end)
+                return -1;
+            value = (int(b0)-247)*256+*p+++108;
+        } else if (b0 >= 251 && b0 <= 254) {
+            if (p >= end)
+                return -1;
+            value = -(int(b0)-251)*256-*p++-108;
+        } else {
+            return -1;
+        }
+
+        if (count < maxOperands)
+            operands[count] = value;
+        ++count;
+    }
+    return -1;
+}
+
+/// Reads the local subroutines of a private dict, which the dict's Subrs operator points to relative to its own start
+static bool parseCffPrivateDict(CffIndex &subrs, const unsigned char *cff, const unsigned char *end, const double *privateOperands) {
+    subrs.count = 0;
+    REQUIRE(privateOperands[0] >= 0 && privateOperands[1] >= 0 && privateOperands[0]+privateOperands[1] <= end-cff);
+    const unsigned char *privateDict = cff+size_t(privateOperands[1]);
+    const unsigned char *privateEnd = privateDict+size_t(privateOperands[0]);
+    double subrsOffset;
+    if (findCffDictOperator(privateDict, privateEnd, 19, &subrsOffset, 1) == 1) {
+        REQUIRE(subrsOffset >= 0 && subrsOffset < end-privateDict);
+        REQUIRE(parseCffIndex(subrs, privateDict+size_t(subrsOffset), end, NULL));
+    }
+    return true;
+}
+
+static bool parseCff(SfntFont &font, const unsigned char *cff, size_t size) {
+    const unsigned char *end = cff+size;
+    REQUIRE(size >= 4 && cff[0] == 1);
+    font.cffEnd = end;
+
+    CffIndex names, topDicts, strings;
+    const unsigned char *p = cff+cff[2];
+    REQUIRE(p < end);
+    REQUIRE(parseCffIndex(names, p, end, &p));
+    REQUIRE(parseCffIndex(topDicts, p, end, &p));
+    REQUIRE(parseCffIndex(strings, p, end, &p));
+    REQUIRE(parseCffIndex(font.globalSubrs, p, end, &p));
+
+    const unsigned char *topDict;
+    size_t topDictSize;
+    REQUIRE(getCffObject(topDicts, 0, topDict, topDictSize));
+    const unsigned char *topDictEnd = topDict+topDictSize;
+
+    double operands[4];
+    if (findCffDictOperator(topDict, topDictEnd, 1206, operands, 1) == 1)
+        REQUIRE(operands[0] == 2);
+
+    REQUIRE(findCffDictOperator(topDict, topDictEnd, 17, operands, 1) == 1);
+    REQUIRE(operands[0] > 0 && operands[0] < size);
+    REQUIRE(parseCffIndex(font.charStrings, cff+size_t(operands[0]), end, NULL));
+    REQUIRE(font.charStrings.count >= font.numGlyphs);
+
+    font.fdSelect = NULL;
+    if (findCffDictOperator(topDict, topDictEnd, 1230, operands, 3) >= 0) {
+        // CID-keyed, every glyph picks its private dict through FDSelect
+        CffIndex fontDicts;
+        REQUIRE(findCffDictOperator(topDict, topDictEnd, 1236, operands, 1) == 1);
+        REQUIRE(operands[0] > 0 && operands[0] < size);
+        REQUIRE(parseCffIndex(fontDicts, cff+size_t(operands[0]), end, NULL));
+        REQUIRE(findCffDictOperator(topDict, topDictEnd, 1237, operands, 1) == 1);
+        REQUIRE(operands[0] > 0 && operands[0] < size);
+        font.fdSelect = cff+size_t(operands[0]);
+
+        font.localSubrs.resize(fontDicts.count);
+        for (unsigned i = 0; i < fontDicts.count; ++i) {
+            const unsigned char *fontDict;
+            size_t fontDictSize;
+            REQUIRE(getCffObject(fontDicts, i, fontDict, fontDictSize));
+            font.localSubrs[i].count = 0;
+            if (findCffDictOperator(fontDict, fontDict+fontDictSize, 18, operands, 2) == 2)
+                REQUIRE(parseCffPrivateDict(font.localSubrs[i], cff, end, operands));
+        }
+    } else {
+        font.localSubrs.resize(1);
+        font.localSubrs[0].count = 0;
+        if (findCffDictOperator(topDict, topDictEnd, 18, operands, 2) == 2)
+            REQUIRE(parseCffPrivateDict(font.localSubrs[0], cff, end, operands));
+    }
+
+    return true;
+}
+
+static bool selectCmap(SfntFont &font, SfntTable cmap) {
+    REQUIRE(cmap.size >= 4);
+    unsigned numTables = readU16(cmap.data+2);
+    REQUIRE(cmap.size >= 4+8*size_t(numTables));
+
+    // like FreeType, prefer a subtable that covers all of Unicode over one limited to the BMP
+    int bestScore = 0;
+    for (unsigned i = 0; i < numTables; ++i) {
+        const unsigned char *record = cmap.data+4+8*i;
+        unsigned platform = readU16(record);
+        unsigned encoding = readU16(record+2);
+        unsigned long offset = readU32(record+4);
+        if (offset+4 > cmap.size)
+            continue;
+
+        const unsigned char *subtable = cmap.data+offset;
+        unsigned format = readU16(subtable);
+        bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+        int score = !unicode ? 0 : format == 12 ? 2 : format == 4 ? 1 : 0;
+        if (score <= bestScore)
+            continue;
+
+        size_t length = format == 12 ? (offset+16 <= cmap.size ? readU32(subtable+4) : 0) : readU16(subtable+2);
+        if (length < 16 || offset+length > cmap.size)
+            continue;
+
+        font.cmap.data = subtable;
+        font.cmap.size = length;
+        font.cmapFormat = format;
+        bestScore = score;
+    }
+
+    return bestScore > 0;
+}
+
+SfntFont * loadSfnt(const unsigned char *data, size_t size) {
+    if (!data || size < 12)
+        return NULL;
+
+    // collections use their first font, like FreeType does for face index 0
+    const unsigned char *directory = data;
+    if (readU32(data) == 0x74746366ul) { // 'ttcf'
+        if (size < 16 || readU32(data+8) == 0 || readU32(data+12) > size-12)
+            return NULL;
+        directory = data+readU32(data+12);
+    }
+
+    unsigned long version = readU32(directory);
+    if (version != 0x00010000ul && version != 0x74727565ul && version != 0x4f54544ful) // 1.0, 'true', 'OTTO'
+        return NULL;
+
+    unsigned numTables = readU16(directory+4);
+    if (size_t(directory-data)+12+16*size_t(numTables) > size)
+        return NULL;
+
+    SfntTable head = { }, maxp = { }, hhea = { }, hmtx = { }, cmap = { }, loca = { }, glyf = { }, cff = { };
+    for (unsigned i = 0; i < numTables; ++i) {
+        const unsigned char *record = directory+12+16*i;
+        unsigned long offset = readU32(record+8);
+        unsigned long length = readU32(record+12);
+        if (offset > size || length > size-offset)
+            continue;
+
+        SfntTable table = { data+offset, length };
+        switch (readU32(record)) {
+            case 0x68656164ul: head = table; break; // 'head'
+            case 0x6d617870ul: maxp = table; break; // 'maxp'
+            case 0x68686561ul: hhea = table; break; // 'hhea'
+            case 0x686d7478ul: hmtx = table; break; // 'hmtx'
+            case 0x636d6170ul: cmap = table; break; // 'cmap'
+            case 0x6c6f6361ul: loca = table; break; // 'loca'
+            case 0x676c7966ul: glyf = table; break; // 'glyf'
+            case 0x43464620ul: cff = table; break;  // 'CFF '
+        }
+    }
+
+    if (head.size < 54 || maxp.size < 6 || hhea.size < 36 || !hmtx.data || !cmap.data)
+        return NULL;
+
+    SfntFont *font = new SfntFont;
+    font->numGlyphs = readU16(maxp.data+4);
+    font->numHMetrics = readU16(hhea.data+34);
+    font->hmtx = hmtx;
+    font->cff = cff.data != NULL;
+    font->loca = loca;
+    font->glyf = glyf;
+    font->longLoca = readS16(head.data+50) != 0;
+    font->fdSelect = NULL;
+
+    bool ok = font->numHMetrics >= 1 && hmtx.size >= 4*size_t(font->numHMetrics) && selectCmap(*font, cmap);
+    if (ok && font->cff)
+        ok = parseCff(*font, cff.data, cff.size);
+    else if (ok)
+        ok = glyf.data && loca.size >= (font->longLoca ? 4 : 2)*(size_t(font->numGlyphs)+1);
+
+    if (!ok) {
+        delete font;
+        return NULL;
+    }
+    return font;
+}
+
+void destroySfnt(SfntFont *font) {
+    delete font;
+}
+
+unsigned getSfntGlyphCount(const SfntFont *font) {
+    return font->numGlyphs;
+}
+
+static unsigned lookupCmap(const SfntFont *font, unsigned unicode) {
+    const unsigned char *cmap = font->cmap.data;
+
+    if (font->cmapFormat == 12) {
+        unsigned long numGroups = readU32(cmap+12);
+        if (numGroups > (font->cmap.size-16)/12)
+            return 0;
+        unsigned long lo = 0, hi = numGroups;
+        while (lo < hi) {
+            unsigned long mid = (lo+hi)/2;
+            const unsigned char *group = cmap+16+12*mid;
+            if (unicode < readU32(group))
+                hi = mid;
+            else if (unicode > readU32(group+4))
+                lo = mid+1;
+            else
+                return unsigned(readU32(group+8)+(unicode-readU32(group)));
+        }
+        return 0;
+    }
+
+    if (unicode > 0xffff)
+        return 0;
+    unsigned segCount = readU16(cmap+6)/2;
+    if (16+8*size_t(segCount) > font->cmap.size)
+        return 0;
+    const unsigned char *endCodes = cmap+14;
+    const unsigned char *startCodes = endCodes+2*segCount+2;
+    const unsigned char *deltas = startCodes+2*segCount;
+    const unsigned char *rangeOffsets = deltas+2*segCount;
+
+    unsigned lo = 0, hi = segCount;
+    while (lo < hi) {
+        unsigned mid = (lo+hi)/2;
+        if (readU16(endCodes+2*mid) < unicode)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    if (lo == segCount || readU16(startCodes+2*lo) > unicode)
+        return 0;
+
+    unsigned delta = readU16(deltas+2*lo);
+    unsigned rangeOffset = readU16(rangeOffsets+2*lo);
+    if (rangeOffset == 0)
+        return (unicode+delta)&0xffff;
+
+    const unsigned char *glyph = rangeOffsets+2*lo+rangeOffset+2*(unicode-readU16(startCodes+2*lo));
+    if (glyph+2 > font->cmap.data+font->cmap.size)
+        return 0;
+    unsigned index = readU16(glyph);
+    return index ? (index+delta)&0xffff : 0;
+}
+
+unsigned getSfntGlyphIndex(const SfntFont *font, unsigned unicode) {
+    unsigned index = lookupCmap(font, unicode);
+    return index < font->numGlyphs ? index : 0;
+}
+
+static unsigned getAdvanceWidth(const SfntFont *font, unsigned glyphIndex) {
+    unsigned metric = glyphIndex < font->numHMetrics ? glyphIndex : font->numHMetrics-1;
+    return readU16(font->hmtx.data+4*metric);
+}
+
+static int getLeftSideBearing(const SfntFont *font, unsigned glyphIndex) {
+    if (glyphIndex < font->numHMetrics)
+        return readS16(font->hmtx.data+4*glyphIndex+2);
+    size_t offset = 4*size_t(font->numHMetrics)+2*size_t(glyphIndex-font->numHMetrics);
+    return offset+2 <= font->hmtx.size ? readS16(font->hmtx.data+offset) : 0;
+}
+
+// TrueType outlines are collected into a flat point list first, since composite glyphs need to transform and
+// match points of their components before anything can be turned into edges
+
+struct OutlinePoint {
+    long x, y;
+    bool onCurve;
+};
+
+struct TrueTypeOutline {
+    std::vector<OutlinePoint> points;
+    std::vector<size_t> contourEnds;
+};
+
+/// 16.16 multiplication rounding the same way as FreeType's FT_MulFix
+static long mulFix(long a, long b) {
+    bool negative = (a < 0) != (b < 0);
+    long long c = ((long long) std::labs(a)*std::labs(b)+0x8000)>>16;
+    return long(negative ? -c : c);
+}
+
+/// The horizontal metrics FreeType ends up using for a glyph. Composites inherit them from a component flagged
+/// with USE_MY_METRICS, otherwise they come from the glyph's own hmtx entry and bounding box
+struct TrueTypeMetrics {
+    unsigned advanceWidth;
+    /// Moves the outline so its origin is where hmtx puts it, which only matters when the left side bearing
+    /// disagrees with the bounding box
+    long originShift;
+};
+
+static bool loadTrueTypeGlyph(TrueTypeOutline &outline, const SfntFont *font, unsigned glyphIndex, TrueTypeMetrics &metrics, int depth);
+
+static bool loadSimpleGlyph(TrueTypeOutline &outline, const unsigned char *p, const unsigned char *glyphEnd, int numContours) {
+    REQUIRE(size_t(glyphEnd-p) >= 2*size_t(numContours)+2);
+    size_t base = outline.points.size();
+    size_t numPoints = 0;
+    for (int i = 0; i < numContours; ++i) {
+        size_t contourEnd = readU16(p+2*i);
+        REQUIRE(contourEnd+1 >= numPoints);
+        numPoints = contourEnd+1;
+        outline.contourEnds.push_back(base+contourEnd);
+    }
+    p += 2*numContours;
+    p += 2+readU16(p);
+    REQUIRE(p <= glyphEnd);
+
+    outline.points.resize(base+numPoints);
+    OutlinePoint *points = &outline.points[base];
+
+    std::vector<unsigned char> flags(numPoints);
+    for (size_t i = 0; i < numPoints;) {
+        REQUIRE(p < glyphEnd);
+        unsigned char flag = *p++;
+        unsigned repeat = 0;
+        if (flag&0x08) {
+            REQUIRE(p < glyphEnd);
+            repeat = *p++;
+        }
+        for (unsigned r = 0; r <= repeat; ++r) {
+            REQUIRE(i < numPoints);
+            flags[i++] = flag;
+        }
+    }
+
+    long x = 0;
+    for (size_t i = 0; i < numPoints; ++i) {
+        if (flags[i]&0x02) {
+            REQUIRE(p < glyphEnd);
+            x += flags[i]&0x10 ? *p : -long(*p);
+            ++p;
+        } else if (!(flags[i]&0x10)) {
+            REQUIRE(glyphEnd-p >= 2);
+            x += readS16(p);
+            p += 2;
+        }
+        points[i].x = x;
+        points[i].onCurve = (flags[i]&0x01) != 0;
+    }
+
+    long y = 0;
+    for (size_t i = 0; i < numPoints; ++i) {
+        if (flags[i]&0x04) {
+            REQUIRE(p < glyphEnd);
+            y += flags[i]&0x20 ? *p : -long(*p);
+            ++p;
+        } else if (!(flags[i]&0x20)) {
+            REQUIRE(glyphEnd-p >= 2);
+            y += readS16(p);
+            p += 2;
+        }
+        points[i].y = y;
+    }
+    return true;
+}
+
+/// Composite glyph component flags
+enum {
+    ARG_1_AND_2_ARE_WORDS = 0x0001,
+    ARGS_ARE_XY_VALUES = 0x0002,
+    WE_HAVE_A_SCALE = 0x0008,
+    MORE_COMPONENTS = 0x0020,
+    WE_HAVE_AN_X_AND_Y_SCALE = 0x0040,
+    WE_HAVE_A_TWO_BY_TWO = 0x0080,
+    USE_MY_METRICS = 0x0200,
+    SCALED_COMPONENT_OFFSET = 0x0800,
+    UNSCALED_COMPONENT_OFFSET = 0x1000
+};
+
+static bool loadCompositeGlyph(TrueTypeOutline &outline, const SfntFont *font, const unsigned char *p, const unsigned char *glyphEnd, TrueTypeMetrics &metrics, int depth) {
+    size_t compositeBase = outline.points.size();
+    unsigned flags;
+    do {
+        REQUIRE(glyphEnd-p >= 4);
+        flags = readU16(p);
+        unsigned component = readU16(p+2);
+        p += 4;
+
+        long arg1, arg2;
+        if (flags&ARG_1_AND_2_ARE_WORDS) {
+            REQUIRE(glyphEnd-p >= 4);
+            arg1 = flags&ARGS_ARE_XY_VALUES ? readS16(p) : long(readU16(p));
+            arg2 = flags&ARGS_ARE_XY_VALUES ? readS16(p+2) : long(readU16(p+2));
+            p += 4;
+        } else {
+            REQUIRE(glyphEnd-p >= 2);
+            arg1 = flags&ARGS_ARE_XY_VALUES ? (signed char) p[0] : long(p[0]);
+            arg2 = flags&ARGS_ARE_XY_VALUES ? (signed char) p[1] : long(p[1]);
+            p += 2;
+        }
+
+        // 2.14 matrix, kept in 16.16 like FreeType
+        long xx = 0x10000, xy = 0, yx = 0, yy = 0x10000;
+        if (flags&WE_HAVE_A_SCALE) {
+            REQUIRE(glyphEnd-p >= 2);
+            xx = yy = long(readS16(p))*4;
+            p += 2;
+        } else if (flags&WE_HAVE_AN_X_AND_Y_SCALE) {
+            REQUIRE(glyphEnd-p >= 4);
+            xx = long(readS16(p))*4;
+            yy = long(readS16(p+2))*4;
+            p += 4;
+        } else if (flags&WE_HAVE_A_TWO_BY_TWO) {
+            REQUIRE(glyphEnd-p >= 8);
+            xx = long(readS16(p))*4;
+            yx = long(readS16(p+2))*4;
+            xy = long(readS16(p+4))*4;
+            yy = long(readS16(p+6))*4;
+            p += 8;
+        }
+
+        size_t componentBase = outline.points.size();
+        TrueTypeMetrics componentMetrics;
+        REQUIRE(loadTrueTypeGlyph(outline, font, component, componentMetrics, depth+1));
+        if (flags&USE_MY_METRICS)
+            metrics = componentMetrics;
+
+        if (xx != 0x10000 || xy != 0 || yx != 0 || yy != 0x10000) {
+            for (size_t i = componentBase; i < outline.points.size(); ++i) {
+                OutlinePoint &point = outline.points[i];
+                long x = mulFix(point.x, xx)+mulFix(point.y, xy);
+                long y = mulFix(point.x, yx)+mulFix(point.y, yy);
+                point.x = x;
+                point.y = y;
+            }
+        }
+
+        long dx, dy;
+        if (flags&ARGS_ARE_XY_VALUES) {
+            dx = arg1;
+            dy = arg2;
+            if ((flags&SCALED_COMPONENT_OFFSET) && !(flags&UNSCALED_COMPONENT_OFFSET)) {
+                dx = long(floor(dx*sqrt(double(xx)*xx+double(xy)*xy)/65536.+.5));
+                dy = long(floor(dy*sqrt(double(yy)*yy+double(yx)*yx)/65536.+.5));
+            }
+        } else {
+            // align a point of the component with a point of the glyph so far
+            size_t parentPoint = compositeBase+size_t(arg1);
+            size_t childPoint = componentBase+size_t(arg2);
+            REQUIRE(parentPoint < componentBase && childPoint < outline.points.size());
+            dx = outline.points[parentPoint].x-outline.points[childPoint].x;
+            dy = outline.points[parentPoint].y-outline.points[childPoint].y;
+        }
+
+        if (dx != 0 || dy != 0) {
+            for (size_t i = componentBase; i < outline.points.size(); ++i) {
+                outline.points[i].x += dx;
+                outline.points[i].y += dy;
+            }
+        }
+    } while (flags&MORE_COMPONENTS);
+
+    return true;
+}
+
+/// Finds a glyph's entry in the glyf table. Empty glyphs leave p at NULL
+static bool locateTrueTypeGlyph(const unsigned char *&p, const unsigned char *&glyphEnd, const SfntFont *font, unsigned glyphIndex) {
+    size_t start, end;
+    if (font->longLoca) {
+        start = readU32(font->loca.data+4*glyphIndex);
+        end = readU32(font->loca.data+4*glyphIndex+4);
+    } else {
+        start = 2*size_t(readU16(font->loca.data+2*glyphIndex));
+        end = 2*size_t(readU16(font->loca.data+2*glyphIndex+2));
+    }
+    p = glyphEnd = NULL;
+    if (start >= end)
+        return true;
+    REQUIRE(end <= font->glyf.size && end-start >= 10);
+    p = font->glyf.data+start;
+    glyphEnd = font->glyf.data+end;
+    return true;
+}
+
+static bool loadTrueTypeGlyph(TrueTypeOutline &outline, const SfntFont *font, unsigned glyphIndex, TrueTypeMetrics &metrics, int depth) {
+    REQUIRE(glyphIndex < font->numGlyphs && depth < MAX_COMPOSITE_DEPTH);
+    metrics.advanceWidth = getAdvanceWidth(font, glyphIndex);
+    metrics.originShift = getLeftSideBearing(font, glyphIndex);
+
+    const unsigned char *p, *glyphEnd;
+    REQUIRE(locateTrueTypeGlyph(p, glyphEnd, font, glyphIndex));
+    if (!p)
+        return true;
+    int numContours = readS16(p);
+    int xMin = readS16(p+2);
+    p += 10;
+
+    metrics.originShift -= xMin;
+    if (numContours >= 0)
+        return loadSimpleGlyph(outline, p, glyphEnd, numContours);
+    return loadCompositeGlyph(outline, font, p, glyphEnd, metrics, depth);
+}
+
+/// Turns the point list into edges the same way readOutline does for FreeType outlines, starting each contour
+/// at its first on-curve point and inserting implied on-curve points between consecutive off-curve ones.
+/// Contours without any on-curve point fail the glyph, as they do there
+static bool buildTrueTypeShape(Shape &output, const TrueTypeOutline &outline) {
+    size_t first = 0;
+    for (size_t c = 0; c < outline.contourEnds.size(); ++c) {
+        size_t last = outline.contourEnds[c];
+        if (last >= outline.points.size())
+            break;
+        if (last+1 == first)
+            continue;
+        size_t count = last-first+1;
+
+        size_t firstOnCurve = count;
+        for (size_t i = 0; i < count && firstOnCurve == count; ++i)
+            if (outline.points[first+i].onCurve)
+                firstOnCurve = i;
+        REQUIRE(firstOnCurve < count);
+
+        Contour &contour = output.addContour();
+        Point2 startPoint(OUTLINE_SCALE*outline.points[first+firstOnCurve].x, OUTLINE_SCALE*outline.points[first+firstOnCurve].y);
+        Point2 controlPoint;
+        bool haveControl = false;
+
+        for (size_t k = 1; k <= count; ++k) {
+            const OutlinePoint &source = outline.points[first+(firstOnCurve+k)%count];
+            Point2 point(OUTLINE_SCALE*source.x, OUTLINE_SCALE*source.y);
+            bool onCurve = source.onCurve;
+            if (onCurve) {
+                if (haveControl)
+                    contour.addEdge(new QuadraticSegment(startPoint, controlPoint, point));
+                else
+                    contour.addEdge(new LinearSegment(startPoint, point));
+                startPoint = point;
+                haveControl = false;
+            } else if (haveControl) {
+                Point2 midPoint = .5*controlPoint+.5*point;
+                contour.addEdge(new QuadraticSegment(startPoint, controlPoint, midPoint));
+                startPoint = midPoint;
+                controlPoint = point;
+            } else {
+                controlPoint = point;
+                haveControl = true;
+            }
+        }
+
+        first = last+1;
+    }
+    return true;
+}
+
+// Type 2 charstrings
+
+struct CharstringState {
+    const SfntFont *font;
+    const CffIndex *localSubrs;
+    Shape *output;
+    /// The contour being drawn, NULL until the first segment after a moveto
+    Contour *contour;
+    Point2 start, point;
+    double stack[CHARSTRING_STACK_SIZE];
+    int sp;
+    int stems;
+    bool haveWidth;
+};
+
+static Point2 scaled(const Point2 &point) {
+    return OUTLINE_SCALE*point;
+}
+
+static void closeContour(CharstringState &s) {
+    if (s.contour && s.point != s.start)
+        s.contour->addEdge(new LinearSegment(scaled(s.point), scaled(s.start)));
+    s.contour = NULL;
+}
+
+static void moveTo(CharstringState &s, double dx, double dy) {
+    closeContour(s);
+    s.point += Point2(dx, dy);
+    s.start = s.point;
+}
+
+static void lineTo(CharstringState &s, double dx, double dy) {
+    if (!s.contour)
+        s.contour = &s.output->addContour();
+    Point2 to = s.point+Point2(dx, dy);
+    s.contour->addEdge(new LinearSegment(scaled(s.point), scaled(to)));
+    s.point = to;
+}
+
+static void curveTo(CharstringState &s, double dx1, double dy1, double dx2, double dy2, double dx3, double dy3) {
+    if (!s.contour)
+        s.contour = &s.output->addContour();
+    Point2 p1 = s.point+Point2(dx1, dy1);
+    Point2 p2 = p1+Point2(dx2, dy2);
+    Point2 p3 = p2+Point2(dx3, dy3);
+    s.contour->addEdge(new CubicSegment(scaled(s.point), scaled(p1), scaled(p2), scaled(p3)));
+    s.point = p3;
+}
+
+static int subrBias(const CffIndex &subrs) {
+    return subrs.count < 1240 ? 107 : subrs.count < 33900 ? 1131 : 32768;
+}
+
+/// The first stack clearing operator may carry the advance width as an extra first operand, which is skipped
+/// since the advance comes from hmtx. Returns the index of the first real operand
+static int skipWidth(CharstringState &s, bool hasWidth) {
+    bool skip = !s.haveWidth && hasWidth;
+    s.haveWidth = true;
+    return skip ? 1 : 0;
+}
+
+enum CharstringResult {
+    CHARSTRING_ERROR,
+    CHARSTRING_RETURN,
+    CHARSTRING_ENDCHAR
+};
+
+static CharstringResult runCharstring(CharstringState &s, const unsigned char *p, const unsigned char *end, int depth) {
+    #define CHECK(cond) { if (!(cond)) return CHARSTRING_ERROR; }
+    #define ARG(i) s.stack[base+(i)]
+
+    while (p < end) {
+        unsigned b0 = *p++;
+
+        if (b0 >= 32 || b0 == 28) {
+            double value;
+            if (b0 == 28) {
+                CHECK(end-p >= 2);
+                value = readS16(p);
+                p += 2;
+            } else if (b0 <= 246)
+                value = int(b0)-139;
+            else if (b0 <= 250) {
+                CHECK(p < end);
+                value = (int(b0)-247)*256+*p+++108;
+            } else if (b0 <= 254) {
+                CHECK(p < end);
+                value = -(int(b0)-251)*256-*p++-108;
+            } else {
+                CHECK(end-p >= 4);
+                value = (int) readU32(p)/65536.;
+                p += 4;
+            }
+            CHECK(s.sp < CHARSTRING_STACK_SIZE);
+            s.stack[s.sp++] = value;
+            continue;
+        }
+
+        int base = 0;
+        switch (b0) {
+            case 1: // hstem
+            case 3: // vstem
+            case 18: // hstemhm
+            case 23: // vstemhm
+                base = skipWidth(s, s.sp%2 != 0);
+                s.stems += (s.sp-base)/2;
+                break;
+            case 19: // hintmask
+            case 20: // cntrmask
+                // operands here are an implied vstemhm
+                base = skipWidth(s, s.sp%2 != 0);
+                s.stems += (s.sp-base)/2;
+                CHECK(end-p >= (s.stems+7)/8);
+                p += (s.stems+7)/8;
+                break;
+            case 21: // rmoveto
+                base = skipWidth(s, s.sp > 2);
+                CHECK(s.sp-base >= 2);
+                moveTo(s, ARG(0), ARG(1));
+                break;
+            case 22: // hmoveto
+                base = skipWidth(s, s.sp > 1);
+                CHECK(s.sp-base >= 1);
+                moveTo(s, ARG(0), 0);
+                break;
+            case 4: // vmoveto
+                base = skipWidth(s, s.sp > 1);
+                CHECK(s.sp-base >= 1);
+                moveTo(s, 0, ARG(0));
+                break;
+            case 5: // rlineto
+                for (int i = 0; i+1 < s.sp; i += 2)
+                    lineTo(s, s.stack[i], s.stack[i+1]);
+                break;
+            case 6: // hlineto
+            case 7: // vlineto
+                for (int i = 0; i < s.sp; ++i) {
+                    if ((i%2 == 0) == (b0 == 6))
+                        lineTo(s, s.stack[i], 0);
+                    else
+                        lineTo(s, 0, s.stack[i]);
+                }
+                break;
+            case 8: // rrcurveto
+                for (int i = 0; i+5 < s.sp; i += 6)
+                    curveTo(s, s.stack[i], s.stack[i+1], s.stack[i+2], s.stack[i+3], s.stack[i+4], s.stack[i+5]);
+                break;
+            case 24: { // rcurveline
+                CHECK(s.sp >= 8);
+                int i = 0;
+                for (; i+7 < s.sp; i += 6)
+                    curveTo(s, s.stack[i], s.stack[i+1], s.stack[i+2], s.stack[i+3], s.stack[i+4], s.stack[i+5]);
+                lineTo(s, s.stack[i], s.stack[i+1]);
+                break;
+            }
+            case 25: { // rlinecurve
+                CHECK(s.sp >= 8);
+                int i = 0;
+                for (; i+7 < s.sp; i += 2)
+                    lineTo(s, s.stack[i], s.stack[i+1]);
+                curveTo(s, s.stack[i], s.stack[i+1], s.stack[i+2], s.stack[i+3], s.stack[i+4], s.stack[i+5]);
+                break;
+            }
+            case 26: { // vvcurveto
+                int i = s.sp%2;
+                double dx1 = i ? s.stack[0] : 0;
+                for (; i+3 < s.sp; i += 4) {
+                    curveTo(s, dx1, s.stack[i], s.stack[i+1], s.stack[i+2], 0, s.stack[i+3]);
+                    dx1 = 0;
+                }
+                break;
+            }
+            case 27: { // hhcurveto
+                int i = s.sp%2;
+                double dy1 = i ? s.stack[0] : 0;
+                for (; i+3 < s.sp; i += 4) {
+                    curveTo(s, s.stack[i], dy1, s.stack[i+1], s.stack[i+2], s.stack[i+3], 0);
+                    dy1 = 0;
+                }
+                break;
+            }
+            case 30: // vhcurveto
+            case 31: { // hvcurveto
+                bool horizontal = b0 == 31;
+                for (int i = 0; i+3 < s.sp; i += 4) {
+                    double last = s.sp-i == 5 ? s.stack[i+4] : 0;
+                    if (horizontal)
+                        curveTo(s, s.stack[i], 0, s.stack[i+1], s.stack[i+2], last, s.stack[i+3]);
+                    else
+                        curveTo(s, 0, s.stack[i], s.stack[i+1], s.stack[i+2], s.stack[i+3], last);
+                    horizontal = !horizontal;
+                }
+                break;
+            }
+            case 10: // callsubr
+            case 29: { // callgsubr
+                CHECK(s.sp >= 1 && depth < MAX_SUBR_DEPTH);
+                const CffIndex &subrs = b0 == 10 ? *s.localSubrs : s.font->globalSubrs;
+                int index = int(s.stack[--s.sp])+subrBias(subrs);
+                const unsigned char *subr;
+                size_t subrSize;
+                CHECK(index >= 0 && getCffObject(subrs, unsigned(index), subr, subrSize));
+                CharstringResult result = runCharstring(s, subr, subr+subrSize, depth+1);
+                if (result != CHARSTRING_RETURN)
+                    return result;
+                continue;
+            }
+            case 11: // return
+                return CHARSTRING_RETURN;
+            case 14: // endchar
+                base = skipWidth(s, s.sp == 1 || s.sp == 5);
+                // four more operands is the deprecated seac accent composition
+                CHECK(s.sp-base == 0);
+                closeContour(s);
+                return CHARSTRING_ENDCHAR;
+            case 12: {
+                CHECK(p < end);
+                unsigned b1 = *p++;
+                switch (b1) {
+                    case 0: // dotsection
+                        break;
+                    case 34: // hflex
+                        CHECK(s.sp >= 7);
+                        curveTo(s, s.stack[0], 0, s.stack[1], s.stack[2], s.stack[3], 0);
+                        curveTo(s, s.stack[4], 0, s.stack[5], -s.stack[2], s.stack[6], 0);
+                        break;
+                    case 35: // flex
+                        CHECK(s.sp >= 13);
+                        curveTo(s, s.stack[0], s.stack[1], s.stack[2], s.stack[3], s.stack[4], s.stack[5]);
+                        curveTo(s, s.stack[6], s.stack[7], s.stack[8], s.stack[9], s.stack[10], s.stack[11]);
+                        break;
+                    case 36: // hflex1
+                        CHECK(s.sp >= 9);
+                        curveTo(s, s.stack[0], s.stack[1], s.stack[2], s.stack[3], s.stack[4], 0);
+                        curveTo(s, s.stack[5], 0, s.stack[6], s.stack[7], s.stack[8], -(s.stack[1]+s.stack[3]+s.stack[7]));
+                        break;
+                    case 37: { // flex1
+                        CHECK(s.sp >= 11);
+                        double dx = s.stack[0]+s.stack[2]+s.stack[4]+s.stack[6]+s.stack[8];
+                        double dy = s.stack[1]+s.stack[3]+s.stack[5]+s.stack[7]+s.stack[9];
+                        bool horizontal = std::fabs(dx) > std::fabs(dy);
+                        curveTo(s, s.stack[0], s.stack[1], s.stack[2], s.stack[3], s.stack[4], s.stack[5]);
+                        curveTo(s, s.stack[6], s.stack[7], s.stack[8], s.stack[9], horizontal ? s.stack[10] : -dx, horizontal ? -dy : s.stack[10]);
+                        break;
+                    }
+                    // the arithmetic operators that are simple enough to support, the rest fail the glyph
+                    case 9: // abs
+                        CHECK(s.sp >= 1);
+                        s.stack[s.sp-1] = std::fabs(s.stack[s.sp-1]);
+                        continue;
+                    case 10: // add
+                    case 11: // sub
+                    case 12: // div
+                    case 24: { // mul
+                        CHECK(s.sp >= 2);
+                        double a = s.stack[s.sp-2], b = s.stack[s.sp-1];
+                        CHECK(b1 != 12 || b != 0);
+                        s.stack[s.sp-2] = b1 == 10 ? a+b : b1 == 11 ? a-b : b1 == 12 ? a/b : a*b;
+                        --s.sp;
+                        continue;
+                    }
+                    case 14: // neg
+                        CHECK(s.sp >= 1);
+                        s.stack[s.sp-1] = -s.stack[s.sp-1];
+                        continue;
+                    case 18: // drop
+                        CHECK(s.sp >= 1);
+                        --s.sp;
+                        continue;
+                    case 27: // dup
+                        CHECK(s.sp >= 1 && s.sp < CHARSTRING_STACK_SIZE);
+                        s.stack[s.sp] = s.stack[s.sp-1];
+                        ++s.sp;
+                        continue;
+                    case 28: { // exch
+                        CHECK(s.sp >= 2);
+                        double a = s.stack[s.sp-2];
+                        s.stack[s.sp-2] = s.stack[s.sp-1];
+                        s.stack[s.sp-1] = a;
+                        continue;
+                    }
+                    default:
+                        return CHARSTRING_ERROR;
+                }
+                break;
+            }
+            default:
+                return CHARSTRING_ERROR;
+        }
+        s.sp = 0;
+    }
+
+    return CHARSTRING_RETURN;
+
+    #undef ARG
+    #undef CHECK
+}
+
+static const CffIndex * selectLocalSubrs(const SfntFont *font, unsigned glyphIndex) {
+    if (!font->fdSelect)
+        return &font->localSubrs[0];
+
+    const unsigned char *p = font->fdSelect;
+    const unsigned char *end = font->cffEnd;
+    unsigned fd = ~0u;
+    if (p < end && p[0] == 0) {
+        if (size_t(end-p) > 1+size_t(glyphIndex))
+            fd = p[1+glyphIndex];
+    } else if (end-p >= 3 && p[0] == 3) {
+        unsigned numRanges = readU16(p+1);
+        if (size_t(end-p) >= 5+3*size_t(numRanges)) {
+            for (unsigned i = 0; i < numRanges; ++i) {
+                const unsigned char *range = p+3+3*i;
+                unsigned next = readU16(range+3);
+                if (glyphIndex >= readU16(range) && glyphIndex < next) {
+                    fd = range[2];
+                    break;
+                }
+            }
+        }
+    }
+
+    return fd < font->localSubrs.size() ? &font->localSubrs[fd] : NULL;
+}
+
+static bool loadCffGlyph(Shape &output, const SfntFont *font, unsigned glyphIndex) {
+    const unsigned char *charString;
+    size_t charStringSize;
+    REQUIRE(getCffObject(font->charStrings, glyphIndex, charString, charStringSize));
+
+    CharstringState s;
+    s.font = font;
+    s.localSubrs = selectLocalSubrs(font, glyphIndex);
+    REQUIRE(s.localSubrs);
+    s.output = &output;
+    s.contour = NULL;
+    s.sp = 0;
+    s.stems = 0;
+    s.haveWidth = false;
+
+    CharstringResult result = runCharstring(s, charString, charString+charStringSize, 0);
+    closeContour(s);
+    return result != CHARSTRING_ERROR;
+}
+
+bool loadSfntGlyph(Shape &output, const SfntFont *font, unsigned glyphIndex, double *advance) {
+    if (!font || glyphIndex >= font->numGlyphs)
+        return false;
+
+    output.contours.clear();
+    output.inverseYAxis = false;
+    unsigned advanceWidth = getAdvanceWidth(font, glyphIndex);
+
+    if (font->cff) {
+        REQUIRE(loadCffGlyph(output, font, glyphIndex));
+    } else {
+        // like FreeType, only the metrics of the glyph as a whole move the outline, not those of its components
+        TrueTypeOutline outline;
+        TrueTypeMetrics metrics;
+        REQUIRE(loadTrueTypeGlyph(outline, font, glyphIndex, metrics, 0));
+        if (metrics.originShift != 0) {
+            for (OutlinePoint &point : outline.points)
+                point.x += metrics.originShift;
+        }
+        advanceWidth = metrics.advanceWidth;
+        REQUIRE(buildTrueTypeShape(output, outline));
+    }
+
+    if (advance)
+        *advance = advanceWidth*OUTLINE_SCALE;
+    return true;
+}
+
+bool getSfntGlyphComponents(std::vector<SfntComponent> &components, const SfntFont *font, unsigned glyphIndex) {
+    components.clear();
+    if (!font || font->cff || glyphIndex >= font->numGlyphs)
+        return false;
+
+    const unsigned char *p, *glyphEnd;
+    REQUIRE(locateTrueTypeGlyph(p, glyphEnd, font, glyphIndex));
+    if (!p || readS16(p) >= 0)
+        return false;
+    p += 10;
+
+    // where loadSfntGlyph puts the composite's origin, so offsets can be made relative to it
+    TrueTypeOutline scratch;
+    TrueTypeMetrics metrics;
+    REQUIRE(loadTrueTypeGlyph(scratch, font, glyphIndex, metrics, 0));
+
+    unsigned flags;
+    do {
+        REQUIRE(glyphEnd-p >= 4);
+        flags = readU16(p);
+        unsigned component = readU16(p+2);
+        p += 4;
+        // only plain translations can be drawn as a copy of the component
+        REQUIRE(flags&ARGS_ARE_XY_VALUES);
+        REQUIRE(!(flags&(WE_HAVE_A_SCALE|WE_HAVE_AN_X_AND_Y_SCALE|WE_HAVE_A_TWO_BY_TWO)));
+
+        long dx, dy;
+        if (flags&ARG_1_AND_2_ARE_WORDS) {
+            REQUIRE(glyphEnd-p >= 4);
+            dx = readS16(p);
+            dy = readS16(p+2);
+            p += 4;
+        } else {
+            REQUIRE(glyphEnd-p >= 2);
+            dx = (signed char) p[0];
+            dy = (signed char) p[1];
+            p += 2;
+        }
+
+        // loaded on its own, the component gets moved by its own metrics rather than the composite's
+        TrueTypeMetrics componentMetrics;
+        scratch.points.clear();
+        scratch.contourEnds.clear();
+        REQUIRE(loadTrueTypeGlyph(scratch, font, component, componentMetrics, 1));
+
+        SfntComponent result;
+        result.glyphIndex = component;
+        result.dx = (dx+metrics.originShift-componentMetrics.originShift)*OUTLINE_SCALE;
+        result.dy = dy*OUTLINE_SCALE;
+        components.push_back(result);
+    } while (flags&MORE_COMPONENTS);
+
+    return true;
+}
+
+}
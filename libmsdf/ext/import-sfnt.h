@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdlib>
+#include <vector>
+#include "../core/Shape.h"
+
+namespace msdfgen {
+
+/// A read-only view of the outlines of a TrueType or CFF flavoured OpenType font in memory.
+/// Glyphs are decoded straight from the glyf/loca or CFF tables without going through FreeType,
+/// and since it holds no mutable state any number of threads can load glyphs from it at once.
+class SfntFont;
+
+/// A component of a composite glyph, placed by translation only
+struct SfntComponent {
+    unsigned glyphIndex;
+    /// Where the component's origin goes, in the same units as loadSfntGlyph's coordinates
+    double dx, dy;
+};
+
+/// Parses the tables needed to load outlines. Returns NULL for fonts it doesn't handle, such as
+/// CFF2, bitmap-only fonts or fonts without a Unicode cmap, in which case FreeType should be used.
+/// The data must outlive the returned font
+SfntFont * loadSfnt(const unsigned char *data, size_t size);
+/// Frees the parsed tables, but not the data they point into
+void destroySfnt(SfntFont *font);
+/// Returns the number of glyphs in the font
+unsigned getSfntGlyphCount(const SfntFont *font);
+/// Maps a character to a glyph index through the font's Unicode cmap, returns 0 if it has no glyph
+unsigned getSfntGlyphIndex(const SfntFont *font, unsigned unicode);
+/// Loads a glyph by glyph index. Coordinates and advance match loadGlyph. Fails for glyphs using
+/// charstring features that aren't supported (seac accents, most arithmetic operators)
+bool loadSfntGlyph(Shape &output, const SfntFont *font, unsigned glyphIndex, double *advance = NULL);
+
+/// Lists the components of a TrueType composite glyph, so that drawing each component as loaded by
+/// loadSfntGlyph at its offset reproduces the composite. Fails for simple glyphs, CFF fonts and
+/// composites that scale, rotate or align their components by point numbers
+bool getSfntGlyphComponents(std::vector<SfntComponent> &components, const SfntFont *font, unsigned glyphIndex);
+
+}
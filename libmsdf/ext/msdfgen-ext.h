@@ -21,3 +21,4 @@
 #include "../ext/save-png.h"
 #include "../ext/import-svg.h"
 #include "../ext/import-font.h"
+#include "../ext/import-sfnt.h"
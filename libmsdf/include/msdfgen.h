@@ -37,4 +37,8 @@ void generatePseudoSDF(Bitmap<float> &output, const Shape &shape, double range,
 /// Generates a multi-channel signed distance field. Edge colors must be assigned first! (see edgeColoringSimple)
 void generateMSDF(Bitmap<FloatRGB> &output, const Shape &shape, double range, const Vector2 &scale, const Vector2 &translate, double edgeThreshold = 1.00000001);
 
+/// Flattens texels of a multi-channel distance field whose channels would interpolate to false edges with a neighbor.
+/// generateMSDF does this itself unless edgeThreshold is zero
+void msdfErrorCorrection(Bitmap<FloatRGB> &output, const Vector2 &threshold);
+
 }
@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <intrin.h>
+#include <malloc.h>
+#else
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <sys/resource.h>
+#endif
+
+#if defined( __GLIBC__ )
+#include <malloc.h>
+#elif defined( __APPLE__ )
+#include <malloc/malloc.h>
+#elif defined( __FreeBSD__ )
+#include <malloc_np.h>
+#endif
+
+#include "alloc.h"
+
+#ifdef _MSC_VER
+#define CALLER_ADDRESS() _ReturnAddress()
+#else
+#define CALLER_ADDRESS() __builtin_return_address( 0 )
+#endif
+
+// nothing in here may allocate through operator new while tracking is on,
+// so the bookkeeping lives in fixed size tables of atomics
+
+static std::atomic< bool > tracking( false );
+
+// PerfStage_Count is everything outside of a stage
+static thread_local perf_stage current_stage = PerfStage_Count;
+
+struct stage_allocations {
+	std::atomic< uint64_t > count;
+	std::atomic< uint64_t > bytes;
+	std::atomic< uint64_t > frees;
+	// the most bytes live at once while this stage was allocating
+	std::atomic< int64_t > peak_live;
+};
+
+static stage_allocations stages[ PerfStage_Count + 1 ];
+static std::atomic< int64_t > live_bytes( 0 );
+static std::atomic< int64_t > peak_live_bytes( 0 );
+
+// call sites are keyed by the return address of operator new, found by
+// linear probing. sites that don't fit anymore are lumped together
+static constexpr size_t MaxCallSites = 4096;
+
+struct call_site {
+	std::atomic< uintptr_t > address;
+	std::atomic< uint64_t > count;
+	std::atomic< uint64_t > bytes;
+};
+
+static call_site sites[ MaxCallSites ];
+static std::atomic< uint64_t > dropped_count( 0 );
+static std::atomic< uint64_t > dropped_bytes( 0 );
+
+// the usable size rather than the requested one, but it's the same on
+// both ends so live bytes still add up
+static size_t block_size( void* p ) {
+#if defined( _WIN32 )
+	return _msize( p );
+#elif defined( __APPLE__ )
+	return malloc_size( p );
+#else
+	return malloc_usable_size( p );
+#endif
+}
+
+static long max_rss_kb() {
+#ifdef _WIN32
+	return 0;
+#else
+	rusage usage;
+	if( getrusage( RUSAGE_SELF, &usage ) != 0 ) {
+		return 0;
+	}
+#ifdef __APPLE__
+	// bytes there rather than KiB
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+template< typename T >
+static void update_max( std::atomic< T >& target, T value ) {
+	T current = target.load( std::memory_order_relaxed );
+	while( value > current && !target.compare_exchange_weak( current, value, std::memory_order_relaxed ) ) { }
+}
+
+static void record_site( uintptr_t address, size_t size ) {
+	size_t slot = size_t( ( address * 0x9e3779b97f4a7c15ull ) >> 32 ) % MaxCallSites;
+	for( size_t probe = 0; probe < MaxCallSites; probe++ ) {
+		call_site& site = sites[ ( slot + probe ) % MaxCallSites ];
+
+		uintptr_t expected = 0;
+		if( site.address.load( std::memory_order_relaxed ) == address || site.address.compare_exchange_strong( expected, address ) || expected == address ) {
+			site.count.fetch_add( 1, std::memory_order_relaxed );
+			site.bytes.fetch_add( size, std::memory_order_relaxed );
+			return;
+		}
+	}
+
+	dropped_count.fetch_add( 1, std::memory_order_relaxed );
+	dropped_bytes.fetch_add( size, std::memory_order_relaxed );
+}
+
+static void note_allocation( void* p, void* caller ) {
+	size_t size = block_size( p );
+	stage_allocations& stage = stages[ current_stage ];
+	stage.count.fetch_add( 1, std::memory_order_relaxed );
+	stage.bytes.fetch_add( size, std::memory_order_relaxed );
+
+	int64_t live = live_bytes.fetch_add( size, std::memory_order_relaxed ) + int64_t( size );
+	update_max( stage.peak_live, live );
+	update_max( peak_live_bytes, live );
+
+	record_site( uintptr_t( caller ), size );
+}
+
+static void note_free( void* p ) {
+	stages[ current_stage ].frees.fetch_add( 1, std::memory_order_relaxed );
+	live_bytes.fetch_sub( block_size( p ), std::memory_order_relaxed );
+}
+
+static void* allocate( size_t size, void* caller ) {
+	void* p;
+	while( ( p = malloc( size > 0 ? size : 1 ) ) == NULL ) {
+		std::new_handler handler = std::get_new_handler();
+		if( handler == NULL ) {
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+
+	if( tracking.load( std::memory_order_relaxed ) ) {
+		note_allocation( p, caller );
+	}
+	return p;
+}
+
+static void* allocate_nothrow( size_t size, void* caller ) noexcept {
+	try {
+		return allocate( size, caller );
+	}
+	catch( ... ) {
+		return NULL;
+	}
+}
+
+static void deallocate( void* p ) noexcept {
+	if( p == NULL ) {
+		return;
+	}
+	// blocks from before tracking started are counted as freed too, which
+	// only makes live bytes start out a little low
+	if( tracking.load( std::memory_order_relaxed ) ) {
+		note_free( p );
+	}
+	free( p );
+}
+
+void* operator new( size_t size ) { return allocate( size, CALLER_ADDRESS() ); }
+void* operator new[]( size_t size ) { return allocate( size, CALLER_ADDRESS() ); }
+void* operator new( size_t size, const std::nothrow_t& ) noexcept { return allocate_nothrow( size, CALLER_ADDRESS() ); }
+void* operator new[]( size_t size, const std::nothrow_t& ) noexcept { return allocate_nothrow( size, CALLER_ADDRESS() ); }
+
+void operator delete( void* p ) noexcept { deallocate( p ); }
+void operator delete[]( void* p ) noexcept { deallocate( p ); }
+void operator delete( void* p, const std::nothrow_t& ) noexcept { deallocate( p ); }
+void operator delete[]( void* p, const std::nothrow_t& ) noexcept { deallocate( p ); }
+void operator delete( void* p, size_t ) noexcept { deallocate( p ); }
+void operator delete[]( void* p, size_t ) noexcept { deallocate( p ); }
+
+void enable_allocation_tracking() {
+	tracking = true;
+}
+
+bool allocation_tracking_enabled() {
+	return tracking;
+}
+
+int64_t live_allocated_bytes() {
+	return live_bytes;
+}
+
+int64_t peak_allocated_bytes() {
+	return peak_live_bytes;
+}
+
+void reset_peak_allocated_bytes() {
+	peak_live_bytes = live_bytes.load();
+}
+
+stage_mark enter_stage( perf_stage stage ) {
+	stage_mark mark;
+	mark.previous = current_stage;
+	current_stage = stage;
+	return mark;
+}
+
+void leave_stage( perf_stage, const stage_mark& mark ) {
+	current_stage = mark.previous;
+}
+
+// function name and offset if the symbol is exported, otherwise the module
+// and offset to feed to addr2line
+static std::string describe_site( uintptr_t address ) {
+	std::ostringstream ss;
+#ifndef _WIN32
+	Dl_info info;
+	if( dladdr( ( void* ) address, &info ) != 0 ) {
+		if( info.dli_sname != NULL ) {
+			int status;
+			char* demangled = abi::__cxa_demangle( info.dli_sname, NULL, NULL, &status );
+			std::string name = status == 0 ? demangled : info.dli_sname;
+			free( demangled );
+
+			// template instantiations get very long
+			if( name.size() > 96 ) {
+				name = name.substr( 0, 93 ) + "...";
+			}
+			ss << name << "+0x" << std::hex << address - uintptr_t( info.dli_saddr );
+			return ss.str();
+		}
+		if( info.dli_fname != NULL ) {
+			std::string module = info.dli_fname;
+			size_t slash = module.rfind( '/' );
+			ss << ( slash == std::string::npos ? module : module.substr( slash + 1 ) ) << "+0x" << std::hex << address - uintptr_t( info.dli_fbase );
+			return ss.str();
+		}
+	}
+#endif
+	ss << "0x" << std::hex << address;
+	return ss.str();
+}
+
+static double mib( int64_t bytes ) {
+	return bytes / ( 1024.0 * 1024.0 );
+}
+
+void print_allocation_stats( size_t top_sites ) {
+	if( !tracking ) {
+		return;
+	}
+	// the report allocates, and shouldn't show up in itself
+	tracking = false;
+
+	static const char* const stage_names[ PerfStage_Count + 1 ] = {
+		"outline load",
+		"coloring",
+		"generation",
+		"error correction",
+		"packing",
+		"encode",
+		"other",
+	};
+
+	std::ios::fmtflags flags = std::cout.flags();
+	std::streamsize precision = std::cout.precision();
+	std::cout << std::fixed << std::setprecision( 2 );
+
+	std::cout << "\nallocations through operator new, summed over threads:\n";
+	std::cout << std::left << std::setw( 18 ) << "stage" << std::right << std::setw( 10 ) << "allocs" << std::setw( 10 ) << "frees";
+	std::cout << std::setw( 12 ) << "MiB" << std::setw( 16 ) << "peak live MiB" << "\n";
+
+	for( size_t i = 0; i <= PerfStage_Count; i++ ) {
+		const stage_allocations& stage = stages[ i ];
+		if( stage.count == 0 && stage.frees == 0 ) {
+			continue;
+		}
+		std::cout << std::left << std::setw( 18 ) << stage_names[ i ] << std::right << std::setw( 10 ) << stage.count << std::setw( 10 ) << stage.frees;
+		std::cout << std::setw( 12 ) << mib( stage.bytes ) << std::setw( 16 ) << mib( stage.peak_live ) << "\n";
+	}
+	// rss is the whole process's, so it can't be split between stages
+	// running on different threads at the same time
+	std::cout << "peak live " << mib( peak_live_bytes ) << " MiB, peak rss " << max_rss_kb() / 1024.0 << " MiB.\n";
+
+	std::vector< const call_site* > sorted;
+	for( const call_site& site : sites ) {
+		if( site.address != 0 ) {
+			sorted.push_back( &site );
+		}
+	}
+	size_t count = std::min( top_sites, sorted.size() );
+	std::partial_sort( sorted.begin(), sorted.begin() + count, sorted.end(), []( const call_site* a, const call_site* b ) {
+		return a->bytes > b->bytes;
+	} );
+
+	if( count > 0 ) {
+		std::cout << "\ntop " << count << " allocation sites by bytes:\n";
+		std::cout << std::setw( 10 ) << "allocs" << std::setw( 12 ) << "MiB" << "  site\n";
+		for( size_t i = 0; i < count; i++ ) {
+			std::cout << std::setw( 10 ) << sorted[ i ]->count << std::setw( 12 ) << mib( sorted[ i ]->bytes ) << "  " << describe_site( sorted[ i ]->address ) << "\n";
+		}
+		if( dropped_count > 0 ) {
+			std::cout << std::setw( 10 ) << dropped_count << std::setw( 12 ) << mib( dropped_bytes ) << "  (sites that didn't fit the table)\n";
+		}
+	}
+
+	std::cout.flags( flags );
+	std::cout.precision( precision );
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "perf.h"
+
+// --track-allocations. alloc.cpp replaces the global operator new and
+// delete, which libmsdf's bitmaps and edge segments go through as well.
+// plain malloc from C code (FreeType, lodepng) isn't seen there, but still
+// shows up in the peak rss
+
+void enable_allocation_tracking();
+bool allocation_tracking_enabled();
+
+// bytes live through operator new, and the most there have been at once
+// since the last reset, which starts over from what's live now. only
+// counted while tracking is on
+int64_t live_allocated_bytes();
+int64_t peak_allocated_bytes();
+void reset_peak_allocated_bytes();
+
+// charges allocations on the calling thread to the stage until
+// leave_stage. perf_scope does this, so its stages are the ones reported
+stage_mark enter_stage( perf_stage stage );
+void leave_stage( perf_stage stage, const stage_mark& mark );
+
+void print_allocation_stats( size_t top_sites );
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "msdfgen.h"
+#include "box.h"
+#include "corpus.h"
+
+struct texture_dimensions {
+	size_t width, height;
+};
+
+// --shard index/count
+struct shard_spec {
+	size_t index, count;
+};
+
+// --packer
+enum packer_kind {
+	Packer_MaxRects,
+	Packer_Skyline,
+	// try many packings at once and keep the best
+	Packer_Portfolio,
+};
+
+// --fit-texture
+enum texture_fit {
+	Fit_None,
+	Fit_PowerOfTwo,
+	Fit_MultipleOf4,
+	Fit_Any,
+};
+
+// --embed
+enum embed_mode {
+	Embed_None,
+	Embed_Raw,
+	// pixels run length encoded
+	Embed_RLE,
+};
+
+struct settings {
+	texture_dimensions tex_dims;
+	// shrink tex_dims to the smallest texture of this kind the glyphs pack
+	// into, tex_dims being the biggest allowed
+	texture_fit fit_texture;
+
+	size_t max_char_height;
+	bool auto_height;
+
+	size_t spacing;
+	size_t smoothpixels;
+	double range;
+
+	// plain SDFs packed four layers deep into the RGBA channels instead of
+	// one RGB MSDF layer
+	bool single_channel;
+
+	std::string font_file_name;
+	std::string output_file_name;
+
+	// variable font instances, each gets its own atlas
+	std::vector< std::string > instances;
+
+	// generate by glyph index instead of by codepoint, for shaped text
+	bool by_glyph_index;
+	// ranges of codepoints (or glyph indices) to generate, e.g. "32-126,0xa0-0xff"
+	std::string charset;
+	// store composite glyphs (accented letters and such) as their
+	// components' tiles plus offsets instead of a tile of their own
+	bool composites;
+	// lay glyphs out in uniform cells by id instead of packing them
+	bool grid;
+	// which bin packer places the tiles
+	packer_kind packer;
+	// let the packer turn tiles 90 degrees when they fit better that way
+	bool rotate;
+	// with Packer_Portfolio, keep trying random packings for this many
+	// seconds
+	double pack_time_budget;
+
+	// only generate this shard's glyphs and write them to a tile file. count
+	// is 0 when not sharding
+	shard_spec shard;
+	// tile files to pack into the final atlas instead of reading a font
+	std::vector< std::string > merge_files;
+	// finished atlases to repack into one, by the name their files share
+	std::vector< std::string > repack_files;
+
+	// rebuild whenever the font file changes
+	bool watch;
+	// also write what changed since the outputs already on disk, for
+	// partial texture updates
+	bool delta;
+	// also write the atlas as C++ source to compile into a program
+	embed_mode embed;
+
+	// ranges of ids to generate and write first, the rest follows in
+	// batches of batch_size with the outputs rewritten after each
+	std::string priority;
+	size_t batch_size;
+
+	// split the atlas into square pages of this size. 0 when not paging
+	size_t page_size;
+
+	// text to take glyph frequencies from, and how much of it the atlas has
+	// to cover
+	std::vector< std::string > corpus_files;
+	double coverage;
+	// filled in from corpus_files, keyed like char_info::id
+	codepoint_counts frequencies;
+
+	// report hardware counters per stage, and for this many of the slowest
+	// glyphs
+	bool perf_counters;
+	size_t perf_glyphs;
+	// report allocations per stage, and this many of the call sites
+	// allocating the most
+	bool track_allocations;
+	size_t allocation_sites;
+};
+
+// with --composites, a tile drawn as part of a composite glyph, offset
+// in scaled outline units
+struct glyph_component {
+	uint32_t id;
+	msdfgen::Vector2 offset;
+};
+
+// ids of component tiles that aren't reachable through the charmap start
+// here, past the last codepoint
+static constexpr uint32_t UnencodedComponentBase = 0x110000;
+
+struct char_info {
+	char_info( uint32_t i, box< double > box, msdfgen::Shape s, double adv )
+		: id( i ), bbox( box ), shape( s), advance( adv )
+	{}
+
+	// codepoint, or glyph index with --glyph-indices
+	uint32_t id;
+	box< double > bbox;
+	box<size_t> placement;
+	size_t channel = 0;
+	size_t page = 0;
+	// turned 90 degrees clockwise in the atlas, so placement is the tile
+	// with width and height swapped
+	bool rotated = false;
+	msdfgen::Shape shape;
+	msdfgen::Vector2 translation;
+	double advance;
+	msdfgen::Bitmap< msdfgen::FloatRGB > bitmap;
+	msdfgen::Bitmap< float > sdf;
+	// set for composite glyphs, which get no tile of their own
+	std::vector< glyph_component > components;
+
+	size_t tile_width() const { return rotated ? placement.height : placement.width; }
+	size_t tile_height() const { return rotated ? placement.width : placement.height; }
+};
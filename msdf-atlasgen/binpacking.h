@@ -24,6 +24,7 @@
 #define BINPACKING_H_INCLUDED__
 
 #include <vector>
+#include <set>
 #include <algorithm>
 #include <iostream>
 #include "box.h"
@@ -33,109 +34,812 @@ T score_bssf( box<T>& a, box<T>& b ) {
     return std::min( a.width - b.width, a.height - b.height );
 }
 
+// how max_rect_bin picks where boxes go. Global scores every box against
+// every free rectangle by best short side fit and places the best pair
+// first. the rest place boxes in input order, each in the free rectangle
+// that scores best
+enum max_rect_heuristic {
+    MaxRect_Global,
+    MaxRect_BestShortSide,
+    MaxRect_BestLongSide,
+    MaxRect_BestArea,
+    MaxRect_BottomLeft,
+    // touching the most edges of the bin and of boxes already placed
+    MaxRect_ContactPoint,
+};
+
 // http://clb.demon.fi/files/RectangleBinPack.pdf
 // MAX-RECTANGLES-BSSF-BBF GLOBAL
+// keeps its free rectangles between calls to insert, so a bin can be filled
+// in several goes. copy it to try an insert without committing to it
 template< typename T >
-bool bin_pack_max_rect( std::vector< box<T>* >& input, T width, T height, T spacing ) {
-    std::vector<box<T>> boxes;
-    boxes.reserve( width*height );
-    boxes.push_back( box< size_t >{ 0, 0, width, height } );
+struct max_rect_bin {
+    max_rect_bin( T width, T height, T spacing );
+
+    // places as much of input as fits. returns false if not everything fit,
+    // in which case input is left holding the boxes that could not be placed.
+    bool insert( std::vector< box<T>* >& input );
+
+    // the best input box for one free rectangle. choice is the box's index
+    // times two, plus one if it goes in turned
+    struct fit {
+        T score;
+        size_t choice;
+        bool found;
+    };
+
+    // seq counts up as free rectangles are made. sorting by it gives the
+    // order the rectangles used to have in one erase/push_back vector, so
+    // ties still go to the same rectangle as before
+    struct free_box {
+        box<T> rect;
+        size_t seq;
+        // false while the slot is unused
+        bool live;
+        fit best;
+    };
+
+    T width, height, spacing;
+    // free rectangles by slot. freed slots get reused
+    std::vector< free_box > slots;
+    // anything placed yet?
+    bool used;
+    // print a dot every 50 boxes
+    bool progress;
+    // set before the first insert
+    max_rect_heuristic heuristic;
+    // boxes may be turned 90 degrees where that fits better. a turned box
+    // gets its width and height swapped
+    bool rotate;
+
+private:
+    typedef std::set< std::pair< T, size_t > > size_index;
+    // lower is better, the second half breaks ties
+    typedef std::pair< T, T > score_pair;
+
+    // a uniform grid over the bin. every cell lists the slots of the free
+    // rectangles touching it, so finding what a placement overlaps only
+    // looks at the rectangles nearby
+    T cell;
+    size_t cols;
+    std::vector< std::vector< size_t > > cells;
+
+    std::vector< size_t > unused_slots;
+    size_t next_seq;
+    // slots already seen by the current grid query
+    std::vector< size_t > stamps;
+    size_t stamp;
+
+    // the input boxes still waiting during insert, by width and by height,
+    // turned ones too with rotate. boxes of the same size are keyed by
+    // 2 * input.size() - choice, so walking down meets the first one first
+    std::vector< box<T>* >* input;
+    size_index waiting_width;
+    size_index waiting_height;
+
+    // MaxRect_ContactPoint only. the boxes placed so far, and the grid
+    // cells they touch
+    std::vector< box<T> > placed;
+    std::vector< std::vector< size_t > > placed_cells;
+
+    // calls f on every cell of grid touching the pixels from x0, y0 to x1,
+    // y1 inclusive
+    template< typename F >
+    void for_cells( std::vector< std::vector< size_t > >& grid, T x0, T y0, T x1, T y1, F f ) {
+        for( size_t row = y0 / cell; row <= y1 / cell; ++row ) {
+            for( size_t col = x0 / cell; col <= x1 / cell; ++col ) {
+                f( grid[ row * cols + col ] );
+            }
+        }
+    }
+
+    size_t add( const box<T>& rect );
+    void remove( size_t slot );
+
+    box<T> chosen( size_t choice ) {
+        box<T> b = *( *input )[ choice / 2 ];
+        if( choice % 2 == 1 ) {
+            std::swap( b.width, b.height );
+        }
+        return b;
+    }
+
+    void consider( fit& best, box<T>& dest, size_t choice ) {
+        box<T> src = chosen( choice );
+        if( !can_fit( dest, src ) ) {
+            return;
+        }
+        T score = score_bssf( dest, src );
+        if( score >= std::max( width, height ) ) {
+            return;
+        }
+        if( !best.found || score < best.score || ( score == best.score && choice < best.choice ) ) {
+            best = fit{ score, choice, true };
+        }
+    }
+
+    // the best score comes from either the widest box that fits or the
+    // tallest one. every box of that width that fits scores the same, so
+    // the first one of them is the only one worth a look, and the same
+    // goes for the height
+    fit best_fit( box<T>& dest ) {
+        fit best = { 0, 0, false };
+        if( input ) {
+            scan( best, dest, waiting_width, dest.width );
+            scan( best, dest, waiting_height, dest.height );
+        }
+        return best;
+    }
+
+    void scan( fit& best, box<T>& dest, const size_index& sorted, T size ) {
+        typename size_index::const_reverse_iterator it( sorted.upper_bound( std::make_pair( size, size_t( -1 ) ) ) );
+        for( ; it != sorted.rend(); ++it ) {
+            size_t choice = 2 * input->size() - it->second;
+            box<T> src = chosen( choice );
+            if( can_fit( dest, src ) ) {
+                consider( best, dest, choice );
+                return;
+            }
+        }
+    }
+
+    void place( box<T>& irect, size_t dest );
+    void wait( size_t choice, bool waiting );
+
+    score_pair score( const box<T>& dest, const box<T>& src );
+    T contact( const box<T>& rect );
+    bool insert_each( std::vector< box<T>* >& input );
+};
+
+template< typename T >
+max_rect_bin<T>::max_rect_bin( T width, T height, T spacing ) : width( width ), height( height ), spacing( spacing ), used( false ), progress( false ), heuristic( MaxRect_Global ), rotate( false ), next_seq( 0 ), stamp( 0 ), input( nullptr ) {
+    // 32 cells along the longer side. glyphs are usually around that many
+    // pixels, so a query touches a handful of cells
+    cell = std::max< T >( 1, ( std::max( width, height ) + 31 ) / 32 );
+    cols = std::max< size_t >( 1, ( width + cell - 1 ) / cell );
+    size_t rows = std::max< size_t >( 1, ( height + cell - 1 ) / cell );
+    cells.resize( cols * rows );
+    placed_cells.resize( cols * rows );
+
+    if( width > 0 && height > 0 ) {
+        add( box< T >{ 0, 0, width, height } );
+    }
+}
+
+template< typename T >
+size_t max_rect_bin<T>::add( const box<T>& rect ) {
+    size_t slot;
+    if( unused_slots.empty() ) {
+        slot = slots.size();
+        slots.push_back( free_box() );
+        stamps.push_back( 0 );
+    }
+    else {
+        slot = unused_slots.back();
+        unused_slots.pop_back();
+    }
+
+    slots[ slot ] = free_box{ rect, next_seq++, true, fit() };
+    slots[ slot ].best = best_fit( slots[ slot ].rect );
+    for_cells( cells, rect.x, rect.y, rect.right() - 1, rect.top() - 1, [&]( std::vector< size_t >& c ) {
+        c.push_back( slot );
+    } );
+    return slot;
+}
+
+template< typename T >
+void max_rect_bin<T>::remove( size_t slot ) {
+    box<T>& rect = slots[ slot ].rect;
+    for_cells( cells, rect.x, rect.y, rect.right() - 1, rect.top() - 1, [&]( std::vector< size_t >& c ) {
+        auto it = std::find( c.begin(), c.end(), slot );
+        *it = c.back();
+        c.pop_back();
+    } );
+
+    slots[ slot ].live = false;
+    unused_slots.push_back( slot );
+}
+
+// splits the free rectangles irect overlaps and drops the new pieces that
+// end up inside other free rectangles. nothing older can end up inside a
+// new piece: the piece lies within a rectangle that was free before, and
+// the older one would already have been dropped for lying inside that
+template< typename T >
+void max_rect_bin<T>::place( box<T>& irect, size_t dest ) {
+    irect.x = slots[ dest ].rect.x;
+    irect.y = slots[ dest ].rect.y;
+    used = true;
+
+    if( heuristic == MaxRect_ContactPoint ) {
+        for_cells( placed_cells, irect.x, irect.y, irect.right() - 1, irect.top() - 1, [&]( std::vector< size_t >& c ) {
+            c.push_back( placed.size() );
+        } );
+        placed.push_back( irect );
+    }
 
-    std::vector< size_t > candidates;
-    candidates.reserve( 100 );
+    // the destination is split first, then the others from oldest to newest
+    std::vector< size_t > overlapped;
+    overlapped.push_back( dest );
+    ++stamp;
+    stamps[ dest ] = stamp;
 
-    std::vector<box<T>> newrects;
+    T x0 = irect.x > spacing ? irect.x - spacing : 0;
+    T y0 = irect.y > spacing ? irect.y - spacing : 0;
+    T x1 = std::min( width - 1, irect.right() + spacing );
+    T y1 = std::min( height - 1, irect.top() + spacing );
+    for_cells( cells, x0, y0, x1, y1, [&]( std::vector< size_t >& c ) {
+        for( size_t slot : c ) {
+            if( stamps[ slot ] != stamp ) {
+                stamps[ slot ] = stamp;
+                if( overlap( slots[ slot ].rect, irect, spacing ) ) {
+                    overlapped.push_back( slot );
+                }
+            }
+        }
+    } );
+    std::sort( overlapped.begin() + 1, overlapped.end(), [&]( size_t a, size_t b ) { return slots[ a ].seq < slots[ b ].seq; } );
+
+    std::vector< box<T> > pieces;
+    std::vector< box<T> > newrects;
     newrects.reserve( 4 );
+    for( size_t slot : overlapped ) {
+        make_splits( slots[ slot ].rect, irect, newrects, spacing );
+        pieces.insert( pieces.end(), newrects.begin(), newrects.end() );
+    }
+    for( size_t slot : overlapped ) {
+        remove( slot );
+    }
+
+    // a piece goes if it's the same as an earlier piece or inside any
+    // other free rectangle. a rectangle containing the piece also contains
+    // its corner, so only the corner's cell needs checking
+    std::vector< bool > keep( pieces.size(), true );
+    for( size_t i = 0; i < pieces.size(); ++i ) {
+        for( size_t j = 0; j < pieces.size() && keep[ i ]; ++j ) {
+            if( i != j && ( pieces[ i ] == pieces[ j ] ? j < i : contains( pieces[ j ], pieces[ i ] ) ) ) {
+                keep[ i ] = false;
+            }
+        }
+
+        std::vector< size_t >& c = cells[ pieces[ i ].y / cell * cols + pieces[ i ].x / cell ];
+        for( size_t k = 0; k < c.size() && keep[ i ]; ++k ) {
+            if( contains( slots[ c[ k ] ].rect, pieces[ i ] ) ) {
+                keep[ i ] = false;
+            }
+        }
+    }
+
+    // pieces added to the grid now would be seen by the checks above, so
+    // they go in afterwards, in order
+    for( size_t i = 0; i < pieces.size(); ++i ) {
+        if( keep[ i ] ) {
+            add( pieces[ i ] );
+        }
+    }
+}
+
+// how much of rect's outline lies along the bin's edges or, spacing away,
+// along boxes already placed
+template< typename T >
+T max_rect_bin<T>::contact( const box<T>& rect ) {
+    T total = 0;
+    total += rect.x == 0 ? rect.height : 0;
+    total += rect.right() == width ? rect.height : 0;
+    total += rect.y == 0 ? rect.width : 0;
+    total += rect.top() == height ? rect.width : 0;
+
+    std::vector< size_t > near;
+    T x0 = rect.x > spacing ? rect.x - spacing : 0;
+    T y0 = rect.y > spacing ? rect.y - spacing : 0;
+    T x1 = std::min( width - 1, rect.right() + spacing );
+    T y1 = std::min( height - 1, rect.top() + spacing );
+    for_cells( placed_cells, x0, y0, x1, y1, [&]( std::vector< size_t >& c ) {
+        near.insert( near.end(), c.begin(), c.end() );
+    } );
+    std::sort( near.begin(), near.end() );
+    near.erase( std::unique( near.begin(), near.end() ), near.end() );
+
+    for( size_t i : near ) {
+        const box<T>& other = placed[ i ];
+        if( other.right() + spacing == rect.x || rect.right() + spacing == other.x ) {
+            T lo = std::max( other.y, rect.y );
+            T hi = std::min( other.top(), rect.top() );
+            total += hi > lo ? hi - lo : 0;
+        }
+        if( other.top() + spacing == rect.y || rect.top() + spacing == other.y ) {
+            T lo = std::max( other.x, rect.x );
+            T hi = std::min( other.right(), rect.right() );
+            total += hi > lo ? hi - lo : 0;
+        }
+    }
+    return total;
+}
+
+template< typename T >
+typename max_rect_bin<T>::score_pair max_rect_bin<T>::score( const box<T>& dest, const box<T>& src ) {
+    T dw = dest.width - src.width;
+    T dh = dest.height - src.height;
+    switch( heuristic ) {
+        case MaxRect_BestLongSide:
+            return score_pair( std::max( dw, dh ), std::min( dw, dh ) );
+        case MaxRect_BestArea:
+            return score_pair( dest.width * dest.height - src.width * src.height, std::min( dw, dh ) );
+        case MaxRect_BottomLeft:
+            return score_pair( dest.y + src.height, dest.x );
+        case MaxRect_ContactPoint: {
+            box<T> at = { dest.x, dest.y, src.width, src.height };
+            return score_pair( 2 * ( src.width + src.height ) - contact( at ), 0 );
+        }
+        default:
+            return score_pair( std::min( dw, dh ), std::max( dw, dh ) );
+    }
+}
+
+// one box at a time in input order, each into its best free rectangle
+template< typename T >
+bool max_rect_bin<T>::insert_each( std::vector< box<T>* >& input ) {
+    size_t unplaced = 0;
+    for( size_t n = 0; n < input.size(); ++n ) {
+        if( progress && ( input.size() - n ) % 50 == 0 ) {
+            std::cout << '.';
+        }
+
+        box<T>& irect = *input[ n ];
+        box<T> turned = { 0, 0, irect.height, irect.width };
+        bool can_turn = rotate && irect.width != irect.height;
+
+        size_t dest = 0;
+        score_pair best;
+        bool best_turned = false;
+        bool found = false;
+        for( size_t slot = 0; slot < slots.size(); ++slot ) {
+            if( !slots[ slot ].live ) {
+                continue;
+            }
+            for( int turn = 0; turn < ( can_turn ? 2 : 1 ); ++turn ) {
+                const box<T>& src = turn ? turned : irect;
+                if( !can_fit( slots[ slot ].rect, src ) ) {
+                    continue;
+                }
+                score_pair s = score( slots[ slot ].rect, src );
+                if( !found || s < best || ( s == best && ( ( !turn && best_turned ) || ( bool( turn ) == best_turned && slots[ slot ].seq < slots[ dest ].seq ) ) ) ) {
+                    dest = slot;
+                    best = s;
+                    best_turned = turn != 0;
+                    found = true;
+                }
+            }
+        }
+
+        if( found ) {
+            if( best_turned ) {
+                std::swap( irect.width, irect.height );
+            }
+            place( irect, dest );
+        }
+        else {
+            input[ unplaced++ ] = input[ n ];
+        }
+    }
+
+    input.resize( unplaced );
+    return unplaced == 0;
+}
+
+// every free rectangle remembers its best input box. a placement only
+// removes and adds a few rectangles, so besides the new ones only the
+// rectangles whose best box was just placed have to look again
+template< typename T >
+bool max_rect_bin<T>::insert( std::vector< box<T>* >& input ) {
+    if( heuristic != MaxRect_Global ) {
+        return insert_each( input );
+    }
+
+    this->input = &input;
+    for( size_t i = 0; i < input.size(); ++i ) {
+        wait( 2 * i, true );
+        if( rotate && input[ i ]->width != input[ i ]->height ) {
+            wait( 2 * i + 1, true );
+        }
+    }
+    for( free_box& b : slots ) {
+        if( b.live ) {
+            b.best = best_fit( b.rect );
+        }
+    }
 
-    while( input.size() ) {
-        if( input.size() % 50 == 0 ) {
+    std::vector< bool > done( input.size(), false );
+    size_t left = input.size();
+
+    while( left ) {
+        if( progress && left % 50 == 0 ) {
             std::cout << '.';
         }
 
         // Find best source-dest pair (GLOBAL)
-        size_t min_source = 0;
         size_t min_dest = 0;
-        T min_score = std::max( width, height );
         bool found = false;
-
-        for( unsigned int source_i = 0; source_i < input.size(); ++source_i ) {
-            for( unsigned int dest_i = 0; dest_i < boxes.size(); ++dest_i ) {
-                if( can_fit( boxes[dest_i], *input[source_i] ) ) {
-                    auto score = score_bssf( boxes[dest_i], *input[source_i] );
-                    if( score < min_score ) {
-                        min_score = score;
-                        min_source = source_i;
-                        min_dest = dest_i;
-                        found = true;
-                    }
-                }
+        for( size_t i = 0; i < slots.size(); ++i ) {
+            const fit& f = slots[ i ].best;
+            if( !slots[ i ].live || !f.found ) {
+                continue;
+            }
+            const fit& min = slots[ min_dest ].best;
+            if( !found || f.score < min.score || ( f.score == min.score && ( f.choice < min.choice || ( f.choice == min.choice && slots[ i ].seq < slots[ min_dest ].seq ) ) ) ) {
+                min_dest = i;
+                found = true;
             }
         }
 
         if( !found ) {
-            std::cout << "bin packing failed with " << input.size() << " characters left to be placed.\n";
-            return false;
+            break;
         }
 
-        // split dest rect
-        auto& irect = *input[min_source];
-        auto& drect = boxes[min_dest];
+        size_t source = slots[ min_dest ].best.choice / 2;
+        wait( 2 * source, false );
+        wait( 2 * source + 1, false );
+        done[ source ] = true;
+        --left;
+
+        if( slots[ min_dest ].best.choice % 2 == 1 ) {
+            std::swap( input[ source ]->width, input[ source ]->height );
+        }
+        place( *input[ source ], min_dest );
 
-        irect.x = drect.x;
-        irect.y = drect.y;
+        for( free_box& b : slots ) {
+            if( b.live && b.best.found && b.best.choice / 2 == source ) {
+                b.best = best_fit( b.rect );
+            }
+        }
+    }
 
-        make_splits( drect, irect, newrects, spacing );
-        boxes.erase( boxes.begin() + min_dest );
-        size_t size = boxes.size();
+    waiting_width.clear();
+    waiting_height.clear();
+    this->input = nullptr;
 
-        for( auto& box : newrects ) {
-            boxes.push_back( box );
+    size_t unplaced = 0;
+    for( size_t i = 0; i < input.size(); ++i ) {
+        if( !done[ i ] ) {
+            input[ unplaced++ ] = input[ i ];
         }
+    }
+    input.resize( unplaced );
+    return left == 0;
+}
 
-        // split all existing overlapping boxes with irect
-        for( size_t i = 0; i<size; ) {
-            if( overlap( boxes[i], irect, spacing ) ) {
-                make_splits( boxes[i], irect, newrects, spacing );
-                boxes.erase( boxes.begin() + i );
+// adds or removes one way of placing an input box from the waiting sets
+template< typename T >
+void max_rect_bin<T>::wait( size_t choice, bool waiting ) {
+    box<T> b = chosen( choice );
+    auto by_width = std::make_pair( b.width, 2 * input->size() - choice );
+    auto by_height = std::make_pair( b.height, 2 * input->size() - choice );
+    if( waiting ) {
+        waiting_width.insert( by_width );
+        waiting_height.insert( by_height );
+    }
+    else {
+        waiting_width.erase( by_width );
+        waiting_height.erase( by_height );
+    }
+}
 
-                for( auto& box : newrects ) {
-                    boxes.push_back( box );
-                }
-                --size;
+// skyline bottom-left with a waste map, from the same paper. boxes go
+// tallest first onto the lowest spot along the tops of what's placed so
+// far, and the gaps that leaves underneath are kept for later boxes. much
+// less work and memory than max_rect_bin, though it can pack worse.
+// copies and partial inserts work the same way
+//
+// after sorting, a box costs one pass over the skyline segments, which
+// are at most as many as fit side by side across the bin, plus one over
+// the waste map, which merges neighbouring gaps, drops the ones nothing
+// left fits into and never holds more than MaxWaste. so O(n log n + n *
+// ( segments + MaxWaste )), with memory for just those two lists
+template< typename T >
+struct skyline_bin {
+    skyline_bin( T width, T height, T spacing ) : width( width ), height( height ), spacing( spacing ), min_width( 0 ), min_height( 0 ), used( false ), progress( false ), rotate( false ) {
+        skyline.push_back( segment{ 0, 0, width + spacing } );
+    }
+
+    // places as much of input as fits. returns false if not everything fit,
+    // in which case input is left holding the boxes that could not be placed.
+    bool insert( std::vector< box<T>* >& input );
+
+    // the skyline from x to x + width is at height y
+    struct segment {
+        T x, y, width;
+    };
+
+    // every box takes up spacing more to its right and top than its own
+    // size, and the bin is that much bigger to make up for it. that keeps
+    // boxes apart without the edges of the bin losing anything
+    T width, height, spacing;
+    // left to right, neighbours never at the same height
+    std::vector< segment > skyline;
+    // free rectangles below the skyline
+    std::vector< box<T> > waste;
+    // the fewest texels a box still to come takes up either way, spacing
+    // included. gaps smaller than that aren't kept
+    T min_width, min_height;
+    // anything placed yet?
+    bool used;
+    // print a dot every 50 boxes
+    bool progress;
+    // boxes may be turned 90 degrees where that fits better. a turned box
+    // gets its width and height swapped
+    bool rotate;
+
+    static constexpr size_t MaxWaste = 256;
+
+private:
+    void add_waste( box<T> gap );
+    bool place_in_waste( box<T>& irect );
+    bool place_on_skyline( box<T>& irect );
+
+    // segments that might be highest under the box being tried, by index
+    // with falling heights. kept around so placing doesn't allocate
+    std::vector< size_t > window;
+};
+
+// joins gap with a gap it shares a whole edge with, and keeps it if any
+// box still to come fits. past MaxWaste the smallest gap goes
+template< typename T >
+void skyline_bin<T>::add_waste( box<T> gap ) {
+    for( size_t i = 0; i < waste.size(); ) {
+        const box<T>& other = waste[ i ];
+        bool beside = other.y == gap.y && other.height == gap.height && ( other.right() == gap.x || gap.right() == other.x );
+        bool above = other.x == gap.x && other.width == gap.width && ( other.top() == gap.y || gap.top() == other.y );
+        if( !beside && !above ) {
+            ++i;
+            continue;
+        }
+        if( beside ) {
+            gap = box<T>{ std::min( gap.x, other.x ), gap.y, gap.width + other.width, gap.height };
+        }
+        else {
+            gap = box<T>{ gap.x, std::min( gap.y, other.y ), gap.width, gap.height + other.height };
+        }
+        // the bigger gap might join up with one already checked
+        waste[ i ] = waste.back();
+        waste.pop_back();
+        i = 0;
+    }
+
+    bool fits = ( gap.width >= min_width && gap.height >= min_height ) || ( rotate && gap.width >= min_height && gap.height >= min_width );
+    if( !fits ) {
+        return;
+    }
+    waste.push_back( gap );
+
+    if( waste.size() > MaxWaste ) {
+        size_t smallest = 0;
+        for( size_t i = 1; i < waste.size(); ++i ) {
+            if( waste[ i ].width * waste[ i ].height < waste[ smallest ].width * waste[ smallest ].height ) {
+                smallest = i;
             }
-            else {
-                ++i;
+        }
+        waste[ smallest ] = waste.back();
+        waste.pop_back();
+    }
+}
+
+// best short side fit among the gaps. what's left of the gap is split in
+// two along its shorter side
+template< typename T >
+bool skyline_bin<T>::place_in_waste( box<T>& irect ) {
+    size_t best = 0;
+    T best_score = 0;
+    bool best_turned = false;
+    bool found = false;
+    for( int turn = 0; turn < ( rotate && irect.width != irect.height ? 2 : 1 ); ++turn ) {
+        box<T> grown = { 0, 0, irect.width + spacing, irect.height + spacing };
+        if( turn ) {
+            grown = box<T>{ 0, 0, irect.height + spacing, irect.width + spacing };
+        }
+        for( size_t i = 0; i < waste.size(); ++i ) {
+            if( can_fit( waste[ i ], grown ) && ( !found || score_bssf( waste[ i ], grown ) < best_score ) ) {
+                best = i;
+                best_score = score_bssf( waste[ i ], grown );
+                best_turned = turn != 0;
+                found = true;
             }
         }
+    }
+
+    if( !found ) {
+        return false;
+    }
+
+    if( best_turned ) {
+        std::swap( irect.width, irect.height );
+    }
+    box<T> grown = { 0, 0, irect.width + spacing, irect.height + spacing };
+    box<T> gap = waste[ best ];
+    waste[ best ] = waste.back();
+    waste.pop_back();
+
+    irect.x = gap.x;
+    irect.y = gap.y;
+
+    box<T> right = { gap.x + grown.width, gap.y, gap.width - grown.width, gap.height };
+    box<T> top = { gap.x, gap.y + grown.height, gap.width, gap.height - grown.height };
+    if( gap.width < gap.height ) {
+        right.height = grown.height;
+    }
+    else {
+        top.width = grown.width;
+    }
+    if( right.width > 0 && right.height > 0 ) {
+        add_waste( right );
+    }
+    if( top.width > 0 && top.height > 0 ) {
+        add_waste( top );
+    }
+    return true;
+}
+
+// the lowest top wins, then the narrowest segment. boxes only go on turned
+// when they don't fit upright: turned boxes lying flat always win on top,
+// and break up the rows of similar heights that sorting by height builds
+template< typename T >
+bool skyline_bin<T>::place_on_skyline( box<T>& irect ) {
+    size_t best = 0;
+    T best_y = 0;
+    T best_top = 0;
+    bool best_turned = false;
+    bool found = false;
+    for( int turn = 0; turn < ( rotate && irect.width != irect.height ? 2 : 1 ) && !found; ++turn ) {
+        T w = ( turn ? irect.height : irect.width ) + spacing;
+        T h = ( turn ? irect.width : irect.height ) + spacing;
+
+        // the box starting at segment i covers segments i to end, and both
+        // ends only move right, so the highest of them is kept up to date
+        // in window rather than looked for every time
+        window.clear();
+        size_t head = 0;
+        size_t end = 0;
+        for( size_t i = 0; i < skyline.size(); ++i ) {
+            T x = skyline[ i ].x;
+            if( x + w > width + spacing ) {
+                break;
+            }
 
-        // find bogus rects
-        candidates.clear();
-        for( size_t i = 0; i<boxes.size(); ++i ) {
-            for( size_t j = 0; j<boxes.size(); ++j ) {
-                if( i != j ) {
-                    if( boxes[i] == boxes[j] ) {
-                        if( i > j ) candidates.push_back( i );
-                    }
-                    else if( contains( boxes[i], boxes[j] ) ) {
-                        candidates.push_back( j );
-                    }
+            for( ; end < skyline.size() && skyline[ end ].x < x + w; ++end ) {
+                while( window.size() > head && skyline[ window.back() ].y <= skyline[ end ].y ) {
+                    window.pop_back();
                 }
+                window.push_back( end );
+            }
+            while( window[ head ] < i ) {
+                ++head;
+            }
+
+            T y = skyline[ window[ head ] ].y;
+            if( y + h > height + spacing ) {
+                continue;
+            }
+
+            if( !found || y + h < best_top || ( y + h == best_top && skyline[ i ].width < skyline[ best ].width ) ) {
+                best = i;
+                best_y = y;
+                best_top = y + h;
+                best_turned = turn != 0;
+                found = true;
             }
         }
+    }
 
-        std::sort( candidates.begin(), candidates.end(), std::less<size_t>() );
-        candidates.erase( std::unique( candidates.begin(), candidates.end() ), candidates.end() );
+    if( !found ) {
+        return false;
+    }
 
-        for( size_t removes = 0; removes < candidates.size(); ++removes ) {
-            boxes.erase( boxes.begin() + (candidates[removes] - removes) );
+    if( best_turned ) {
+        std::swap( irect.width, irect.height );
+    }
+    T w = irect.width + spacing;
+    T h = irect.height + spacing;
+    T x = skyline[ best ].x;
+    irect.x = x;
+    irect.y = best_y;
+
+    // whatever the box hangs over becomes waste, and the segments under it
+    // are cut back to where it ends
+    size_t end = best;
+    for( ; end < skyline.size() && skyline[ end ].x < x + w; ++end ) {
+        segment& seg = skyline[ end ];
+        T right = std::min( seg.x + seg.width, x + w );
+        if( seg.y < best_y ) {
+            add_waste( box<T>{ seg.x, seg.y, right - seg.x, best_y - seg.y } );
         }
+    }
 
-        input.erase( input.begin() + min_source );
+    segment& last = skyline[ end - 1 ];
+    if( last.x + last.width > x + w ) {
+        last.width = last.x + last.width - ( x + w );
+        last.x = x + w;
+        --end;
     }
+    skyline.erase( skyline.begin() + best, skyline.begin() + end );
+    skyline.insert( skyline.begin() + best, segment{ x, best_y + h, w } );
 
+    if( best + 1 < skyline.size() && skyline[ best + 1 ].y == skyline[ best ].y ) {
+        skyline[ best ].width += skyline[ best + 1 ].width;
+        skyline.erase( skyline.begin() + best + 1 );
+    }
+    if( best > 0 && skyline[ best - 1 ].y == skyline[ best ].y ) {
+        skyline[ best - 1 ].width += skyline[ best ].width;
+        skyline.erase( skyline.begin() + best );
+    }
+    return true;
+}
+
+template< typename T >
+bool skyline_bin<T>::insert( std::vector< box<T>* >& input ) {
+    std::vector< size_t > order( input.size() );
+    for( size_t i = 0; i < order.size(); ++i ) {
+        order[ i ] = i;
+    }
+    std::stable_sort( order.begin(), order.end(), [&]( size_t a, size_t b ) {
+        if( input[ a ]->height != input[ b ]->height ) {
+            return input[ a ]->height > input[ b ]->height;
+        }
+        return input[ a ]->width > input[ b ]->width;
+    } );
+
+    if( !input.empty() ) {
+        min_width = input[ 0 ]->width;
+        min_height = input[ 0 ]->height;
+        for( const box<T>* b : input ) {
+            min_width = std::min( min_width, b->width );
+            min_height = std::min( min_height, b->height );
+        }
+        min_width += spacing;
+        min_height += spacing;
+    }
+
+    std::vector< bool > placed( input.size(), false );
+    for( size_t n = 0; n < order.size(); ++n ) {
+        if( progress && ( order.size() - n ) % 50 == 0 ) {
+            std::cout << '.';
+        }
+
+        box<T>& irect = *input[ order[ n ] ];
+        if( place_in_waste( irect ) || place_on_skyline( irect ) ) {
+            placed[ order[ n ] ] = true;
+            used = true;
+        }
+    }
+
+    size_t unplaced = 0;
+    for( size_t i = 0; i < input.size(); ++i ) {
+        if( !placed[ i ] ) {
+            input[ unplaced++ ] = input[ i ];
+        }
+    }
+    input.resize( unplaced );
+    return unplaced == 0;
+}
+
+// packs everything into one bin. returns false if not everything fit, in
+// which case input is left holding the boxes that could not be placed.
+template< typename T >
+bool bin_pack_max_rect( std::vector< box<T>* >& input, T width, T height, T spacing ) {
+    max_rect_bin<T> bin( width, height, spacing );
+    bin.progress = true;
+    bool ok = bin.insert( input );
     std::cout << "\n";
+    return ok;
+}
 
-    return true;
+// packs everything into one bin with skyline_bin. returns false if not
+// everything fit, in which case input is left holding the boxes that could
+// not be placed.
+template< typename T >
+bool bin_pack_skyline( std::vector< box<T>* >& input, T width, T height, T spacing ) {
+    skyline_bin<T> bin( width, height, spacing );
+    bin.progress = true;
+    bool ok = bin.insert( input );
+    std::cout << "\n";
+    return ok;
 }
 
 #endif
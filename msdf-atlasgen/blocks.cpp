@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <iterator>
+
+#include "blocks.h"
+
+// first codepoint of every block in Unicode 14's Blocks.txt
+static const uint32_t block_starts[] = {
+	0x00000, 0x00080, 0x00100, 0x00180, 0x00250, 0x002b0, 0x00300, 0x00370,
+	0x00400, 0x00500, 0x00530, 0x00590, 0x00600, 0x00700, 0x00750, 0x00780,
+	0x007c0, 0x00800, 0x00840, 0x00860, 0x00870, 0x008a0, 0x00900, 0x00980,
+	0x00a00, 0x00a80, 0x00b00, 0x00b80, 0x00c00, 0x00c80, 0x00d00, 0x00d80,
+	0x00e00, 0x00e80, 0x00f00, 0x01000, 0x010a0, 0x01100, 0x01200, 0x01380,
+	0x013a0, 0x01400, 0x01680, 0x016a0, 0x01700, 0x01720, 0x01740, 0x01760,
+	0x01780, 0x01800, 0x018b0, 0x01900, 0x01950, 0x01980, 0x019e0, 0x01a00,
+	0x01a20, 0x01ab0, 0x01b00, 0x01b80, 0x01bc0, 0x01c00, 0x01c50, 0x01c80,
+	0x01c90, 0x01cc0, 0x01cd0, 0x01d00, 0x01d80, 0x01dc0, 0x01e00, 0x01f00,
+	0x02000, 0x02070, 0x020a0, 0x020d0, 0x02100, 0x02150, 0x02190, 0x02200,
+	0x02300, 0x02400, 0x02440, 0x02460, 0x02500, 0x02580, 0x025a0, 0x02600,
+	0x02700, 0x027c0, 0x027f0, 0x02800, 0x02900, 0x02980, 0x02a00, 0x02b00,
+	0x02c00, 0x02c60, 0x02c80, 0x02d00, 0x02d30, 0x02d80, 0x02de0, 0x02e00,
+	0x02e80, 0x02f00, 0x02ff0, 0x03000, 0x03040, 0x030a0, 0x03100, 0x03130,
+	0x03190, 0x031a0, 0x031c0, 0x031f0, 0x03200, 0x03300, 0x03400, 0x04dc0,
+	0x04e00, 0x0a000, 0x0a490, 0x0a4d0, 0x0a500, 0x0a640, 0x0a6a0, 0x0a700,
+	0x0a720, 0x0a800, 0x0a830, 0x0a840, 0x0a880, 0x0a8e0, 0x0a900, 0x0a930,
+	0x0a960, 0x0a980, 0x0a9e0, 0x0aa00, 0x0aa60, 0x0aa80, 0x0aae0, 0x0ab00,
+	0x0ab30, 0x0ab70, 0x0abc0, 0x0ac00, 0x0d7b0, 0x0d800, 0x0db80, 0x0dc00,
+	0x0e000, 0x0f900, 0x0fb00, 0x0fb50, 0x0fe00, 0x0fe10, 0x0fe20, 0x0fe30,
+	0x0fe50, 0x0fe70, 0x0ff00, 0x0fff0, 0x10000, 0x10080, 0x10100, 0x10140,
+	0x10190, 0x101d0, 0x10280, 0x102a0, 0x102e0, 0x10300, 0x10330, 0x10350,
+	0x10380, 0x103a0, 0x10400, 0x10450, 0x10480, 0x104b0, 0x10500, 0x10530,
+	0x10570, 0x10600, 0x10780, 0x10800, 0x10840, 0x10860, 0x10880, 0x108e0,
+	0x10900, 0x10920, 0x10980, 0x109a0, 0x10a00, 0x10a60, 0x10a80, 0x10ac0,
+	0x10b00, 0x10b40, 0x10b60, 0x10b80, 0x10c00, 0x10c80, 0x10d00, 0x10e60,
+	0x10e80, 0x10f00, 0x10f30, 0x10f70, 0x10fb0, 0x10fe0, 0x11000, 0x11080,
+	0x110d0, 0x11100, 0x11150, 0x11180, 0x111e0, 0x11200, 0x11280, 0x112b0,
+	0x11300, 0x11400, 0x11480, 0x11580, 0x11600, 0x11660, 0x11680, 0x11700,
+	0x11800, 0x118a0, 0x11900, 0x119a0, 0x11a00, 0x11a50, 0x11ab0, 0x11ac0,
+	0x11c00, 0x11c70, 0x11d00, 0x11d60, 0x11ee0, 0x11fb0, 0x11fc0, 0x12000,
+	0x12400, 0x12480, 0x12f90, 0x13000, 0x13430, 0x14400, 0x16800, 0x16a40,
+	0x16a70, 0x16ad0, 0x16b00, 0x16e40, 0x16f00, 0x16fe0, 0x17000, 0x18800,
+	0x18b00, 0x18d00, 0x1aff0, 0x1b000, 0x1b100, 0x1b130, 0x1b170, 0x1bc00,
+	0x1bca0, 0x1cf00, 0x1d000, 0x1d100, 0x1d200, 0x1d2e0, 0x1d300, 0x1d360,
+	0x1d400, 0x1d800, 0x1df00, 0x1e000, 0x1e100, 0x1e290, 0x1e2c0, 0x1e7e0,
+	0x1e800, 0x1e900, 0x1ec70, 0x1ed00, 0x1ee00, 0x1f000, 0x1f030, 0x1f0a0,
+	0x1f100, 0x1f200, 0x1f300, 0x1f600, 0x1f650, 0x1f680, 0x1f700, 0x1f780,
+	0x1f800, 0x1f900, 0x1fa00, 0x1fa70, 0x1fb00, 0x20000, 0x2a700, 0x2b740,
+	0x2b820, 0x2ceb0, 0x2f800, 0x30000, 0xe0000, 0xe0100, 0xf0000, 0x100000,
+};
+
+uint32_t unicode_block( uint32_t codepoint ) {
+	const uint32_t* block = std::upper_bound( std::begin( block_starts ), std::end( block_starts ), codepoint );
+	return block == std::begin( block_starts ) ? 0 : *( block - 1 );
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// the first codepoint of the unicode block codepoint is in. codepoints
+// between blocks count as part of the block before them
+uint32_t unicode_block( uint32_t codepoint );
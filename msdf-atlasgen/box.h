@@ -40,11 +40,11 @@ struct box {
     T x, y, width, height;
 };
 
-bool overlap( const box<size_t>& a, const box<size_t>& b, size_t spacing ) {
+inline bool overlap( const box<size_t>& a, const box<size_t>& b, size_t spacing ) {
     return !(a.right() + spacing <= b.x || b.right() + spacing <= a.x || a.top() + spacing <= b.y || b.top() + spacing <= a.y);
 }
 
-void make_splits( box<size_t> a, box<size_t> b, std::vector< box< size_t > >& result, size_t spacing ) {
+inline void make_splits( box<size_t> a, box<size_t> b, std::vector< box< size_t > >& result, size_t spacing ) {
     result.clear();
 
     if( a.x + spacing < b.x ) {
@@ -64,15 +64,15 @@ void make_splits( box<size_t> a, box<size_t> b, std::vector< box< size_t > >& re
     }
 }
 
-bool can_fit( const box<size_t>& a, const box<size_t>& b ) {
+inline bool can_fit( const box<size_t>& a, const box<size_t>& b ) {
     return a.width >= b.width && a.height >= b.height;
 }
 
-bool contains( const box<size_t>& a, const box<size_t>& b ) {
+inline bool contains( const box<size_t>& a, const box<size_t>& b ) {
     return b.x >= a.x && b.y >= a.y && b.right() <= a.right() && b.top() <= a.top();
 }
 
-bool operator==( const box<size_t>& a, const box<size_t>& b ) {
+inline bool operator==( const box<size_t>& a, const box<size_t>& b ) {
     return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
 }
 
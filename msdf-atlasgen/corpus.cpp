@@ -0,0 +1,144 @@
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define CORPUS_SSE2 1
+#endif
+
+#include "corpus.h"
+#include "parallel.h"
+
+// codepoints in the BMP get counted in a flat array, which covers nearly
+// everything in practice, and the rest go in a map
+struct chunk_counts {
+	std::vector< uint64_t > bmp;
+	codepoint_counts astral;
+
+	chunk_counts() : bmp( 0x10000 ) { }
+};
+
+static bool is_continuation( unsigned char c ) {
+	return ( c & 0xc0 ) == 0x80;
+}
+
+static void count_utf8( const unsigned char* p, const unsigned char* end, chunk_counts& counts ) {
+	while( p < end ) {
+#if CORPUS_SSE2
+		// most text is mostly ASCII, so skip the decoder for runs of 16
+		// bytes with no high bits set
+		while( end - p >= 16 ) {
+			__m128i bytes = _mm_loadu_si128( ( const __m128i* ) p );
+			if( _mm_movemask_epi8( bytes ) != 0 ) {
+				break;
+			}
+			for( int i = 0; i < 16; i++ ) {
+				counts.bmp[ p[ i ] ]++;
+			}
+			p += 16;
+		}
+		if( p == end ) {
+			break;
+		}
+#endif
+
+		unsigned char c = *p;
+		uint32_t cp;
+		int len;
+
+		if( c < 0x80 ) {
+			counts.bmp[ c ]++;
+			p++;
+			continue;
+		}
+		else if( ( c & 0xe0 ) == 0xc0 ) { cp = c & 0x1f; len = 2; }
+		else if( ( c & 0xf0 ) == 0xe0 ) { cp = c & 0x0f; len = 3; }
+		else if( ( c & 0xf8 ) == 0xf0 ) { cp = c & 0x07; len = 4; }
+		else {
+			p++;
+			continue;
+		}
+
+		bool valid = end - p >= len;
+		for( int i = 1; valid && i < len; i++ ) {
+			valid = is_continuation( p[ i ] );
+			cp = ( cp << 6 ) | ( p[ i ] & 0x3f );
+		}
+
+		// overlong forms and surrogates aren't characters either
+		static const uint32_t min_cp[] = { 0, 0, 0x80, 0x800, 0x10000 };
+		if( !valid || cp < min_cp[ len ] || cp > 0x10ffff || ( cp >= 0xd800 && cp <= 0xdfff ) ) {
+			p++;
+			continue;
+		}
+
+		if( cp < 0x10000 ) {
+			counts.bmp[ cp ]++;
+		}
+		else {
+			counts.astral[ cp ]++;
+		}
+		p += len;
+	}
+}
+
+struct chunk {
+	const unsigned char* begin;
+	const unsigned char* end;
+};
+
+bool count_codepoints( const std::vector< std::string >& paths, codepoint_counts& counts ) {
+	std::vector< std::vector< unsigned char > > files;
+	for( const std::string& path : paths ) {
+		std::ifstream file( path, std::ios::in | std::ios::binary );
+		if( !file ) {
+			std::cout << "error: couldn't read corpus \"" << path << "\".\n";
+			return false;
+		}
+		file.seekg( 0, std::ios::end );
+		files.emplace_back( size_t( file.tellg() ) );
+		file.seekg( 0, std::ios::beg );
+		file.read( ( char* ) files.back().data(), files.back().size() );
+	}
+
+	// chunk boundaries get nudged forward onto the start of a character
+	const size_t chunk_size = 4 * 1024 * 1024;
+	std::vector< chunk > chunks;
+	for( const std::vector< unsigned char >& file : files ) {
+		const unsigned char* cursor = file.data();
+		const unsigned char* end = file.data() + file.size();
+		while( cursor < end ) {
+			const unsigned char* chunk_end = end - cursor > ptrdiff_t( chunk_size ) ? cursor + chunk_size : end;
+			while( chunk_end < end && is_continuation( *chunk_end ) ) {
+				chunk_end++;
+			}
+			chunks.push_back( chunk { cursor, chunk_end } );
+			cursor = chunk_end;
+		}
+	}
+
+	std::vector< uint64_t > bmp( 0x10000 );
+	std::mutex mutex;
+
+	parallel_for( chunks.size(), [&]( size_t i ) {
+		chunk_counts local;
+		count_utf8( chunks[ i ].begin, chunks[ i ].end, local );
+
+		std::lock_guard< std::mutex > lock( mutex );
+		for( size_t cp = 0; cp < local.bmp.size(); cp++ ) {
+			bmp[ cp ] += local.bmp[ cp ];
+		}
+		for( const auto& kv : local.astral ) {
+			counts[ kv.first ] += kv.second;
+		}
+	} );
+
+	for( size_t cp = 0; cp < bmp.size(); cp++ ) {
+		if( bmp[ cp ] > 0 ) {
+			counts[ uint32_t( cp ) ] += bmp[ cp ];
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef std::unordered_map< uint32_t, uint64_t > codepoint_counts;
+
+// counts how often each codepoint appears in a set of UTF-8 text files.
+// files are split into chunks that get scanned in parallel. invalid
+// sequences, overlong forms and surrogates are skipped
+bool count_codepoints( const std::vector< std::string >& paths, codepoint_counts& counts );
@@ -0,0 +1,245 @@
+#include <fstream>
+#include <string.h>
+
+#include <lodepng.h>
+
+#include "delta.h"
+
+using namespace msdfgen;
+
+static constexpr u32 DeltaMagic = 0x444c544d; // "MTLD"
+static constexpr u32 DeltaVersion = 1;
+
+enum DeltaFlags : u32 {
+	DeltaFlag_Reset = 1 << 0,
+};
+
+// dirty regions are found at this granularity, smaller cells mean tighter
+// rectangles but more of them
+static constexpr size_t CellSize = 16;
+
+struct delta_rect {
+	u32 page, x, y, width, height;
+};
+
+static u8 quantize( float x ) {
+	// same rounding as savePng
+	int i = int( x * 0x100 );
+	return u8( i < 0 ? 0 : i > 0xff ? 0xff : i );
+}
+
+template< typename T >
+static atlas_image quantize_image( const Bitmap< T >& bitmap ) {
+	const size_t channels = sizeof( T ) / sizeof( float );
+
+	atlas_image image;
+	image.width = bitmap.width();
+	image.height = bitmap.height();
+	image.channels = channels;
+	image.pixels.resize( image.width * image.height * channels );
+
+	u8* cursor = image.pixels.data();
+	for( int y = bitmap.height() - 1; y >= 0; --y ) {
+		for( int x = 0; x < bitmap.width(); ++x ) {
+			const float* texel = ( const float* ) &bitmap( x, y );
+			for( size_t i = 0; i < channels; ++i ) {
+				*cursor++ = quantize( texel[ i ] );
+			}
+		}
+	}
+
+	return image;
+}
+
+atlas_image quantize_image( const Bitmap< FloatRGB >& bitmap ) {
+	return quantize_image< FloatRGB >( bitmap );
+}
+
+atlas_image quantize_image( const Bitmap< FloatRGBA >& bitmap ) {
+	return quantize_image< FloatRGBA >( bitmap );
+}
+
+bool load_atlas_image( const std::string& path, size_t channels, atlas_image& image ) {
+	unsigned width, height;
+	image.pixels.clear();
+	if( lodepng::decode( image.pixels, width, height, path, channels == 4 ? LCT_RGBA : LCT_RGB ) != 0 ) {
+		return false;
+	}
+	image.width = width;
+	image.height = height;
+	image.channels = channels;
+	return true;
+}
+
+static bool same_glyph( const Glyph& a, const Glyph& b ) {
+	// compare the serialized bytes so padding doesn't get in the way
+	char bytes_a[ SerializedGlyphSize ];
+	char bytes_b[ SerializedGlyphSize ];
+	Serialize( a, bytes_a, sizeof( bytes_a ) );
+	Serialize( b, bytes_b, sizeof( bytes_b ) );
+	return memcmp( bytes_a, bytes_b, SerializedGlyphSize ) == 0;
+}
+
+static bool cell_differs( const atlas_image& a, const atlas_image& b, size_t cx, size_t cy ) {
+	size_t x0 = cx * CellSize;
+	size_t y0 = cy * CellSize;
+	size_t row_bytes = ( std::min( x0 + CellSize, a.width ) - x0 ) * a.channels;
+
+	for( size_t y = y0; y < std::min( y0 + CellSize, a.height ); ++y ) {
+		size_t offset = ( y * a.width + x0 ) * a.channels;
+		if( memcmp( &a.pixels[ offset ], &b.pixels[ offset ], row_bytes ) != 0 ) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// finds the cells that changed and merges them into rectangles. runs of
+// dirty cells along a row become one rectangle, and that grows downwards
+// while the rows below have a run with the same extent
+static void diff_images( const atlas_image& previous, const atlas_image& current, u32 page, std::vector< delta_rect >& rects ) {
+	size_t cells_x = ( current.width + CellSize - 1 ) / CellSize;
+	size_t cells_y = ( current.height + CellSize - 1 ) / CellSize;
+
+	// rectangles that ended on the previous cell row and can still grow
+	std::vector< size_t > open;
+
+	for( size_t cy = 0; cy < cells_y; ++cy ) {
+		std::vector< size_t > still_open;
+
+		for( size_t cx = 0; cx < cells_x; ++cx ) {
+			if( !cell_differs( previous, current, cx, cy ) ) {
+				continue;
+			}
+
+			size_t end = cx + 1;
+			while( end < cells_x && cell_differs( previous, current, end, cy ) ) {
+				end++;
+			}
+
+			u32 x = cx * CellSize;
+			u32 width = std::min( end * CellSize, current.width ) - x;
+			u32 y = cy * CellSize;
+			u32 height = std::min( y + CellSize, current.height ) - y;
+
+			bool grown = false;
+			for( size_t idx : open ) {
+				delta_rect& rect = rects[ idx ];
+				if( rect.x == x && rect.width == width ) {
+					rect.height += height;
+					still_open.push_back( idx );
+					grown = true;
+					break;
+				}
+			}
+
+			if( !grown ) {
+				rects.push_back( delta_rect { page, x, y, width, height } );
+				still_open.push_back( rects.size() - 1 );
+			}
+
+			cx = end;
+		}
+
+		open.swap( still_open );
+	}
+}
+
+static void SerializeFontHeader( SerializationBuffer * buf, Font & font ) {
+	*buf & font.glyph_padding & font.dSDF_dUV & font.ascent & font.flags & font.num_pages;
+	u32 num_glyphs = font.glyphs.size();
+	*buf & num_glyphs;
+}
+
+static void SerializeRect( SerializationBuffer * buf, delta_rect & rect, const atlas_image & image ) {
+	*buf & rect.page & rect.x & rect.y & rect.width & rect.height;
+
+	size_t row_bytes = rect.width * image.channels;
+	for( u32 y = rect.y; y < rect.y + rect.height; ++y ) {
+		if( buf->error || size_t( buf->end - buf->cursor ) < row_bytes ) {
+			buf->error = true;
+			return;
+		}
+		memcpy( buf->cursor, &image.pixels[ ( y * image.width + rect.x ) * image.channels ], row_bytes );
+		buf->cursor += row_bytes;
+	}
+}
+
+bool write_delta( const std::string& path, const std::string& previous_spec, std::function< std::string( size_t ) > image_path,
+		const Font& font, const std::vector< atlas_image >& images ) {
+	Font previous = { };
+	bool reset = !load_specification( previous_spec, previous ) || previous.flags != font.flags;
+
+	std::vector< atlas_image > previous_images( images.size() );
+	for( size_t page = 0; page < images.size() && !reset; ++page ) {
+		if( page >= std::max( previous.num_pages, u32( 1 ) ) ) {
+			// a new page, it gets sent in full below
+			continue;
+		}
+
+		const atlas_image& image = images[ page ];
+		atlas_image& old = previous_images[ page ];
+		if( !load_atlas_image( image_path( page ), image.channels, old ) || old.width != image.width || old.height != image.height ) {
+			reset = true;
+		}
+	}
+
+	std::vector< u32 > changed_glyphs;
+	for( size_t id = 0; id < font.glyphs.size(); ++id ) {
+		if( reset || id >= previous.glyphs.size() || !same_glyph( font.glyphs[ id ], previous.glyphs[ id ] ) ) {
+			changed_glyphs.push_back( id );
+		}
+	}
+
+	std::vector< delta_rect > rects;
+	for( size_t page = 0; page < images.size(); ++page ) {
+		const atlas_image& image = images[ page ];
+		if( reset || previous_images[ page ].pixels.empty() ) {
+			rects.push_back( delta_rect { u32( page ), 0, 0, u32( image.width ), u32( image.height ) } );
+		}
+		else {
+			diff_images( previous_images[ page ], image, page, rects );
+		}
+	}
+
+	const atlas_image& first = images[ 0 ];
+	size_t size = 11 * sizeof( u32 ) + 3 * sizeof( float );
+	size += changed_glyphs.size() * ( sizeof( u32 ) + SerializedGlyphSize );
+	for( const delta_rect& rect : rects ) {
+		size += 5 * sizeof( u32 ) + rect.width * rect.height * first.channels;
+	}
+
+	std::vector< char > buf( size );
+	SerializationBuffer sb( SerializationMode_Serializing, buf.data(), buf.size() );
+
+	u32 magic = DeltaMagic;
+	u32 version = DeltaVersion;
+	u32 flags = 0;
+	if( reset ) {
+		flags |= DeltaFlag_Reset;
+	}
+	u32 width = first.width;
+	u32 height = first.height;
+	u32 channels = first.channels;
+	sb & magic & version & flags & width & height & channels;
+
+	SerializeFontHeader( &sb, const_cast< Font & >( font ) );
+
+	u32 num_changed_glyphs = changed_glyphs.size();
+	sb & num_changed_glyphs;
+	for( u32 id : changed_glyphs ) {
+		sb & id & const_cast< Glyph & >( font.glyphs[ id ] );
+	}
+
+	u32 num_rects = rects.size();
+	sb & num_rects;
+	for( delta_rect& rect : rects ) {
+		SerializeRect( &sb, rect, images[ rect.page ] );
+	}
+	assert( !sb.error && sb.cursor == sb.end );
+
+	std::ofstream file( path, std::ios::out | std::ios::binary | std::ios::trunc );
+	file.write( buf.data(), buf.size() );
+	return bool( file );
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "msdfgen.h"
+#include "spec.h"
+
+// an atlas image the way it ends up in the png: 8 bits per channel with the
+// first row at the top
+struct atlas_image {
+	size_t width, height, channels;
+	std::vector< u8 > pixels;
+};
+
+atlas_image quantize_image( const msdfgen::Bitmap< msdfgen::FloatRGB >& bitmap );
+atlas_image quantize_image( const msdfgen::Bitmap< msdfgen::FloatRGBA >& bitmap );
+
+// channels is 3 for MSDF atlases and 4 for channel packed ones
+bool load_atlas_image( const std::string& path, size_t channels, atlas_image& image );
+
+// compares font and images with the spec and pngs currently on disk and
+// writes the difference to path. image_path maps a page to its png
+//
+// the delta file is laid out as:
+//
+//   u32 magic "MTLD", u32 version, u32 flags
+//   u32 image width, u32 image height, u32 channels
+//   glyph_padding, dSDF_dUV, ascent, flags, num_pages like in the spec
+//   u32 size of the glyph table
+//   u32 count, then count times { u32 id, Glyph }
+//   u32 count, then count times { u32 page, u32 x, u32 y, u32 width,
+//     u32 height, width * height * channels bytes of pixels }
+//
+// rectangles are in png coordinates, i.e. y = 0 is the top row. when
+// DeltaFlag_Reset is set the previous atlas couldn't be used, and the delta
+// holds every glyph and every page in full
+bool write_delta( const std::string& path, const std::string& previous_spec, std::function< std::string( size_t ) > image_path,
+	const Font& font, const std::vector< atlas_image >& images );
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+
+#include "embed.h"
+
+// raw bytes per band of rows. a band is one array in the source, and
+// compilers get slow on initializers much bigger than this. bands are
+// never cut mid row though, so a row wider than this gets a band to itself
+// and that band is bigger
+static constexpr size_t MaxBandBytes = 64 * 1024;
+
+static size_t rows_per_band( const atlas_image& image ) {
+	return std::max< size_t >( MaxBandBytes / std::max< size_t >( image.width * image.channels, 1 ), 1 );
+}
+
+std::string embedded_name( const std::string& output_file_name ) {
+	std::string base = output_file_name.substr( output_file_name.find_last_of( "/\\" ) + 1 );
+	std::string name;
+	for( char c : base ) {
+		bool alnum = ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' );
+		name += alnum ? c : '_';
+	}
+	if( name.empty() || ( name[ 0 ] >= '0' && name[ 0 ] <= '9' ) ) {
+		name = "font_" + name;
+	}
+	return name;
+}
+
+// enough digits to come back as the same float, always with a . or an e
+// so the f suffix is legal
+static std::string float_literal( float x ) {
+	char buf[ 32 ];
+	snprintf( buf, sizeof( buf ), "%.9g", x );
+	std::string literal = buf;
+	if( literal.find_first_of( ".e" ) == std::string::npos ) {
+		literal += ".0";
+	}
+	return literal + "f";
+}
+
+static std::string vec2_literal( const Vec2& v ) {
+	return "{ " + float_literal( v.x ) + ", " + float_literal( v.y ) + " }";
+}
+
+static std::string minmax2_literal( const MinMax2& b ) {
+	return "{ " + vec2_literal( b.mins ) + ", " + vec2_literal( b.maxs ) + " }";
+}
+
+static bool all_zero_bits( const float* x, size_t n ) {
+	for( size_t i = 0; i < n; ++i ) {
+		u32 bits;
+		memcpy( &bits, &x[ i ], sizeof( bits ) );
+		if( bits != 0 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// glyphs that weren't generated are left as {} to keep the source small
+static std::string glyph_literal( const Glyph& glyph ) {
+	float floats[] = { glyph.bounds.mins.x, glyph.bounds.mins.y, glyph.bounds.maxs.x, glyph.bounds.maxs.y,
+		glyph.uv_bounds.mins.x, glyph.uv_bounds.mins.y, glyph.uv_bounds.maxs.x, glyph.uv_bounds.maxs.y, glyph.advance };
+	if( all_zero_bits( floats, 9 ) && glyph.page == 0 && glyph.channel == 0 && glyph.rotated == 0 ) {
+		return "{}";
+	}
+	return "{ " + minmax2_literal( glyph.bounds ) + ", " + minmax2_literal( glyph.uv_bounds ) + ", " + float_literal( glyph.advance ) + ", "
+		+ std::to_string( glyph.page ) + ", " + std::to_string( glyph.channel ) + ", " + std::to_string( glyph.rotated ) + " }";
+}
+
+static void write_glyphs( std::ofstream& out, const std::string& array, const std::vector< Glyph >& glyphs ) {
+	out << "static const SpecGlyph " << array << "[] = {\n";
+	for( const Glyph& glyph : glyphs ) {
+		out << "\t" << glyph_literal( glyph ) << ",\n";
+	}
+	out << "};\n\n";
+}
+
+// see decode_embedded_band in specview.h
+static void encode_rle( const u8* pixels, size_t num_pixels, size_t pixel_size, std::vector< u8 >& out ) {
+	auto same = [&]( size_t a, size_t b ) {
+		return memcmp( pixels + a * pixel_size, pixels + b * pixel_size, pixel_size ) == 0;
+	};
+
+	size_t i = 0;
+	while( i < num_pixels ) {
+		size_t run = 1;
+		while( i + run < num_pixels && run < SpecMaxRepeatRun && same( i, i + run ) ) {
+			++run;
+		}
+		if( run > 1 ) {
+			out.push_back( u8( run + 126 ) );
+			out.insert( out.end(), pixels + i * pixel_size, pixels + ( i + 1 ) * pixel_size );
+			i += run;
+			continue;
+		}
+
+		// different pixels up to where the next repeat starts
+		size_t start = i;
+		while( i < num_pixels && i - start < SpecMaxLiteralRun && !( i + 1 < num_pixels && same( i, i + 1 ) ) ) {
+			++i;
+		}
+		out.push_back( u8( i - start - 1 ) );
+		out.insert( out.end(), pixels + start * pixel_size, pixels + i * pixel_size );
+	}
+}
+
+static void write_bytes( std::ofstream& out, const std::string& array, const std::vector< u8 >& bytes ) {
+	out << "static const uint8_t " << array << "[] = {";
+	std::string line;
+	for( size_t i = 0; i < bytes.size(); ++i ) {
+		if( i % 32 == 0 ) {
+			out << line << "\n\t";
+			line.clear();
+		}
+		line += std::to_string( bytes[ i ] );
+		line += ',';
+	}
+	out << line << "\n};\n\n";
+}
+
+bool write_embedded_header( const std::string& path, const std::string& name ) {
+	std::ofstream out( path, std::ios::out | std::ios::trunc );
+	out << "// written by msdf-atlasgen --embed, don't edit\n\n";
+	out << "#pragma once\n\n";
+	out << "#include \"specview.h\"\n\n";
+	out << "extern const SpecEmbeddedFont " << name << ";\n";
+	return bool( out );
+}
+
+bool write_embedded_source( const std::string& path, const std::string& header_name, const std::string& name,
+	const Font& font, const std::vector< atlas_image >& images, bool rle ) {
+	// there's always a page, and an empty _pages array wouldn't compile
+	assert( !images.empty() );
+
+	std::ofstream out( path, std::ios::out | std::ios::trunc );
+	out << "// written by msdf-atlasgen --embed, don't edit\n\n";
+	out << "#include \"" << header_name << "\"\n\n";
+
+	bool composites = ( font.flags & FontFlag_Composites ) != 0 && !font.component_glyphs.empty();
+	bool grid = ( font.flags & FontFlag_Grid ) != 0;
+
+	// everything else is prefixed with name so it can't clash with it
+	out << "static const SpecHeader " << name << "_header = { SpecMagic, SpecVersion, sizeof( SpecHeader ), SpecByteOrder, 0, "
+		<< float_literal( font.glyph_padding ) << ", " << float_literal( font.dSDF_dUV ) << ", " << float_literal( font.ascent ) << ", "
+		<< font.flags << "u, " << font.num_pages << "u, 0, 0, 0 };\n\n";
+
+	if( !font.glyphs.empty() ) {
+		write_glyphs( out, name + "_glyphs", font.glyphs );
+	}
+	if( composites ) {
+		write_glyphs( out, name + "_component_glyphs", font.component_glyphs );
+	}
+	if( !font.components.empty() ) {
+		out << "static const SpecComponent " << name << "_components[] = {\n";
+		for( const GlyphComponent& component : font.components ) {
+			out << "\t{ " << component.glyph << ", " << component.component << ", " << vec2_literal( component.offset ) << " },\n";
+		}
+		out << "};\n\n";
+	}
+	if( grid ) {
+		out << "static const SpecGrid " << name << "_grid = { " << font.grid_first << ", " << font.grid_columns << ", "
+			<< minmax2_literal( font.grid_cell_uv ) << ", " << vec2_literal( font.grid_pitch_uv ) << " };\n\n";
+	}
+
+	for( size_t page = 0; page < images.size(); ++page ) {
+		const atlas_image& image = images[ page ];
+		size_t row_bytes = image.width * image.channels;
+		size_t band_rows = rows_per_band( image );
+
+		std::string bands;
+		size_t num_bands = 0;
+		std::vector< u8 > bytes;
+		for( size_t row = 0; row < image.height; row += band_rows, ++num_bands ) {
+			size_t rows = std::min( band_rows, image.height - row );
+			const u8* first = image.pixels.data() + row * row_bytes;
+			bytes.clear();
+			if( rle ) {
+				encode_rle( first, rows * image.width, image.channels, bytes );
+			}
+			else {
+				bytes.assign( first, first + rows * row_bytes );
+			}
+
+			std::string array = name + "_page" + std::to_string( page ) + "_band" + std::to_string( num_bands );
+			write_bytes( out, array, bytes );
+			bands += "\t{ " + array + ", " + std::to_string( bytes.size() ) + ", " + std::to_string( row ) + ", " + std::to_string( rows ) + " },\n";
+		}
+
+		out << "static const SpecEmbeddedBand " << name << "_page" << page << "_bands[] = {\n" << bands << "};\n\n";
+	}
+
+	out << "static const SpecEmbeddedPage " << name << "_pages[] = {\n";
+	for( size_t page = 0; page < images.size(); ++page ) {
+		const atlas_image& image = images[ page ];
+		out << "\t{ " << image.width << ", " << image.height << ", " << image.channels << ", " << ( rle ? 1 : 0 ) << ", " << name << "_page" << page << "_bands, "
+			<< ( image.height + rows_per_band( image ) - 1 ) / rows_per_band( image ) << " },\n";
+	}
+	out << "};\n\n";
+
+	out << "extern const SpecEmbeddedFont " << name << " = {\n";
+	out << "\t{ &" << name << "_header, " << ( font.glyphs.empty() ? "NULL" : name + "_glyphs" ) << ", " << font.glyphs.size() << ", ";
+	out << ( composites ? name + "_component_glyphs" : "NULL" ) << ", " << ( composites ? font.component_glyphs.size() : 0 ) << ", ";
+	out << ( font.components.empty() ? "NULL" : name + "_components" ) << ", " << font.components.size() << ", ";
+	out << ( grid ? "&" + name + "_grid" : "NULL" ) << " },\n";
+	out << "\t" << name << "_pages, " << images.size() << ",\n";
+	out << "};\n";
+
+	return bool( out );
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "delta.h"
+#include "spec.h"
+
+// --embed. the atlas as C++ source, to be compiled into a program that
+// can't or won't load files: the header declares name as an extern const
+// SpecEmbeddedFont, see specview.h, and the source defines it with the
+// glyph tables and pixels as static const arrays, laid out the same way
+// as the .msdf file so nothing has to be read or parsed at startup. the
+// header includes specview.h, which has to be on the include path. with
+// rle the pixel bands are run length encoded
+
+// a C++ identifier made from the output name
+std::string embedded_name( const std::string& output_file_name );
+
+bool write_embedded_header( const std::string& path, const std::string& name );
+
+// header_name is how the source includes the header
+bool write_embedded_source( const std::string& path, const std::string& header_name, const std::string& name,
+	const Font& font, const std::vector< atlas_image >& images, bool rle );
@@ -26,221 +26,1698 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
 #include <boost/program_options.hpp>
 #include "msdfgen.h"
 #include "msdfgen-ext.h"
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include "freetype/freetype.h"
+#include "alloc.h"
+#include "atlas.h"
 #include "binpacking.h"
+#include "blocks.h"
+#include "corpus.h"
+#include "delta.h"
+#include "embed.h"
+#include "packing.h"
+#include "parallel.h"
+#include "perf.h"
+#include "spec.h"
+#include "tiles.h"
+#include "variations.h"
+#include "watch.h"
+#include "writer.h"
 
 #include "types.h"
 #include "serialization.h"
 
 using namespace msdfgen;
 
-struct texture_dimensions {
-	size_t width, height;
+enum class tex_rect_alignment {
+	lower_left,
+	upper_left,
+	upper_right,
+	lower_right,
+};
+
+box< double > bounds( const Shape& shape )
+{
+	double l = 500000;
+	double r = -5000000;
+	double t = -5000000;
+	double b = 5000000;
+	shape.bounds( l, b, r, t );
+
+	return { l, b, r - l, t - b };
+}
+
+// size of the texture glyphs get packed into, which is a page when paging
+static texture_dimensions atlas_dims( const settings& cfg ) {
+	if( cfg.page_size > 0 ) {
+		return texture_dimensions { cfg.page_size, cfg.page_size };
+	}
+	return cfg.tex_dims;
+}
+
+// first id and number of columns of a --grid atlas. cell n from the first
+// id is in column n % columns and row n / columns
+static void grid_layout( const std::vector< char_info >& charinfos, const settings& cfg, uint32_t& first, size_t& columns ) {
+	first = charinfos.front().id;
+	for( const auto& ch : charinfos ) {
+		first = std::min( first, ch.id );
+	}
+	columns = ( cfg.tex_dims.width + cfg.spacing ) / ( charinfos.front().placement.width + cfg.spacing );
+}
+
+static size_t count_pages( const std::vector< char_info >& charinfos ) {
+	size_t num_pages = 0;
+	for( const char_info & info : charinfos ) {
+		num_pages = std::max( num_pages, info.page + 1 );
+	}
+	return num_pages;
+}
+
+static void set_placement( Glyph & glyph, const char_info & info, texture_dimensions dims ) {
+	glyph.uv_bounds.mins.x = ( info.placement.x + 0.5f ) / dims.width;
+	glyph.uv_bounds.mins.y = 1.0f - ( info.placement.top() + 0.5f ) / dims.height;
+	glyph.uv_bounds.maxs.x = ( info.placement.right() + 0.5f ) / dims.width;
+	glyph.uv_bounds.maxs.y = 1.0f - ( info.placement.y + 0.5f ) / dims.height;
+
+	// turned clockwise the glyph's top left is the tile's top right, and
+	// its bottom right the tile's bottom left, see FontFlag_Rotated. the
+	// half texel offset along the glyph's x runs down the atlas now
+	if( info.rotated ) {
+		std::swap( glyph.uv_bounds.mins.x, glyph.uv_bounds.maxs.x );
+		glyph.uv_bounds.mins.y += 1.0f / dims.height;
+		glyph.uv_bounds.maxs.y += 1.0f / dims.height;
+	}
+
+	glyph.channel = info.channel;
+	glyph.page = info.page;
+	glyph.rotated = info.rotated;
+}
+
+// where texel ( x, y ) of ch's tile goes in the atlas
+static void atlas_texel( const char_info & ch, size_t x, size_t y, size_t & ax, size_t & ay ) {
+	if( ch.rotated ) {
+		ax = ch.placement.x + y;
+		ay = ch.placement.y + ch.tile_width() - 1 - x;
+	}
+	else {
+		ax = ch.placement.x + x;
+		ay = ch.placement.y + y;
+	}
+}
+
+static Font make_specification( const std::vector< char_info >& charinfos, const settings& cfg, double scaling ) {
+	const texture_dimensions dims = atlas_dims( cfg );
+
+	// component tiles sit wherever their outline puts them, which says
+	// nothing about the font's line height
+	auto encoded_end = std::partition_point( charinfos.begin(), charinfos.end(), []( auto& ch ) { return ch.id < UnencodedComponentBase; } );
+	auto max_y = max_element( charinfos.begin(), encoded_end, [](auto& a, auto& b) {return a.bbox.top() < b.bbox.top();});
+	auto min_y = min_element( charinfos.begin(), encoded_end, [](auto& a, auto& b) {return a.bbox.y < b.bbox.y;});
+	float scale = 1.0f / ( max_y->bbox.top() - min_y->bbox.y );
+
+	Font font = { };
+	font.glyph_padding = cfg.smoothpixels * scale;
+	font.dSDF_dUV = 1.0f / ( scaling * cfg.range );
+	font.ascent = scale * max_y->bbox.top();
+	if( cfg.single_channel ) {
+		font.flags |= FontFlag_ChannelPacked;
+	}
+	if( cfg.by_glyph_index ) {
+		font.flags |= FontFlag_GlyphIndexed;
+	}
+	if( cfg.page_size > 0 ) {
+		font.flags |= FontFlag_Paged;
+	}
+	if( cfg.composites ) {
+		font.flags |= FontFlag_Composites;
+	}
+	if( std::any_of( charinfos.begin(), charinfos.end(), []( auto& ch ) { return ch.rotated; } ) ) {
+		font.flags |= FontFlag_Rotated;
+	}
+	if( cfg.grid ) {
+		font.flags |= FontFlag_Grid;
+
+		size_t columns;
+		grid_layout( charinfos, cfg, font.grid_first, columns );
+		font.grid_columns = columns;
+
+		// the uv_bounds set_placement gives the first cell, and how far
+		// apart cells are in uv space
+		const box< size_t >& cell = charinfos.front().placement;
+		font.grid_cell_uv.mins.x = 0.5f / dims.width;
+		font.grid_cell_uv.mins.y = 1.0f - ( cell.height + 0.5f ) / dims.height;
+		font.grid_cell_uv.maxs.x = ( cell.width + 0.5f ) / dims.width;
+		font.grid_cell_uv.maxs.y = 1.0f - 0.5f / dims.height;
+		font.grid_pitch_uv.x = float( cell.width + cfg.spacing ) / dims.width;
+		font.grid_pitch_uv.y = -float( cell.height + cfg.spacing ) / dims.height;
+	}
+	font.num_pages = count_pages( charinfos );
+
+	uint32_t max_id = 0;
+	for( auto it = charinfos.begin(); it != encoded_end; ++it ) {
+		max_id = std::max( max_id, it->id );
+	}
+	font.glyphs.resize( max_id + 1 );
+	font.component_glyphs.resize( charinfos.end() - encoded_end );
+
+	for( const char_info & info : charinfos ) {
+		bool unencoded = info.id >= UnencodedComponentBase;
+		Glyph & glyph = unencoded ? font.component_glyphs[ info.id - UnencodedComponentBase ] : font.glyphs[ info.id ];
+
+		glyph.bounds.mins.x = scale * info.bbox.x;
+		glyph.bounds.mins.y = -scale * info.bbox.top();
+		glyph.bounds.maxs.x = scale * info.bbox.right();
+		glyph.bounds.maxs.y = -scale * info.bbox.y;
+
+		glyph.advance = scale * info.advance;
+		if( info.components.empty() ) {
+			set_placement( glyph, info, dims );
+		}
+
+		for( const glyph_component & component : info.components ) {
+			GlyphComponent entry;
+			entry.glyph = info.id;
+			entry.component = component.id < UnencodedComponentBase ? component.id : u32( font.glyphs.size() + component.id - UnencodedComponentBase );
+			entry.offset.x = scale * component.offset.x;
+			entry.offset.y = -scale * component.offset.y;
+			font.components.push_back( entry );
+		}
+	}
+
+	return font;
+}
+
+static void write_specification( const Font& font, const std::string& file_name, output_writer& writer ) {
+	auto buf = std::make_shared< std::vector< char > >( serialize_specification( font ) );
+
+	writer.push( file_name, [buf]( const std::string& path ) {
+		std::fstream desc( path, std::ios::out | std::ios::binary | std::ios::trunc );
+		desc.write( buf->data(), buf->size() );
+		return bool( desc );
+	} );
+}
+
+static std::shared_ptr< Bitmap< FloatRGBA > > build_channel_packed_image( const std::vector< char_info >& charinfos, const settings& cfg ) {
+	const size_t width  = cfg.tex_dims.width;
+	const size_t height = cfg.tex_dims.height;
+
+	auto bitmap = std::make_shared< Bitmap< FloatRGBA > >( width, height );
+	for( size_t y = 0; y < height; ++y ) {
+		for( size_t x = 0; x < width; ++x ) {
+			(*bitmap)( x, y ) = FloatRGBA { 0, 0, 0, 0 };
+		}
+	}
+
+	for( auto& ch : charinfos ) {
+		for( int y = 0; y < ch.sdf.height(); ++y ) {
+			for( int x = 0; x < ch.sdf.width(); ++x ) {
+				size_t ax, ay;
+				atlas_texel( ch, x, y, ax, ay );
+				float * texel = &(*bitmap)( ax, ay ).r;
+				texel[ ch.channel ] = ch.sdf( x, y );
+			}
+		}
+	}
+
+	return bitmap;
+}
+
+static std::shared_ptr< Bitmap< FloatRGB > > build_rgb_image( const std::vector< char_info >& charinfos, texture_dimensions dims, size_t page ) {
+	const size_t width  = dims.width;
+	const size_t height = dims.height;
+
+	// Bitmap doesn't clear its contents and the gaps between glyphs would
+	// otherwise be whatever was left on the heap
+	auto bitmap = std::make_shared< Bitmap< FloatRGB > >( width, height );
+	for( size_t y = 0; y < height; ++y ) {
+		for( size_t x = 0; x < width; ++x ) {
+			(*bitmap)( x, y ) = FloatRGB { 0, 0, 0 };
+		}
+	}
+
+	for( auto& ch : charinfos ) {
+		if( ch.page != page ) {
+			continue;
+		}
+		if( !ch.rotated ) {
+			bitmap->place( ch.placement.x, ch.placement.y, ch.bitmap );
+			continue;
+		}
+		for( int y = 0; y < ch.bitmap.height(); ++y ) {
+			for( int x = 0; x < ch.bitmap.width(); ++x ) {
+				size_t ax, ay;
+				atlas_texel( ch, x, y, ax, ay );
+				(*bitmap)( ax, ay ) = ch.bitmap( x, y );
+			}
+		}
+	}
+
+	return bitmap;
+}
+
+static std::string image_file_name( const std::string& output_file_name, bool paged, size_t page ) {
+	if( paged ) {
+		return output_file_name + ".page" + std::to_string( page ) + ".png";
+	}
+	return output_file_name + ".png";
+}
+
+// writes the atlas images, plus the spec and delta when font isn't null
+static void write_atlas( const std::vector< char_info >& charinfos, const settings& cfg, std::shared_ptr< Font > font, output_writer& writer ) {
+	std::shared_ptr< Bitmap< FloatRGBA > > packed;
+	std::vector< std::shared_ptr< Bitmap< FloatRGB > > > pages;
+	if( cfg.single_channel ) {
+		packed = build_channel_packed_image( charinfos, cfg );
+	}
+	else {
+		for( size_t page = 0; page < std::max( count_pages( charinfos ), size_t( 1 ) ); ++page ) {
+			pages.push_back( build_rgb_image( charinfos, atlas_dims( cfg ), page ) );
+		}
+	}
+
+	if( font && cfg.delta ) {
+		// the writer runs jobs in order, so this gets to see the outputs of
+		// the last build before they're replaced below
+		std::string base = cfg.output_file_name;
+		bool paged = cfg.page_size > 0;
+		writer.push( base + ".delta", [font, packed, pages, base, paged]( const std::string& path ) {
+			perf_scope scope( PerfStage_Encode );
+			std::vector< atlas_image > images;
+			if( packed ) {
+				images.push_back( quantize_image( *packed ) );
+			}
+			for( auto& page : pages ) {
+				images.push_back( quantize_image( *page ) );
+			}
+			auto image_path = [&]( size_t page ) { return image_file_name( base, paged, page ); };
+			return write_delta( path, base + ".msdf", image_path, *font, images );
+		} );
+	}
+
+	if( font && cfg.embed != Embed_None ) {
+		std::string name = embedded_name( cfg.output_file_name );
+		std::string header_name = cfg.output_file_name.substr( cfg.output_file_name.find_last_of( "/\\" ) + 1 ) + ".h";
+		bool rle = cfg.embed == Embed_RLE;
+		writer.push( cfg.output_file_name + ".h", [name]( const std::string& path ) {
+			return write_embedded_header( path, name );
+		} );
+		writer.push( cfg.output_file_name + ".cpp", [font, packed, pages, name, header_name, rle]( const std::string& path ) {
+			perf_scope scope( PerfStage_Encode );
+			std::vector< atlas_image > images;
+			if( packed ) {
+				images.push_back( quantize_image( *packed ) );
+			}
+			for( auto& page : pages ) {
+				images.push_back( quantize_image( *page ) );
+			}
+			return write_embedded_source( path, header_name, name, *font, images, rle );
+		} );
+	}
+
+	// the float to 8 bit conversion and deflate happen on the writer thread
+	if( packed ) {
+		writer.push( cfg.output_file_name + ".png", [packed]( const std::string& path ) {
+			perf_scope scope( PerfStage_Encode, uint64_t( packed->width() ) * packed->height() );
+			return savePng( *packed, path.c_str() );
+		} );
+	}
+	for( size_t page = 0; page < pages.size(); ++page ) {
+		auto bitmap = pages[ page ];
+		writer.push( image_file_name( cfg.output_file_name, cfg.page_size > 0, page ), [bitmap]( const std::string& path ) {
+			perf_scope scope( PerfStage_Encode, uint64_t( bitmap->width() ) * bitmap->height() );
+			return savePng( *bitmap, path.c_str() );
+		} );
+	}
+
+	// every file is renamed into place on its own, so the spec goes last:
+	// anything watching it for changes only reloads once the pages it
+	// points at are already there
+	if( font ) {
+		write_specification( *font, cfg.output_file_name + ".msdf", writer );
+	}
+	writer.end_atlas();
+}
+
+void write_outputs( const std::vector< char_info >& charinfos, const settings& cfg, double scaling, output_writer& writer ) {
+	write_atlas( charinfos, cfg, std::make_shared< Font >( make_specification( charinfos, cfg, scaling ) ), writer );
+}
+
+struct id_range {
+	uint32_t first, last;
+};
+
+// parses "32-126,0xa0,0x4e00-0x9fff"
+static bool parse_ranges( const std::string& str, std::vector< id_range >& ranges ) {
+	const char* cursor = str.c_str();
+	while( *cursor != '\0' ) {
+		char* end;
+		id_range range;
+		range.first = range.last = strtoul( cursor, &end, 0 );
+		if( end == cursor ) return false;
+		cursor = end;
+
+		if( *cursor == '-' ) {
+			++cursor;
+			range.last = strtoul( cursor, &end, 0 );
+			if( end == cursor || range.last < range.first ) return false;
+			cursor = end;
+		}
+
+		ranges.push_back( range );
+
+		if( *cursor == ',' ) {
+			++cursor;
+		}
+		else if( *cursor != '\0' ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool in_ranges( uint32_t id, const std::vector< id_range >& ranges ) {
+	for( const id_range& range : ranges ) {
+		if( id >= range.first && id <= range.last ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// --priority, already checked by parse_options
+static std::vector< id_range > priority_ranges( const settings& cfg ) {
+	std::vector< id_range > ranges;
+	parse_ranges( cfg.priority, ranges );
+	return ranges;
+}
+
+static uint64_t frequency( uint32_t id, const settings& cfg ) {
+	auto it = cfg.frequencies.find( id );
+	return it == cfg.frequencies.end() ? 0 : it->second;
+}
+
+// keeps the most frequent glyphs until they cover the requested fraction
+// of the corpus. glyphs the corpus never uses are dropped, apart from
+// space and tab, which cost nothing to keep and text can't do without
+static std::vector< uint32_t > select_by_coverage( const std::vector< uint32_t >& charset, const settings& cfg ) {
+	std::vector< std::pair< uint64_t, uint32_t > > used;
+	uint64_t total = 0;
+	for( uint32_t id : charset ) {
+		uint64_t count = frequency( id, cfg );
+		if( count > 0 ) {
+			used.emplace_back( count, id );
+			total += count;
+		}
+	}
+
+	std::sort( used.begin(), used.end(), []( const auto& a, const auto& b ) {
+		return a.first != b.first ? a.first > b.first : a.second < b.second;
+	} );
+
+	std::vector< uint32_t > result;
+	uint64_t covered = 0;
+	for( const auto& glyph : used ) {
+		if( covered >= cfg.coverage * total ) {
+			break;
+		}
+		result.push_back( glyph.second );
+		covered += glyph.first;
+	}
+
+	if( !cfg.by_glyph_index ) {
+		for( uint32_t id : charset ) {
+			if( ( id == ' ' || id == '\t' ) && std::find( result.begin(), result.end(), id ) == result.end() ) {
+				result.push_back( id );
+			}
+		}
+	}
+
+	std::cout << "keeping " << result.size() << " of " << charset.size() << " glyphs to cover " << cfg.coverage * 100.0 << "% of the corpus.\n";
+
+	std::sort( result.begin(), result.end() );
+	return result;
+}
+
+// the corpus counts codepoints, in glyph index mode they have to go through
+// the charmap. several codepoints can map to the same glyph
+static void map_frequencies_to_glyphs( FontHandle* font, settings& cfg ) {
+	codepoint_counts glyph_counts;
+	for( const auto& kv : cfg.frequencies ) {
+		FT_UInt glyph = FT_Get_Char_Index( font->face, kv.first );
+		if( glyph != 0 ) {
+			glyph_counts[ glyph ] += kv.second;
+		}
+	}
+	cfg.frequencies.swap( glyph_counts );
+}
+
+// codepoints (or glyph indices) the font has glyphs for. instances of a
+// variable font share a charmap so this only needs doing once
+std::vector< uint32_t > lookup_charset( FontHandle* font, const settings& cfg ) {
+	std::vector< uint32_t > result;
+
+	std::vector< id_range > ranges;
+	if( cfg.charset.empty() ) {
+		// a font with no glyphs at all gets nothing rather than a range
+		// ending at num_glyphs - 1 wrapped round
+		if( cfg.by_glyph_index && font->face->num_glyphs <= 0 ) {
+			return result;
+		}
+		uint32_t last = cfg.by_glyph_index ? uint32_t( font->face->num_glyphs - 1 ) : 255;
+		ranges.push_back( id_range { 0, last } );
+	}
+	else if( !parse_ranges( cfg.charset, ranges ) ) {
+		std::cout << "bad charset \"" << cfg.charset << "\".\n";
+		return result;
+	}
+
+	for( id_range range : ranges ) {
+		for( uint32_t i = range.first; i <= range.last && i >= range.first; ++i ) {
+			if( cfg.by_glyph_index ) {
+				if( i < uint32_t( font->face->num_glyphs ) ) {
+					result.push_back( i );
+				}
+			}
+			else if( i == ' ' || i == '\t' || FT_Get_Char_Index( font->face, i ) != 0 ) {
+				result.push_back( i );
+			}
+		}
+	}
+
+	std::sort( result.begin(), result.end() );
+	result.erase( std::unique( result.begin(), result.end() ), result.end() );
+
+	if( !cfg.frequencies.empty() ) {
+		result = select_by_coverage( result, cfg );
+	}
+
+	return result;
+}
+
+// the native decoder is thread safe, FreeType is only used when the font
+// isn't one it handles or a glyph failed, and has to be serialized
+static bool load_shape( FontHandle* font, const SfntFont* outlines, std::mutex& freetype_mutex, uint32_t id, const settings& cfg, Shape& shape, double& advance ) {
+	// unmapped codepoints get glyph 0, .notdef, which loads fine but isn't
+	// the codepoint's. FreeType gets asked too in case its cmap knows better
+	if( outlines != NULL ) {
+		unsigned glyph = cfg.by_glyph_index ? id : getSfntGlyphIndex( outlines, id );
+		if( ( glyph != 0 || cfg.by_glyph_index ) && loadSfntGlyph( shape, outlines, glyph, &advance ) ) {
+			return true;
+		}
+	}
+
+	std::lock_guard< std::mutex > lock( freetype_mutex );
+	if( cfg.by_glyph_index ) {
+		return loadGlyphByIndex( shape, font, id, &advance );
+	}
+	return FT_Get_Char_Index( font->face, id ) != 0 && loadGlyph( shape, font, id, &advance );
+}
+
+// outlines can be NULL, in which case everything goes through FreeType
+std::vector< char_info > read_shapes( FontHandle* font, const SfntFont* outlines, const std::vector< uint32_t >& charset, const settings& cfg ) {
+	double space_advance, tab_advance;
+	bool have_whitespace = getFontWhitespaceWidth( space_advance, tab_advance, font );
+
+	// every id gets its own slot so the result stays in charset order
+	std::vector< std::vector< char_info > > slots( charset.size() );
+	std::mutex freetype_mutex;
+
+	auto load = [&]( size_t idx ) {
+		uint32_t i = charset[ idx ];
+		std::vector< char_info >& slot = slots[ idx ];
+		Shape shape;
+		double advance;
+
+		if( cfg.by_glyph_index ) {
+			// blank glyphs still have an advance the shaper might want
+			if( load_shape( font, outlines, freetype_mutex, i, cfg, shape, advance ) ) {
+				box< double > thebox = shape.contours.empty() ? box< double >() : bounds( shape );
+				shape.normalize();
+				slot.emplace_back( i, thebox.width > 0 ? thebox : box< double >(), shape, advance );
+			}
+			return;
+		}
+
+		// lookup_charset keeps these even when the font doesn't map them,
+		// and loading them anyway would give the .notdef box a second
+		// entry under the same id
+		if( i == ' ' || i == '\t' ) {
+			if( have_whitespace ) {
+				slot.emplace_back( i, box< double >(), Shape(), i == ' ' ? space_advance : tab_advance );
+			}
+			return;
+		}
+
+		if( load_shape( font, outlines, freetype_mutex, i, cfg, shape, advance ) ) {
+			box< double > thebox = bounds( shape );
+			shape.normalize();
+			if( thebox.width > 0 ) {
+				slot.emplace_back( i, thebox, shape, advance );
+			}
+		}
+	};
+
+	auto read = [&]( size_t idx ) {
+		perf_scope scope( PerfStage_OutlineLoad );
+		load( idx );
+		// keyed by the tile's id like generate_tile does, and skipped for
+		// glyphs that don't make it into the atlas
+		if( !slots[ idx ].empty() ) {
+			record_glyph( slots[ idx ].front().id, scope.elapsed(), 0 );
+		}
+	};
+
+	if( outlines != NULL ) {
+		parallel_for( charset.size(), read );
+	}
+	else {
+		for( size_t idx = 0; idx < charset.size(); ++idx ) {
+			read( idx );
+		}
+	}
+
+	std::vector< char_info > result;
+	for( auto& slot : slots ) {
+		for( auto& ch : slot ) {
+			result.push_back( std::move( ch ) );
+		}
+	}
+
+	return result;
+}
+
+// --grid. every glyph is rendered into a cell covering all of them, from
+// the pen position to the widest advance and from the lowest descender to
+// the highest ascender, so bounds and tile size are the same for all and
+// only the cell's position depends on the glyph
+static void fit_grid_cells( std::vector< char_info >& charinfos, const settings& cfg ) {
+	double left = 0, bottom = 0, right = 0, top = 0;
+	bool have_bounds = false;
+	for( const auto& ch : charinfos ) {
+		right = std::max( right, ch.advance );
+		if( ch.bbox.width <= 0 ) {
+			continue;
+		}
+		left = std::min( left, ch.bbox.x );
+		right = std::max( right, ch.bbox.right() );
+		bottom = have_bounds ? std::min( bottom, ch.bbox.y ) : ch.bbox.y;
+		top = have_bounds ? std::max( top, ch.bbox.top() ) : ch.bbox.top();
+		have_bounds = true;
+	}
+
+	box< double > cell { left, bottom, right - left, top - bottom };
+	for( auto& ch : charinfos ) {
+		ch.bbox = cell;
+		ch.translation = Vector2( -cell.x + cfg.smoothpixels, -cell.y + cfg.smoothpixels );
+		ch.placement.width  = static_cast<int>( ceil( cell.width )  + 2*cfg.smoothpixels );
+		ch.placement.height = static_cast<int>( ceil( cell.height ) + 2*cfg.smoothpixels );
+	}
+}
+
+// scales everything to the target char height and works out tile sizes.
+// cheap compared to generating the tiles, and needs every glyph in the
+// charset even when only some of them get generated
+double measure_charset( std::vector< char_info >& charinfos, const settings& cfg ) {
+	double maxheight = 0;
+
+	for( auto& ch : charinfos ) {
+		maxheight = std::max( ch.bbox.height, maxheight );
+	}
+
+	double scaling = double(cfg.max_char_height) / maxheight;
+
+	for( auto& ch : charinfos ) {
+		ch.bbox.scale( scaling );
+		ch.advance *= scaling;
+		for( glyph_component& component : ch.components ) {
+			component.offset *= scaling;
+		}
+
+		float ceil_width  = ceil( ch.bbox.width );
+		float ceil_height = ceil( ch.bbox.height );
+
+		int width  = static_cast<int>( ceil_width  + 2*cfg.smoothpixels );
+		int height = static_cast<int>( ceil_height + 2*cfg.smoothpixels );
+
+		Vector2 offset( -ch.bbox.x + cfg.smoothpixels, -ch.bbox.y + cfg.smoothpixels );
+		ch.translation = offset;
+		ch.placement.width  = width;
+		ch.placement.height = height;
+	}
+
+	if( cfg.grid ) {
+		fit_grid_cells( charinfos, cfg );
+	}
+
+	return scaling;
+}
+
+// generateMSDF's default. error correction is run separately so it can be
+// counted as its own stage
+static constexpr double EdgeThreshold = 1.00000001;
+
+void generate_tile( char_info& ch, const settings& cfg, double scaling ) {
+	// drawn from the tiles of its components
+	if( !ch.components.empty() ) {
+		return;
+	}
+
+	int width  = ch.tile_width();
+	int height = ch.tile_height();
+	uint64_t pixels = uint64_t( width ) * height;
+	perf_sample start = read_perf_counters();
+
+	if( cfg.single_channel ) {
+		perf_scope scope( PerfStage_Generation, pixels );
+		ch.sdf = Bitmap< float >( width, height );
+		generateSDF( ch.sdf, ch.shape, cfg.range, scaling, ch.translation / scaling );
+	}
+	else {
+		{
+			perf_scope scope( PerfStage_Coloring );
+			edgeColoringSimple( ch.shape, 2.5 );
+		}
+		{
+			perf_scope scope( PerfStage_Generation, pixels );
+			ch.bitmap = Bitmap< FloatRGB >( width, height );
+			generateMSDF( ch.bitmap, ch.shape, cfg.range, scaling, ch.translation / scaling, 0 );
+		}
+		{
+			perf_scope scope( PerfStage_ErrorCorrection, pixels );
+			Vector2 scale( scaling );
+			msdfErrorCorrection( ch.bitmap, EdgeThreshold / ( scale * cfg.range ) );
+		}
+	}
+
+	if( perf_counters_enabled() ) {
+		record_glyph( ch.id, read_perf_counters() - start, pixels );
+	}
+}
+
+// leaf components of a composite glyph with the offsets of every level
+// added up. components that are composites themselves but can't be split
+// (scaled, rotated, ...) count as leaves, loaded whole. false if the glyph
+// isn't a composite that can be split
+static bool flatten_components( const SfntFont* outlines, unsigned glyph, Vector2 offset, int depth, std::vector< std::pair< unsigned, Vector2 > >& leaves ) {
+	std::vector< SfntComponent > components;
+	if( depth >= 8 || !getSfntGlyphComponents( components, outlines, glyph ) ) {
+		return false;
+	}
+
+	for( const SfntComponent& component : components ) {
+		Vector2 at = offset + Vector2( component.dx, component.dy );
+		if( !flatten_components( outlines, component.glyphIndex, at, depth + 1, leaves ) ) {
+			leaves.emplace_back( component.glyphIndex, at );
+		}
+	}
+	return true;
+}
+
+// --composites. composite glyphs keep their bounds and advance but lose
+// their shape, and point at the tiles of their components instead. those
+// reuse glyphs that are in the charset anyway where possible, the rest are
+// added as extra tiles (by glyph index, or past UnencodedComponentBase)
+static void split_composites( std::vector< char_info >& charinfos, const SfntFont* outlines, const settings& cfg ) {
+	perf_scope scope( PerfStage_OutlineLoad );
+	static constexpr uint32_t Blank = UINT32_MAX;
+
+	auto glyph_index = [&]( uint32_t id ) { return cfg.by_glyph_index ? id : getSfntGlyphIndex( outlines, id ); };
+
+	// glyph index to the id of the tile showing it, or Blank if nothing
+	// needs drawing
+	std::map< unsigned, uint32_t > tiles;
+	std::vector< std::vector< std::pair< unsigned, Vector2 > > > leaves( charinfos.size() );
+	std::vector< bool > composite( charinfos.size(), false );
+	for( size_t i = 0; i < charinfos.size(); ++i ) {
+		unsigned glyph = glyph_index( charinfos[ i ].id );
+		// an unmapped codepoint (space or tab, see read_shapes) isn't .notdef
+		if( glyph == 0 && !cfg.by_glyph_index ) {
+			continue;
+		}
+		composite[ i ] = flatten_components( outlines, glyph, Vector2(), 0, leaves[ i ] );
+		if( !composite[ i ] && charinfos[ i ].bbox.width > 0 ) {
+			tiles.emplace( glyph, charinfos[ i ].id );
+		}
+	}
+
+	std::vector< char_info > added;
+	uint32_t next_unencoded = UnencodedComponentBase;
+	size_t num_composites = 0;
+
+	for( size_t i = 0; i < charinfos.size(); ++i ) {
+		if( !composite[ i ] ) {
+			continue;
+		}
+		char_info& ch = charinfos[ i ];
+
+		for( const auto& leaf : leaves[ i ] ) {
+			auto it = tiles.find( leaf.first );
+			if( it == tiles.end() ) {
+				uint32_t id = Blank;
+				Shape shape;
+				double advance;
+				if( loadSfntGlyph( shape, outlines, leaf.first, &advance ) && !shape.contours.empty() ) {
+					box< double > thebox = bounds( shape );
+					shape.normalize();
+					if( thebox.width > 0 ) {
+						id = cfg.by_glyph_index ? leaf.first : next_unencoded++;
+						added.emplace_back( id, thebox, shape, advance );
+					}
+				}
+				it = tiles.emplace( leaf.first, id ).first;
+			}
+
+			if( it->second != Blank ) {
+				ch.components.push_back( glyph_component { it->second, leaf.second } );
+			}
+		}
+
+		// a composite of nothing but blanks is left alone, it has no bounds
+		// worth a tile either way
+		if( !ch.components.empty() ) {
+			ch.shape = Shape();
+			num_composites++;
+		}
+	}
+
+	std::cout << "split " << num_composites << " composite glyphs, adding " << added.size() << " component tiles.\n";
+
+	for( char_info& ch : added ) {
+		charinfos.push_back( std::move( ch ) );
+	}
+	// spec building relies on the unencoded tiles coming last
+	std::stable_sort( charinfos.begin(), charinfos.end(), []( const char_info& a, const char_info& b ) { return a.id < b.id; } );
+}
+
+// everything but generating the tiles
+std::vector< char_info > load_charset( FontHandle* font, const SfntFont* outlines, const std::vector< uint32_t >& charset, const settings& cfg, double& scaling ) {
+	auto charinfos = read_shapes( font, outlines, charset, cfg );
+	if( cfg.composites && outlines != NULL ) {
+		split_composites( charinfos, outlines, cfg );
+	}
+	else if( cfg.composites ) {
+		std::cout << "warning: --composites needs a font the native decoder reads, composite glyphs get whole tiles.\n";
+	}
+	scaling = measure_charset( charinfos, cfg );
+	return charinfos;
+}
+
+static std::string shard_file_name( const settings& cfg ) {
+	return cfg.output_file_name + "." + std::to_string( cfg.shard.index ) + ".tiles";
+}
+
+// generates the glyphs whose id falls into this shard and writes them to a
+// tile file for --merge to pick up
+void run_shard( FontHandle* font, const SfntFont* outlines, const std::vector< uint32_t >& charset, const settings& cfg ) {
+	std::cout << "building chars for shard " << cfg.shard.index << "/" << cfg.shard.count << "...\n";
+
+	auto charinfos = read_shapes( font, outlines, charset, cfg );
+	double scaling = measure_charset( charinfos, cfg );
+
+	std::vector< const char_info* > tiles;
+	for( auto& ch : charinfos ) {
+		if( ch.id % cfg.shard.count == cfg.shard.index ) {
+			generate_tile( ch, cfg, scaling );
+			tiles.push_back( &ch );
+		}
+	}
+
+	tile_header header;
+	header.shard = cfg.shard;
+	header.scaling = scaling;
+	header.smoothpixels = cfg.smoothpixels;
+	header.range = cfg.range;
+	header.single_channel = cfg.single_channel;
+	header.by_glyph_index = cfg.by_glyph_index;
+
+	if( !write_tiles( shard_file_name( cfg ), header, tiles ) ) {
+		std::cout << "error: couldn't write \"" << shard_file_name( cfg ) << "\".\n";
+	}
+}
+
+// packs into as many pages as it takes. glyphs from the same unicode block
+// are kept on one page where possible, so a run of text in one script
+// touches few pages. glyph indices say nothing about script, so by glyph
+// index everything is one group and just gets spilled over the pages
+template< typename Bin >
+static bool pack_pages( std::vector< char_info >& charinfos, const settings& cfg ) {
+	auto group = [&]( uint32_t id ) { return cfg.by_glyph_index ? 0 : unicode_block( id ); };
+
+	std::map< uint32_t, std::vector< char_info* > > block_map;
+	std::map< uint32_t, uint64_t > block_frequency;
+	for( auto& ch : charinfos ) {
+		if( !ch.components.empty() ) {
+			continue;
+		}
+		block_map[ group( ch.id ) ].push_back( &ch );
+		block_frequency[ group( ch.id ) ] += frequency( ch.id, cfg );
+	}
+
+	// blocks with --priority glyphs go first, then with a corpus the most
+	// used blocks, so they land on the lowest pages
+	std::vector< id_range > priority = priority_ranges( cfg );
+	std::map< uint32_t, bool > block_priority;
+	for( auto& ch : charinfos ) {
+		block_priority[ group( ch.id ) ] = block_priority[ group( ch.id ) ] || in_ranges( ch.id, priority );
+	}
+
+	std::vector< std::pair< uint32_t, std::vector< char_info* > > > blocks( block_map.begin(), block_map.end() );
+	std::stable_sort( blocks.begin(), blocks.end(), [&]( const auto& a, const auto& b ) {
+		if( block_priority[ a.first ] != block_priority[ b.first ] ) {
+			return block_priority[ a.first ];
+		}
+		return block_frequency[ a.first ] > block_frequency[ b.first ];
+	} );
+
+	std::vector< Bin > pages;
+	std::vector< size_t > used_area;
+
+	for( auto& block : blocks ) {
+		std::vector< box< size_t >* > pending;
+		size_t block_area = 0;
+		for( char_info* ch : block.second ) {
+			pending.push_back( &ch->placement );
+			block_area += ch->placement.width * ch->placement.height;
+		}
+
+		// first try to fit the whole block onto a page that's already open
+		bool placed = false;
+		for( size_t i = 0; i < pages.size() && !placed; ++i ) {
+			if( used_area[ i ] + block_area > cfg.page_size * cfg.page_size ) {
+				continue;
+			}
+
+			Bin trial = pages[ i ];
+			std::vector< box< size_t >* > trial_input = pending;
+			if( trial.insert( trial_input ) ) {
+				pages[ i ] = trial;
+				used_area[ i ] += block_area;
+				for( char_info* ch : block.second ) {
+					ch->page = i;
+				}
+				placed = true;
+			}
+		}
+
+		// otherwise open new pages, spilling onto as many as it takes
+		while( !placed ) {
+			pages.emplace_back( cfg.page_size, cfg.page_size, cfg.spacing );
+			pages.back().rotate = cfg.rotate;
+			used_area.push_back( 0 );
+
+			std::set< box< size_t >* > before( pending.begin(), pending.end() );
+			placed = pages.back().insert( pending );
+			std::set< box< size_t >* > after( pending.begin(), pending.end() );
+
+			if( !pages.back().used ) {
+				std::cout << "error: glyph doesn't fit on a " << cfg.page_size << "x" << cfg.page_size << " page.\n";
+				return false;
+			}
+
+			for( char_info* ch : block.second ) {
+				if( before.count( &ch->placement ) && !after.count( &ch->placement ) ) {
+					ch->page = pages.size() - 1;
+					used_area.back() += ch->placement.width * ch->placement.height;
+				}
+			}
+		}
+	}
+
+	std::cout << "packed into " << pages.size() << " pages.\n";
+	return true;
+}
+
+// with a corpus, glyphs are split into tiers covering the most frequent
+// 50%, 90% and 99% of the text, plus the rest. tiers are packed hottest
+// first so common glyphs end up clustered together. without a corpus
+// everything is one tier
+static std::vector< std::vector< char_info* > > frequency_tiers( std::vector< char_info >& charinfos, const settings& cfg ) {
+	std::vector< std::vector< char_info* > > tiers( 1 );
+	if( cfg.frequencies.empty() ) {
+		for( auto& ch : charinfos ) {
+			if( ch.components.empty() ) {
+				tiers[ 0 ].push_back( &ch );
+			}
+		}
+		return tiers;
+	}
+
+	std::vector< char_info* > sorted;
+	uint64_t total = 0;
+	for( auto& ch : charinfos ) {
+		if( !ch.components.empty() ) {
+			continue;
+		}
+		sorted.push_back( &ch );
+		total += frequency( ch.id, cfg );
+	}
+	std::stable_sort( sorted.begin(), sorted.end(), [&]( const char_info* a, const char_info* b ) {
+		return frequency( a->id, cfg ) > frequency( b->id, cfg );
+	} );
+
+	const double thresholds[] = { 0.5, 0.9, 0.99 };
+	uint64_t covered = 0;
+	for( char_info* ch : sorted ) {
+		if( tiers.size() <= 3 && covered >= thresholds[ tiers.size() - 1 ] * total && !tiers.back().empty() ) {
+			tiers.emplace_back();
+		}
+		tiers.back().push_back( ch );
+		covered += frequency( ch->id, cfg );
+	}
+
+	return tiers;
+}
+
+// --priority glyphs get a tier of their own ahead of everything else, so
+// they're placed before the rest is even generated
+static void split_priority_tier( std::vector< std::vector< char_info* > >& tiers, const settings& cfg ) {
+	std::vector< id_range > priority = priority_ranges( cfg );
+	if( priority.empty() ) {
+		return;
+	}
+
+	std::vector< char_info* > first;
+	for( auto& tier : tiers ) {
+		auto rest = std::stable_partition( tier.begin(), tier.end(), [&]( char_info* ch ) { return in_ranges( ch->id, priority ); } );
+		first.insert( first.end(), tier.begin(), rest );
+		tier.erase( tier.begin(), rest );
+	}
+	tiers.insert( tiers.begin(), first );
+}
+
+// --grid needs no packing, every glyph goes into the cell its id says
+static bool place_grid( std::vector< char_info >& charinfos, const settings& cfg ) {
+	if( charinfos.empty() ) {
+		return true;
+	}
+
+	uint32_t first;
+	size_t columns;
+	grid_layout( charinfos, cfg, first, columns );
+
+	for( auto& ch : charinfos ) {
+		size_t cell = ch.id - first;
+		ch.channel = 0;
+		ch.page = 0;
+		if( columns > 0 ) {
+			ch.placement.x = ( cell % columns ) * ( ch.placement.width + cfg.spacing );
+			ch.placement.y = ( cell / columns ) * ( ch.placement.height + cfg.spacing );
+		}
+		if( columns == 0 || ch.placement.top() > cfg.tex_dims.height ) {
+			std::cout << "\nerror: a grid of " << ch.placement.width << "x" << ch.placement.height << " cells doesn't fit the texture.\n";
+			return false;
+		}
+	}
+
+	std::cout << "\n";
+	return true;
+}
+
+// the tiles in the order pack_boxes takes them: tiers of indices into
+// boxes, which are copies of the placements
+static void packing_input( std::vector< char_info >& charinfos, const settings& cfg, std::vector< std::vector< size_t > >& tiers, std::vector< box< size_t > >& boxes, std::vector< size_t >& channels ) {
+	std::vector< std::vector< char_info* > > tier_ptrs = frequency_tiers( charinfos, cfg );
+	split_priority_tier( tier_ptrs, cfg );
+
+	for( const auto& tier : tier_ptrs ) {
+		tiers.emplace_back();
+		for( char_info* ch : tier ) {
+			tiers.back().push_back( ch - charinfos.data() );
+		}
+	}
+
+	for( const auto& ch : charinfos ) {
+		boxes.push_back( ch.placement );
+		channels.push_back( ch.channel );
+	}
+}
+
+static bool pack_channels( std::vector< char_info >& charinfos, const settings& cfg ) {
+	std::vector< std::vector< size_t > > tiers;
+	std::vector< box< size_t > > boxes;
+	std::vector< size_t > channels;
+	packing_input( charinfos, cfg, tiers, boxes, channels );
+
+	// in channel packed mode every channel is its own bin, and whatever
+	// didn't fit into one channel spills into the next
+	size_t left = pack_boxes( tiers, boxes, channels, cfg, true );
+
+	for( size_t i = 0; i < charinfos.size(); ++i ) {
+		charinfos[ i ].placement = boxes[ i ];
+		charinfos[ i ].channel = channels[ i ];
+	}
+
+	if( left > 0 ) {
+		std::cout << "bin packing failed with " << left << " characters left to be placed.\n";
+		return false;
+	}
+
+	return true;
+}
+
+static bool place_tiles( std::vector< char_info >& charinfos, const settings& cfg ) {
+	if( cfg.grid ) {
+		return place_grid( charinfos, cfg );
+	}
+
+	if( cfg.page_size > 0 ) {
+		if( cfg.packer == Packer_Skyline ) {
+			return pack_pages< skyline_bin< size_t > >( charinfos, cfg );
+		}
+		return pack_pages< max_rect_bin< size_t > >( charinfos, cfg );
+	}
+
+	return pack_channels( charinfos, cfg );
+}
+
+// --fit-texture. shrinks cfg.tex_dims to the smallest texture the tiles
+// pack into. that only takes their sizes, so it runs before anything gets
+// generated
+static bool fit_texture_size( std::vector< char_info >& charinfos, settings& cfg ) {
+	if( cfg.fit_texture == Fit_None ) {
+		return true;
+	}
+	perf_scope scope( PerfStage_Packing );
+
+	std::vector< std::vector< size_t > > tiers;
+	std::vector< box< size_t > > boxes;
+	std::vector< size_t > channels;
+	packing_input( charinfos, cfg, tiers, boxes, channels );
+
+	std::cout << "fitting texture...";
+	texture_dimensions dims;
+	size_t tried;
+	if( !fit_texture( tiers, boxes, channels, cfg, dims, tried ) ) {
+		std::cout << "\nerror: the glyphs don't fit even a " << dims.width << "x" << dims.height << " texture.\n";
+		return false;
+	}
+	std::cout << " " << dims.width << "x" << dims.height << " after " << tried << " trial packings.\n";
+
+	cfg.tex_dims = dims;
+	return true;
+}
+
+bool build_atlas( std::vector< char_info >& charinfos, const settings& cfg ) {
+	perf_scope scope( PerfStage_Packing );
+
+	// the packers take tiles upright. they never turn square ones, so a
+	// tile came back turned exactly when its width changed
+	std::vector< size_t > widths;
+	for( auto& ch : charinfos ) {
+		ch.placement.width = ch.tile_width();
+		ch.placement.height = ch.tile_height();
+		ch.rotated = false;
+		widths.push_back( ch.placement.width );
+	}
+
+	bool ok = place_tiles( charinfos, cfg );
+
+	for( size_t i = 0; i < charinfos.size(); ++i ) {
+		charinfos[ i ].rotated = charinfos[ i ].placement.width != widths[ i ];
+	}
+
+	return ok;
+}
+
+// writes what's been generated so far. everything already has its final
+// spot, glyphs that aren't ready yet are just left out of the spec and
+// blank in the image
+static void write_progress( const std::vector< char_info >& charinfos, const std::vector< bool >& ready, const settings& cfg, double scaling, output_writer& writer ) {
+	auto font = std::make_shared< Font >( make_specification( charinfos, cfg, scaling ) );
+	for( size_t i = 0; i < charinfos.size(); ++i ) {
+		if( !ready[ i ] ) {
+			font->glyphs[ charinfos[ i ].id ] = Glyph();
+		}
+	}
+	write_atlas( charinfos, cfg, font, writer );
+}
+
+// --priority. everything is measured and packed up front, since tile
+// sizes only depend on the outlines. then the priority glyphs are
+// generated and written as a usable atlas, and the rest follows in
+// batches, each rewriting the outputs (and delta) with what's done
+void run_progressive( FontHandle* font, const SfntFont* outlines, const std::vector< uint32_t >& charset, const settings& cfg, output_writer& writer ) {
+	typedef std::chrono::steady_clock clock_type;
+	clock_type::time_point start = clock_type::now();
+	// formatted on its own stream so cout's precision is left alone
+	auto elapsed = [&]() {
+		std::ostringstream ss;
+		ss << std::fixed << std::setprecision( 3 ) << std::chrono::duration< double >( clock_type::now() - start ).count();
+		return ss.str();
+	};
+
+	auto charinfos = read_shapes( font, outlines, charset, cfg );
+	double scaling = measure_charset( charinfos, cfg );
+
+	settings fitted = cfg;
+	if( !fit_texture_size( charinfos, fitted ) ) {
+		return;
+	}
+
+	std::cout << "packing atlas...";
+	if( !build_atlas( charinfos, fitted ) ) {
+		std::cout << "error: packing atlas failed.\n";
+		return;
+	}
+
+	std::vector< id_range > priority = priority_ranges( cfg );
+	std::vector< size_t > first, rest;
+	for( size_t i = 0; i < charinfos.size(); ++i ) {
+		( in_ranges( charinfos[ i ].id, priority ) ? first : rest ).push_back( i );
+	}
+	// with a corpus the common glyphs are worth having sooner
+	std::stable_sort( rest.begin(), rest.end(), [&]( size_t a, size_t b ) {
+		return frequency( charinfos[ a ].id, cfg ) > frequency( charinfos[ b ].id, cfg );
+	} );
+
+	std::vector< bool > ready( charinfos.size(), false );
+	for( size_t i : first ) {
+		generate_tile( charinfos[ i ], cfg, scaling );
+		ready[ i ] = true;
+	}
+	write_progress( charinfos, ready, fitted, scaling, writer );
+	std::cout << "first atlas with " << first.size() << " priority glyphs queued after " << elapsed() << "s.\n";
+
+	size_t batch_size = cfg.batch_size > 0 ? cfg.batch_size : rest.size();
+	for( size_t done = 0; done < rest.size(); ) {
+		size_t end = std::min( done + batch_size, rest.size() );
+		for( ; done < end; ++done ) {
+			generate_tile( charinfos[ rest[ done ] ], cfg, scaling );
+			ready[ rest[ done ] ] = true;
+		}
+		write_progress( charinfos, ready, fitted, scaling, writer );
+		std::cout << "queued atlas with " << first.size() + done << " of " << charinfos.size() << " glyphs after " << elapsed() << "s.\n";
+	}
+}
+
+void run( FontHandle* font, const SfntFont* outlines, const std::vector< uint32_t >& charset, const settings& cfg, output_writer& writer ) {
+	std::cout << "using char height " << cfg.max_char_height << ".\n";
+
+	if( cfg.shard.count > 0 ) {
+		run_shard( font, outlines, charset, cfg );
+		return;
+	}
+
+	if( !cfg.priority.empty() ) {
+		run_progressive( font, outlines, charset, cfg, writer );
+		return;
+	}
+
+	double scaling;
+	auto charinfos = load_charset( font, outlines, charset, cfg, scaling );
+
+	settings fitted = cfg;
+	if( !fit_texture_size( charinfos, fitted ) ) {
+		return;
+	}
+
+	std::cout << "building chars...\n";
+	for( auto& ch : charinfos ) {
+		generate_tile( ch, cfg, scaling );
+	}
+
+	std::cout << "packing atlas...";
+	if( !build_atlas( charinfos, fitted ) ) {
+		std::cout << "error: packing atlas failed.\n";
+		return;
+	}
+
+	write_outputs( charinfos, fitted, scaling, writer );
+}
+
+void run_instances( FreetypeHandle* ft, FontHandle* font, const std::vector< unsigned char >& font_data, const std::vector< uint32_t >& charset, const settings& cfg, output_writer& writer ) {
+	std::vector< font_instance > instances;
+	if( !resolve_instances( font, cfg.instances, instances ) ) {
+		return;
+	}
+
+	// FreeType faces aren't thread safe, so every instance gets its own. face
+	// creation touches the library so do that up front on this thread
+	std::vector< FontHandle* > faces;
+	for( const font_instance& instance : instances ) {
+		FontHandle* face = loadFontData( ft, font_data.data(), long( font_data.size() ) );
+		if( face == NULL || !apply_instance( face, instance ) ) {
+			std::cout << "error: couldn't set up instance \"" << instance.label << "\".\n";
+			if( face != NULL ) {
+				destroyFont( face );
+			}
+			for( FontHandle* f : faces ) {
+				destroyFont( f );
+			}
+			return;
+		}
+		faces.push_back( face );
+	}
+
+	parallel_for( instances.size(), [&]( size_t i ) {
+		settings instance_cfg = cfg;
+		instance_cfg.output_file_name = cfg.output_file_name + "-" + instances[ i ].label;
+		// the native decoder doesn't apply variations, so instances stay on FreeType
+		run( faces[ i ], NULL, charset, instance_cfg, writer );
+	} );
+
+	for( FontHandle* face : faces ) {
+		destroyFont( face );
+	}
+}
+
+struct watch_state {
+	double scaling = 0;
+	std::vector< char_info > charinfos;
+	std::vector< uint64_t > hashes;
 };
 
-enum class tex_rect_alignment {
-	lower_left,
-	upper_left,
-	upper_right,
-	lower_right,
-};
+// waits for the writer and reports what it did after since was taken
+static void print_writer_stats( output_writer& writer, const writer_stats& since ) {
+	writer.flush();
+
+	writer_stats stats = writer.stats();
+	size_t written = stats.files_written - since.files_written;
+	size_t failed = stats.files_failed - since.files_failed;
+	if( written + failed == 0 ) {
+		return;
+	}
+
+	std::ios::fmtflags flags = std::cout.flags();
+	std::streamsize precision = std::cout.precision();
+	std::cout << std::fixed << std::setprecision( 3 );
+	std::cout << "wrote " << written << " files in " << stats.busy_seconds - since.busy_seconds << "s";
+	std::cout << ", generation stalled " << stats.stall_seconds - since.stall_seconds << "s waiting on the writer.\n";
+	if( failed > 0 ) {
+		std::cout << "error: " << failed << " files couldn't be written.\n";
+	}
+	std::cout.flags( flags );
+	std::cout.precision( precision );
+}
+
+// rebuilds the atlas reusing everything it can from the last build. only
+// glyphs whose outlines changed get regenerated, and glyphs keep their spot
+// in the atlas unless a tile changed size
+void rebuild( FontHandle* font, const SfntFont* outlines, const settings& cfg, watch_state& state, output_writer& writer ) {
+	std::vector< uint32_t > charset = lookup_charset( font, cfg );
+	if( charset.empty() ) {
+		std::cout << "error: no glyphs to generate.\n";
+		return;
+	}
+
+	auto charinfos = read_shapes( font, outlines, charset, cfg );
+	std::vector< uint64_t > hashes;
+	for( auto& ch : charinfos ) {
+		hashes.push_back( hash_shape( ch.shape ) );
+	}
+	double scaling = measure_charset( charinfos, cfg );
+
+	std::map< uint32_t, size_t > previous;
+	for( size_t i = 0; i < state.charinfos.size(); ++i ) {
+		previous[ state.charinfos[ i ].id ] = i;
+	}
+
+	bool repack = scaling != state.scaling || charinfos.size() != state.charinfos.size();
+	size_t regenerated = 0;
 
-struct settings {
-	texture_dimensions tex_dims;
+	for( size_t i = 0; i < charinfos.size(); ++i ) {
+		char_info& ch = charinfos[ i ];
+		auto it = previous.find( ch.id );
+		const char_info* old = it == previous.end() ? NULL : &state.charinfos[ it->second ];
 
-	size_t max_char_height;
-	bool auto_height;
+		if( old != NULL && old->tile_width() == ch.tile_width() && old->tile_height() == ch.tile_height() ) {
+			ch.placement = old->placement;
+			ch.rotated = old->rotated;
+			ch.channel = old->channel;
+			ch.page = old->page;
+		}
+		else {
+			repack = true;
+		}
 
-	size_t spacing;
-	size_t smoothpixels;
-	double range;
+		// with --grid a font edit can move every glyph within its cell, so
+		// the tile has to have been drawn at the same spot and size too
+		bool same_tile = old != NULL && old->translation.x == ch.translation.x && old->translation.y == ch.translation.y
+			&& old->tile_width() == ch.tile_width() && old->tile_height() == ch.tile_height();
+		if( same_tile && scaling == state.scaling && state.hashes[ it->second ] == hashes[ i ] ) {
+			ch.bitmap = old->bitmap;
+			ch.sdf = old->sdf;
+		}
+		else {
+			generate_tile( ch, cfg, scaling );
+			regenerated++;
+		}
+	}
 
-	std::string font_file_name;
-	std::string output_file_name;
-};
+	if( repack ) {
+		std::cout << "packing atlas...";
+		if( !build_atlas( charinfos, cfg ) ) {
+			std::cout << "error: packing atlas failed.\n";
+			return;
+		}
+	}
 
-struct char_info {
-	char_info( int cp, box< double > box, Shape s, double adv )
-		: codepoint( cp ), bbox( box ), shape( s), advance( adv )
-	{}
-
-	int codepoint;
-	box< double > bbox;
-	box<size_t> placement;
-	Shape shape;
-	Vector2 translation;
-	double advance;
-	Bitmap< FloatRGB > bitmap;
-};
+	write_outputs( charinfos, cfg, scaling, writer );
 
-box< double > bounds( const Shape& shape )
-{
-	double l = 500000;
-	double r = -5000000;
-	double t = -5000000;
-	double b = 5000000;
-	shape.bounds( l, b, r, t );
+	std::cout << "regenerated " << regenerated << " of " << charinfos.size() << " glyphs" << ( repack ? ", repacked" : "" ) << ".\n";
 
-	return { l, b, r - l, t - b };
+	state.scaling = scaling;
+	state.charinfos.swap( charinfos );
+	state.hashes.swap( hashes );
 }
 
-struct Glyph {
-	MinMax2 bounds;
-	MinMax2 uv_bounds;
-	float advance;
-};
+static std::vector< unsigned char > read_font_file( const std::string& path ) {
+	std::ifstream file( path, std::ios::in | std::ios::binary );
+	return std::vector< unsigned char >( ( std::istreambuf_iterator< char >( file ) ), std::istreambuf_iterator< char >() );
+}
 
-struct Font {
-	float glyph_padding;
-	float dSDF_dUV;
-	float ascent;
+void run_watch( FreetypeHandle* ft, const settings& cfg, output_writer& writer ) {
+	// start watching before the first build so we can't miss a save
+	file_watcher watcher( cfg.font_file_name );
+	watch_state state;
 
-	Glyph glyphs[ 256 ];
-};
+	while( true ) {
+		std::vector< unsigned char > font_data = read_font_file( cfg.font_file_name );
+		FontHandle* font = loadFontData( ft, font_data.data(), long( font_data.size() ) );
+		if( font ) {
+			SfntFont* outlines = loadSfnt( font_data.data(), font_data.size() );
+			settings build_cfg = cfg;
+			if( cfg.by_glyph_index ) {
+				map_frequencies_to_glyphs( font, build_cfg );
+			}
+			writer_stats before = writer.stats();
+			rebuild( font, outlines, build_cfg, state, writer );
+			print_writer_stats( writer, before );
+			if( outlines != NULL ) {
+				destroySfnt( outlines );
+			}
+			destroyFont( font );
+		}
+		else {
+			std::cout << "Could not open font \"" << cfg.font_file_name << "\".\n";
+		}
 
-static void Serialize( SerializationBuffer * buf, Font & font ) {
-	*buf & font.glyph_padding & font.dSDF_dUV & font.ascent;
-	for( Glyph & glyph : font.glyphs ) {
-		*buf & glyph.bounds & glyph.uv_bounds & glyph.advance;
+		std::cout << "watching \"" << cfg.font_file_name << "\" for changes...\n";
+		if( !watcher.wait_for_change() ) {
+			std::cout << "error: couldn't watch \"" << cfg.font_file_name << "\".\n";
+			return;
+		}
 	}
 }
 
-static void write_specification( std::vector< char_info >& charinfos, const settings& cfg, double scaling ) {
-	std::fstream desc(cfg.output_file_name+".msdf", std::ios::out | std::ios::binary | std::ios::trunc );
+// packs the tile files of every shard into the final atlas
+void run_merge( const settings& cfg, output_writer& writer ) {
+	std::vector< char_info > charinfos;
+	std::vector< bool > have_shard;
+	tile_header first = { };
 
-	auto max_y = max_element( charinfos.begin(), charinfos.end(), [](auto& a, auto& b) {return a.bbox.top() < b.bbox.top();});
-	auto min_y = min_element( charinfos.begin(), charinfos.end(), [](auto& a, auto& b) {return a.bbox.y < b.bbox.y;});
-	float scale = 1.0f / ( max_y->bbox.top() - min_y->bbox.y );
+	for( const std::string& path : cfg.merge_files ) {
+		tile_header header;
+		if( !read_tiles( path, header, charinfos ) ) {
+			std::cout << "error: couldn't read tiles from \"" << path << "\".\n";
+			return;
+		}
 
-	char buf[ sizeof( Font ) ];
-	Font font = { };
-	font.glyph_padding = cfg.smoothpixels * scale;
-	font.dSDF_dUV = 1.0f / ( scaling * cfg.range );
-	font.ascent = scale * max_y->bbox.top();
+		if( have_shard.empty() ) {
+			first = header;
+			have_shard.resize( header.shard.count );
+		}
 
-	for( const char_info & info : charinfos ) {
-		Glyph & glyph = font.glyphs[ info.codepoint ];
+		bool compatible = header.shard.count == first.shard.count && header.scaling == first.scaling
+			&& header.smoothpixels == first.smoothpixels && header.range == first.range
+			&& header.single_channel == first.single_channel && header.by_glyph_index == first.by_glyph_index;
+		if( !compatible || header.shard.index >= have_shard.size() || have_shard[ header.shard.index ] ) {
+			std::cout << "error: \"" << path << "\" doesn't belong with the other shards.\n";
+			return;
+		}
+		have_shard[ header.shard.index ] = true;
+	}
 
-		glyph.bounds.mins.x = scale * info.bbox.x;
-		glyph.bounds.mins.y = -scale * info.bbox.top();
-		glyph.bounds.maxs.x = scale * info.bbox.right();
-		glyph.bounds.maxs.y = -scale * info.bbox.y;
+	for( size_t i = 0; i < have_shard.size(); ++i ) {
+		if( !have_shard[ i ] ) {
+			std::cout << "error: shard " << i << "/" << have_shard.size() << " is missing.\n";
+			return;
+		}
+	}
+
+	if( charinfos.empty() ) {
+		std::cout << "error: no glyphs to merge.\n";
+		return;
+	}
 
-		glyph.uv_bounds.mins.x = ( info.placement.x + 0.5f ) / cfg.tex_dims.width;
-		glyph.uv_bounds.mins.y = 1.0f - ( info.placement.top() + 0.5f ) / cfg.tex_dims.height;
-		glyph.uv_bounds.maxs.x = ( info.placement.right() + 0.5f ) / cfg.tex_dims.width;
-		glyph.uv_bounds.maxs.y = 1.0f - ( info.placement.y + 0.5f ) / cfg.tex_dims.height;
+	// pack in the same order regardless of how the files were listed
+	std::sort( charinfos.begin(), charinfos.end(), []( const char_info& a, const char_info& b ) { return a.id < b.id; } );
 
-		glyph.advance = scale * info.advance;
+	settings merged_cfg = cfg;
+	merged_cfg.smoothpixels = first.smoothpixels;
+	merged_cfg.range = first.range;
+	merged_cfg.single_channel = first.single_channel;
+	merged_cfg.by_glyph_index = first.by_glyph_index;
+
+	if( merged_cfg.by_glyph_index && !merged_cfg.frequencies.empty() ) {
+		std::cout << "warning: can't map corpus codepoints to glyph indices without the font, ignoring --corpus.\n";
+		merged_cfg.frequencies.clear();
+	}
+
+	if( !fit_texture_size( charinfos, merged_cfg ) ) {
+		return;
+	}
+
+	std::cout << "packing atlas...";
+	if( !build_atlas( charinfos, merged_cfg ) ) {
+		std::cout << "error: packing atlas failed.\n";
+		return;
 	}
 
-	bool ok = Serialize( font, buf, sizeof( buf ) );
-	assert( ok );
-	desc.write( buf, sizeof( buf ) );
+	write_outputs( charinfos, merged_cfg, first.scaling, writer );
 }
 
-void write_image( const std::vector< char_info >& charinfos, const settings& cfg ) {
-	const size_t width  = cfg.tex_dims.width;
-	const size_t height = cfg.tex_dims.height;
+// an atlas written by an earlier run, read back in for --repack
+struct source_atlas {
+	std::string label;
+	Font font;
+	std::vector< atlas_image > images;
+};
 
-	Bitmap< FloatRGB > bitmap = Bitmap< FloatRGB >( width, height );
-	for( auto& ch : charinfos ) {
-		bitmap.place( ch.placement.x, ch.placement.y, ch.bitmap );
+static bool load_atlas( const std::string& name, source_atlas& atlas ) {
+	if( !load_specification( name + ".msdf", atlas.font ) ) {
+		std::cout << "error: couldn't read \"" << name << ".msdf\".\n";
+		return false;
+	}
+
+	if( atlas.font.flags & FontFlag_Composites ) {
+		std::cout << "error: \"" << name << ".msdf\" has composite glyphs, which can't be repacked.\n";
+		return false;
 	}
-	savePng( bitmap, (cfg.output_file_name + ".png").c_str() );
+
+	bool paged = ( atlas.font.flags & FontFlag_Paged ) != 0;
+	size_t channels = ( atlas.font.flags & FontFlag_ChannelPacked ) != 0 ? 4 : 3;
+	size_t num_pages = paged ? atlas.font.num_pages : 1;
+
+	atlas.images.resize( num_pages );
+	for( size_t page = 0; page < num_pages; ++page ) {
+		std::string path = image_file_name( name, paged, page );
+		if( !load_atlas_image( path, channels, atlas.images[ page ] ) ) {
+			std::cout << "error: couldn't read \"" << path << "\".\n";
+			return false;
+		}
+	}
+
+	size_t slash = name.find_last_of( "/\\" );
+	atlas.label = slash == std::string::npos ? name : name.substr( slash + 1 );
+
+	return true;
 }
 
-std::vector< char_info > read_shapes( FontHandle* font, const settings& cfg ) {
-	std::vector< char_info > result;
+// cuts a glyph's tile back out of its atlas using the uv_bounds the spec
+// was written with. the 8 bit texels are turned back into floats that
+// quantize to the same values, so repacking is lossless
+static bool extract_tile( const source_atlas& atlas, const Glyph& glyph, char_info& ch ) {
+	if( glyph.page >= atlas.images.size() ) {
+		return false;
+	}
+	const atlas_image& image = atlas.images[ glyph.page ];
 
-	for( uint32_t i = 0; i <= 255; ++i ) {
-		Shape shape;
-		double advance;
-		if( i == ' ' || i == '\t' ) {
-			double spaceAdvance, tabAdvance;
-			if( !getFontWhitespaceWidth( spaceAdvance, tabAdvance, font ) )
-				continue;
+	// turned tiles are read back upright
+	bool rotated = glyph.uv_bounds.mins.x > glyph.uv_bounds.maxs.x;
+	float left = std::min( glyph.uv_bounds.mins.x, glyph.uv_bounds.maxs.x );
+	float right = std::max( glyph.uv_bounds.mins.x, glyph.uv_bounds.maxs.x );
+	long x = lround( left * image.width - 0.5 );
+	long y = lround( ( 1.0 - glyph.uv_bounds.maxs.y ) * image.height + ( rotated ? 0.5 : -0.5 ) );
+	long atlas_width = lround( ( right - left ) * image.width );
+	long atlas_height = lround( ( glyph.uv_bounds.maxs.y - glyph.uv_bounds.mins.y ) * image.height );
+
+	if( x < 0 || y < 0 || atlas_width <= 0 || atlas_height <= 0 || size_t( x + atlas_width ) > image.width || size_t( y + atlas_height ) > image.height ) {
+		return false;
+	}
+
+	long width = rotated ? atlas_height : atlas_width;
+	long height = rotated ? atlas_width : atlas_height;
+	ch.placement.width = width;
+	ch.placement.height = height;
 
-			result.emplace_back( i, box< double >(), Shape(), i == ' ' ? spaceAdvance : tabAdvance );
+	auto texel = [&]( long tx, long ty, size_t channel ) {
+		if( rotated ) {
+			std::swap( tx, ty );
+			ty = width - 1 - ty;
 		}
+		// pngs are stored top row first, bitmaps bottom row first
+		size_t row = image.height - 1 - ( y + ty );
+		u8 value = image.pixels[ ( row * image.width + x + tx ) * image.channels + channel ];
+		return ( value + 0.5f ) / 256.0f;
+	};
 
-		if( FT_Get_Char_Index( font->face, i ) != 0 && loadGlyph( shape, font, i, &advance ) ) {
-			box< double > thebox = bounds( shape );
-			shape.normalize();
-			if( thebox.width > 0 ) {
-				result.emplace_back( i, thebox, shape, advance );
+	if( image.channels == 4 ) {
+		ch.sdf = Bitmap< float >( width, height );
+		for( long ty = 0; ty < height; ++ty ) {
+			for( long tx = 0; tx < width; ++tx ) {
+				ch.sdf( tx, ty ) = texel( tx, ty, glyph.channel );
+			}
+		}
+	}
+	else {
+		ch.bitmap = Bitmap< FloatRGB >( width, height );
+		for( long ty = 0; ty < height; ++ty ) {
+			for( long tx = 0; tx < width; ++tx ) {
+				ch.bitmap( tx, ty ) = FloatRGB { texel( tx, ty, 0 ), texel( tx, ty, 1 ), texel( tx, ty, 2 ) };
 			}
 		}
 	}
 
-	return result;
+	return true;
 }
 
-std::vector< char_info > build_charset( FontHandle* font, const settings& cfg, double& scaling ) {
-	auto charinfos = read_shapes( font, cfg );
-	double maxheight = 0;
+static bool has_tile( const Glyph& glyph ) {
+	return glyph.uv_bounds.maxs.x != glyph.uv_bounds.mins.x && glyph.uv_bounds.maxs.y > glyph.uv_bounds.mins.y;
+}
 
-	for( auto& ch : charinfos ) {
-		maxheight = std::max( ch.bbox.height, maxheight );
+// packs glyphs cut out of existing atlases into one new atlas, optionally
+// keeping only a subset of them. no distance fields get generated. every
+// input keeps its own spec, pointing into the shared atlas
+void run_repack( const settings& cfg, output_writer& writer ) {
+	std::vector< source_atlas > atlases( cfg.repack_files.size() );
+	for( size_t i = 0; i < atlases.size(); ++i ) {
+		if( !load_atlas( cfg.repack_files[ i ], atlases[ i ] ) ) {
+			return;
+		}
+
+		bool channel_packed = ( atlases[ i ].font.flags & FontFlag_ChannelPacked ) != 0;
+		if( channel_packed != ( ( atlases[ 0 ].font.flags & FontFlag_ChannelPacked ) != 0 ) ) {
+			std::cout << "error: can't mix channel packed and MSDF atlases.\n";
+			return;
+		}
+
+		for( size_t j = 0; j < i; ++j ) {
+			if( atlases[ j ].label == atlases[ i ].label && atlases.size() > 1 ) {
+				std::cout << "error: two inputs are called \"" << atlases[ i ].label << "\".\n";
+				return;
+			}
+		}
 	}
 
-	scaling = double(cfg.max_char_height) / maxheight;
+	std::vector< id_range > ranges;
+	if( !cfg.charset.empty() && !parse_ranges( cfg.charset, ranges ) ) {
+		std::cout << "bad charset \"" << cfg.charset << "\".\n";
+		return;
+	}
 
-	for( auto& ch : charinfos ) {
-		ch.bbox.scale( scaling );
-		ch.advance *= scaling;
+	settings repack_cfg = cfg;
+	repack_cfg.single_channel = ( atlases[ 0 ].font.flags & FontFlag_ChannelPacked ) != 0;
 
-		float ceil_width  = ceil( ch.bbox.width );
-		float ceil_height = ceil( ch.bbox.height );
+	// charinfos[ i ] came from atlases[ sources[ i ] ]
+	std::vector< char_info > charinfos;
+	std::vector< size_t > sources;
 
-		int width  = static_cast<int>( ceil_width  + 2*cfg.smoothpixels );
-		int height = static_cast<int>( ceil_height + 2*cfg.smoothpixels );
+	for( size_t i = 0; i < atlases.size(); ++i ) {
+		source_atlas& atlas = atlases[ i ];
 
-		Vector2 offset( -ch.bbox.x + cfg.smoothpixels, -ch.bbox.y + cfg.smoothpixels );
-		ch.translation = offset;
-		ch.placement.width  = width;
-		ch.placement.height = height;
+		std::vector< uint32_t > ids;
+		for( uint32_t id = 0; id < atlas.font.glyphs.size(); ++id ) {
+			bool wanted = ranges.empty();
+			for( id_range range : ranges ) {
+				wanted = wanted || ( id >= range.first && id <= range.last );
+			}
+			if( wanted && has_tile( atlas.font.glyphs[ id ] ) ) {
+				ids.push_back( id );
+			}
+		}
 
-		ch.bitmap = Bitmap< FloatRGB >( width, height );
-		edgeColoringSimple( ch.shape, 2.5 );
-		generateMSDF( ch.bitmap, ch.shape, cfg.range, scaling, offset / scaling );
-	}
+		if( !cfg.frequencies.empty() ) {
+			ids = select_by_coverage( ids, cfg );
+		}
 
-	return charinfos;
-}
+		// everything that didn't make the cut gets zeroed in the new spec
+		std::vector< Glyph > glyphs( atlas.font.glyphs.size(), Glyph { } );
+		for( uint32_t id : ids ) {
+			glyphs[ id ] = atlas.font.glyphs[ id ];
 
-bool build_atlas( std::vector< char_info >& charinfos, settings& cfg ) {
-	std::vector< box< size_t >* > placerefs;
-	for( auto& ch : charinfos ) {
-		placerefs.emplace_back( &ch.placement );
-	}
+			charinfos.emplace_back( id, box< double >(), Shape(), 0.0 );
+			sources.push_back( i );
+			if( !extract_tile( atlas, glyphs[ id ], charinfos.back() ) ) {
+				std::cout << "error: glyph " << id << " of \"" << cfg.repack_files[ i ] << "\" is outside its atlas.\n";
+				return;
+			}
+		}
 
-	return bin_pack_max_rect( placerefs, cfg.tex_dims.width, cfg.tex_dims.height, cfg.spacing );
-}
+		while( !glyphs.empty() && !has_tile( glyphs.back() ) && glyphs.back().advance == 0 ) {
+			glyphs.pop_back();
+		}
+		atlas.font.glyphs.swap( glyphs );
+	}
 
-void run( FontHandle* font, settings& cfg ) {
-	std::cout << "using char height " << cfg.max_char_height << ".\n";
+	if( charinfos.empty() ) {
+		std::cout << "error: no glyphs to repack.\n";
+		return;
+	}
 
-	double scaling;
-	std::cout << "building chars...\n";
-	auto charinfos = build_charset( font, cfg, scaling );
+	if( !fit_texture_size( charinfos, repack_cfg ) ) {
+		return;
+	}
 
-	std::cout << "packing atlas...";
-	if( !build_atlas( charinfos, cfg ) ) {
+	std::cout << "repacking " << charinfos.size() << " glyphs...";
+	if( !build_atlas( charinfos, repack_cfg ) ) {
 		std::cout << "error: packing atlas failed.\n";
 		return;
 	}
 
-	write_specification( charinfos, cfg, scaling );
-	write_image( charinfos, cfg );
+	size_t num_pages = count_pages( charinfos );
+	for( size_t i = 0; i < charinfos.size(); ++i ) {
+		Font& font = atlases[ sources[ i ] ].font;
+		set_placement( font.glyphs[ charinfos[ i ].id ], charinfos[ i ], atlas_dims( repack_cfg ) );
+	}
+
+	for( source_atlas& atlas : atlases ) {
+		atlas.font.flags &= ~FontFlag_Paged;
+		if( repack_cfg.page_size > 0 ) {
+			atlas.font.flags |= FontFlag_Paged;
+		}
+		atlas.font.flags &= ~FontFlag_Rotated;
+		if( std::any_of( atlas.font.glyphs.begin(), atlas.font.glyphs.end(), []( const Glyph& glyph ) { return glyph.rotated != 0; } ) ) {
+			atlas.font.flags |= FontFlag_Rotated;
+		}
+		atlas.font.num_pages = num_pages;
+
+		std::string name = atlases.size() == 1 ? cfg.output_file_name : cfg.output_file_name + "-" + atlas.label;
+		write_specification( atlas.font, name + ".msdf", writer );
+	}
+
+	write_atlas( charinfos, repack_cfg, NULL, writer );
+}
+
+void print_stats( output_writer& writer, const settings& cfg ) {
+	writer.flush();
+	print_perf_stats( cfg.perf_glyphs );
+	print_allocation_stats( cfg.allocation_sites );
+	print_writer_stats( writer, writer_stats() );
 }
 
 namespace po = boost::program_options;
@@ -257,18 +1734,130 @@ std::ostream& operator<<( std::ostream& stream, const texture_dimensions& range
 	return stream;
 }
 
+std::istream& operator >> ( std::istream& stream, shard_spec& shard ) {
+	stream >> shard.index;
+	if( stream.get() != '/' ) {
+		stream.setstate( std::ios::failbit );
+		return stream;
+	}
+	stream >> shard.count;
+	if( shard.index >= shard.count ) {
+		stream.setstate( std::ios::failbit );
+	}
+	return stream;
+}
+
+std::ostream& operator<<( std::ostream& stream, const shard_spec& shard ) {
+	stream << shard.index << '/' << shard.count;
+	return stream;
+}
+
+std::istream& operator >> ( std::istream& stream, packer_kind& packer ) {
+	std::string name;
+	stream >> name;
+	if( name == "maxrects" ) {
+		packer = Packer_MaxRects;
+	}
+	else if( name == "skyline" ) {
+		packer = Packer_Skyline;
+	}
+	else if( name == "portfolio" ) {
+		packer = Packer_Portfolio;
+	}
+	else {
+		stream.setstate( std::ios::failbit );
+	}
+	return stream;
+}
+
+std::ostream& operator<<( std::ostream& stream, const packer_kind& packer ) {
+	const char* names[] = { "maxrects", "skyline", "portfolio" };
+	stream << names[ packer ];
+	return stream;
+}
+
+std::istream& operator >> ( std::istream& stream, texture_fit& fit ) {
+	std::string name;
+	stream >> name;
+	if( name == "pow2" ) {
+		fit = Fit_PowerOfTwo;
+	}
+	else if( name == "mul4" ) {
+		fit = Fit_MultipleOf4;
+	}
+	else if( name == "any" ) {
+		fit = Fit_Any;
+	}
+	else {
+		stream.setstate( std::ios::failbit );
+	}
+	return stream;
+}
+
+std::ostream& operator<<( std::ostream& stream, const texture_fit& fit ) {
+	const char* names[] = { "none", "pow2", "mul4", "any" };
+	stream << names[ fit ];
+	return stream;
+}
+
+std::istream& operator >> ( std::istream& stream, embed_mode& embed ) {
+	std::string name;
+	stream >> name;
+	if( name == "raw" ) {
+		embed = Embed_Raw;
+	}
+	else if( name == "rle" ) {
+		embed = Embed_RLE;
+	}
+	else {
+		stream.setstate( std::ios::failbit );
+	}
+	return stream;
+}
+
+std::ostream& operator<<( std::ostream& stream, const embed_mode& embed ) {
+	const char* names[] = { "none", "raw", "rle" };
+	stream << names[ embed ];
+	return stream;
+}
+
 bool parse_options( int argc, char* argv[], settings& cfg ) {
 	po::options_description desc( "Allowed options" );
 	desc.add_options()
 		("help", "produce help message")
 		("texture-size,T",  po::value< texture_dimensions >(&cfg.tex_dims)->default_value({2048, 2048}), "texture dimensions {width}x{height}" )
+		("fit-texture",     po::value< texture_fit >(&cfg.fit_texture)->default_value(Fit_None, ""), "shrink the texture to the smallest that fits, with sides that are powers of two (pow2), multiples of 4 (mul4) or anything (any). --texture-size is the biggest allowed. only packs, so it finds out before generating anything. neither side gets more than twice the other, so a thinner strip can be smaller, and heights are binary searched, which can miss one the packer only just manages")
 		("char-height,L",   po::value< size_t >(&cfg.max_char_height)->default_value(32),                "maximum character height in texels")
 		("smooth-pixels,S", po::value< size_t >(&cfg.smoothpixels)->default_value(2),                    "smoothing-pixels")
 		("range,R",         po::value< double >(&cfg.range)->default_value(1.0),                         "smoothing-range")
 		("spacing,S",       po::value< size_t >(&cfg.spacing)->default_value(2),                         "inter-character spacing in texels")
-		("font,F",          po::value<std::string>(&cfg.font_file_name)->required(), "font file name")
+		("font,F",          po::value<std::string>(&cfg.font_file_name), "font file name")
 		("output-name,O",   po::value<std::string>(&cfg.output_file_name)->required(), "base filename of output files")
 		("auto-height",     po::value<bool>(&cfg.auto_height)->default_value(false), "automatically determine best char height (might consume time)")
+		("single-channel",  po::bool_switch(&cfg.single_channel), "generate plain SDFs and pack four glyph layers into the RGBA channels")
+		("glyph-indices",   po::bool_switch(&cfg.by_glyph_index), "generate by glyph index instead of by codepoint, so the spec can be indexed with shaper output")
+		("grid",            po::bool_switch(&cfg.grid), "lay glyphs out in uniform cells by id instead of packing them, for monospace fonts. the uv_bounds of a glyph follow from its id, see FontFlag_Grid")
+		("packer",          po::value< packer_kind >(&cfg.packer)->default_value(Packer_MaxRects), "bin packer, maxrects, skyline or portfolio. skyline is much faster and lighter on memory for large glyph sets: after sorting, each glyph costs a pass over the skyline and a bounded list of gaps. portfolio tries many packings on all cores and keeps the tightest")
+		("pack-time-budget", po::value< double >(&cfg.pack_time_budget)->default_value(0), "with --packer portfolio, keep trying randomised packings for this many seconds")
+		("rotate",          po::bool_switch(&cfg.rotate), "let the packer turn glyphs 90 degrees where that packs tighter, see FontFlag_Rotated")
+		("composites",      po::bool_switch(&cfg.composites), "store composite glyphs such as accented letters as offsets to their components' tiles instead of tiles of their own (TrueType outlines only)")
+		("charset,C",       po::value< std::string >(&cfg.charset), "codepoints to generate as ranges, e.g. 32-126,0xa0-0xff. with --glyph-indices these are glyph indices. defaults to 0-255, or all glyphs")
+		("shard",           po::value< shard_spec >(&cfg.shard)->default_value({0, 0}, ""), "only generate shard {index}/{count} of the glyphs and write them to {output-name}.{index}.tiles")
+		("merge",           po::value< std::vector< std::string > >(&cfg.merge_files)->multitoken(), "pack the tile files written by --shard into the final atlas")
+		("repack",          po::value< std::vector< std::string > >(&cfg.repack_files)->multitoken(), "repack existing atlases, given as {name} for {name}.msdf and its pngs, into one atlas without regenerating anything. use --charset or --corpus to keep a subset. with several inputs, writes {output-name}-{name}.msdf for each")
+		("page-size",       po::value< size_t >(&cfg.page_size)->default_value(0), "split the atlas into independently loadable {page-size}x{page-size} pages, written as {output-name}.page{n}.png")
+		("corpus",          po::value< std::vector< std::string > >(&cfg.corpus_files)->multitoken(), "UTF-8 text files whose codepoint frequencies pick which glyphs to include and pack common glyphs together")
+		("coverage",        po::value< double >(&cfg.coverage)->default_value(1.0), "with --corpus, keep the most frequent glyphs until they cover this fraction of the text")
+		("watch",           po::bool_switch(&cfg.watch), "keep running and rebuild whenever the font file changes, regenerating only glyphs that changed")
+		("delta",           po::bool_switch(&cfg.delta), "also write {output-name}.delta with the glyphs and atlas rectangles that changed since the outputs already on disk")
+		("embed",           po::value< embed_mode >(&cfg.embed)->default_value(Embed_None, ""), "also write {output-name}.h and {output-name}.cpp with the glyph tables and atlas pixels as C++ arrays to compile in, see specview.h. raw keeps the pixels as they are, rle run length encodes them")
+		("priority",        po::value< std::string >(&cfg.priority), "codepoints (or glyph indices) to generate first, e.g. 32-126. writes a usable atlas with just these as soon as they're done, then rewrites it as the rest is generated")
+		("batch-size",      po::value< size_t >(&cfg.batch_size)->default_value(256), "with --priority, how many further glyphs to generate between rewrites of the outputs. 0 generates the rest in one go")
+		("instance,I",      po::value< std::vector< std::string > >(&cfg.instances)->multitoken(), "variable font instances to generate, by name or as axis=value[,axis=value...]. writes one atlas per instance")
+		("perf-counters",   po::bool_switch(&cfg.perf_counters), "count cycles, instructions, cache and branch misses per pipeline stage with perf_event_open (linux) and report them at the end")
+		("perf-glyphs",     po::value< size_t >(&cfg.perf_glyphs)->default_value(10), "with --perf-counters, also report this many of the slowest glyphs")
+		("track-allocations", po::bool_switch(&cfg.track_allocations), "count allocations, bytes and peak live bytes per pipeline stage, and report them with the peak rss at the end")
+		("allocation-sites", po::value< size_t >(&cfg.allocation_sites)->default_value(10), "with --track-allocations, also report this many of the call sites that allocate the most bytes")
 		;
 
 	po::variables_map vm;
@@ -280,6 +1869,72 @@ bool parse_options( int argc, char* argv[], settings& cfg ) {
 		return false;
 	}
 
+	if( cfg.font_file_name.empty() && cfg.merge_files.empty() && cfg.repack_files.empty() ) {
+		std::cout << "the option '--font' is required but missing\n";
+		return false;
+	}
+
+	if( cfg.page_size > 0 && cfg.single_channel ) {
+		std::cout << "--page-size can't be combined with --single-channel\n";
+		return false;
+	}
+
+	if( cfg.packer == Packer_Portfolio && cfg.page_size > 0 ) {
+		std::cout << "--packer portfolio can't be combined with --page-size\n";
+		return false;
+	}
+
+	if( cfg.fit_texture != Fit_None && ( cfg.grid || cfg.page_size > 0 || cfg.watch || cfg.shard.count > 0 ) ) {
+		std::cout << "--fit-texture can't be combined with --grid, --page-size, --watch or --shard\n";
+		return false;
+	}
+
+	if( !( cfg.coverage > 0 && cfg.coverage <= 1 ) ) {
+		std::cout << "--coverage has to be more than 0 and at most 1\n";
+		return false;
+	}
+
+	if( cfg.pack_time_budget > 0 && cfg.packer != Packer_Portfolio ) {
+		std::cout << "--pack-time-budget only works with --packer portfolio\n";
+		return false;
+	}
+
+	std::vector< id_range > priority;
+	if( !parse_ranges( cfg.priority, priority ) ) {
+		std::cout << "bad priority \"" << cfg.priority << "\".\n";
+		return false;
+	}
+
+	if( !cfg.priority.empty() && ( cfg.watch || cfg.shard.count > 0 || !cfg.merge_files.empty() || !cfg.repack_files.empty() ) ) {
+		std::cout << "--priority can't be combined with --watch, --shard, --merge or --repack\n";
+		return false;
+	}
+
+	if( cfg.grid && ( cfg.single_channel || cfg.page_size > 0 || cfg.composites || cfg.rotate || cfg.shard.count > 0 || !cfg.merge_files.empty() || !cfg.repack_files.empty() ) ) {
+		std::cout << "--grid can't be combined with --single-channel, --page-size, --composites, --rotate, --shard, --merge or --repack\n";
+		return false;
+	}
+
+	if( cfg.composites && ( cfg.watch || cfg.delta || !cfg.priority.empty() || cfg.shard.count > 0 || !cfg.merge_files.empty() || !cfg.repack_files.empty() ) ) {
+		std::cout << "--composites can't be combined with --watch, --delta, --priority, --shard, --merge or --repack\n";
+		return false;
+	}
+
+	if( cfg.watch && ( !cfg.instances.empty() || cfg.shard.count > 0 || !cfg.merge_files.empty() ) ) {
+		std::cout << "--watch can't be combined with --instance, --shard or --merge\n";
+		return false;
+	}
+
+	if( cfg.embed != Embed_None && ( cfg.shard.count > 0 || !cfg.repack_files.empty() ) ) {
+		std::cout << "--embed can't be combined with --shard or --repack\n";
+		return false;
+	}
+
+	if( !cfg.repack_files.empty() && ( cfg.watch || cfg.delta || !cfg.instances.empty() || cfg.shard.count > 0 || !cfg.merge_files.empty() ) ) {
+		std::cout << "--repack can't be combined with --watch, --delta, --instance, --shard or --merge\n";
+		return false;
+	}
+
 	return true;
 }
 
@@ -294,12 +1949,67 @@ int main( int argc, char* argv[]) {
 		return 0;
 	}
 
+	if( cfg.track_allocations ) {
+		enable_allocation_tracking();
+	}
+
+	if( cfg.perf_counters && !enable_perf_counters() ) {
+		std::cout << "warning: no performance counters available, --perf-counters is ignored.\n";
+	}
+
+	// a couple of atlases waiting to be written is enough to keep
+	// generation busy, with the one being generated that's three in memory
+	output_writer writer( 2 );
+
+	if( !cfg.corpus_files.empty() && !count_codepoints( cfg.corpus_files, cfg.frequencies ) ) {
+		return 0;
+	}
+
+	if( !cfg.repack_files.empty() ) {
+		run_repack( cfg, writer );
+		print_stats( writer, cfg );
+		return 0;
+	}
+
+	if( !cfg.merge_files.empty() ) {
+		run_merge( cfg, writer );
+		print_stats( writer, cfg );
+		return 0;
+	}
+
 	FreetypeHandle *ft = initializeFreetype();
-	if( ft ) {
-		FontHandle *font = loadFont( ft, cfg.font_file_name.c_str() );
+	if( ft && cfg.watch ) {
+		run_watch( ft, cfg, writer );
+		deinitializeFreetype( ft );
+	}
+	else if( ft ) {
+		// read the file once, instances parse their own faces out of it
+		std::vector< unsigned char > font_data = read_font_file( cfg.font_file_name );
+
+		FontHandle *font = loadFontData( ft, font_data.data(), long( font_data.size() ) );
 		if( font ) {
-			run( font, cfg );
+			// NULL for fonts the native decoder doesn't handle
+			SfntFont *outlines = loadSfnt( font_data.data(), font_data.size() );
+
+			if( cfg.by_glyph_index ) {
+				map_frequencies_to_glyphs( font, cfg );
+			}
+
+			std::vector< uint32_t > charset = lookup_charset( font, cfg );
+
+			if( charset.empty() ) {
+				std::cout << "error: no glyphs to generate.\n";
+			}
+			else if( cfg.instances.empty() ) {
+				run( font, outlines, charset, cfg, writer );
+			}
+			else {
+				run_instances( ft, font, font_data, charset, cfg, writer );
+			}
 
+			if( outlines != NULL ) {
+				destroySfnt( outlines );
+			}
 			destroyFont( font );
 		} else {
 			std::cout << "Could not open font \"" << cfg.font_file_name << "\".\n";
@@ -307,6 +2017,8 @@ int main( int argc, char* argv[]) {
 		deinitializeFreetype( ft );
 	}
 
+	print_stats( writer, cfg );
+
 	return 0;
 }
 
@@ -0,0 +1,379 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "binpacking.h"
+#include "packing.h"
+#include "parallel.h"
+
+// boxes are sorted biggest first within every tier by one of these
+enum pack_order {
+	Order_Height,
+	Order_Width,
+	Order_Area,
+	Order_Perimeter,
+	Order_LongSide,
+
+	Order_Count
+};
+
+static const char* heuristic_names[] = { "global", "best short side", "best long side", "best area", "bottom left", "contact point" };
+static const char* order_names[] = { "height", "width", "area", "perimeter", "long side" };
+
+// how one attempt packs
+struct pack_strategy {
+	packer_kind packer;
+	max_rect_heuristic heuristic;
+	pack_order order;
+	// 0 to sort exactly, otherwise the seed for jittering the sort keys
+	uint64_t seed;
+	bool rotate;
+};
+
+// a strategy and what came of it
+struct pack_attempt {
+	pack_strategy strategy;
+	std::vector< std::vector< size_t > > tiers;
+	std::vector< box< size_t > > boxes;
+	std::vector< size_t > channels;
+	size_t left;
+	// highest top edge over every bin, so how tall the packing is
+	size_t height;
+	size_t bins;
+};
+
+static std::string describe( const pack_strategy& attempt ) {
+	std::string desc;
+	if( attempt.packer == Packer_Skyline ) {
+		desc = "skyline";
+	}
+	else if( attempt.heuristic == MaxRect_Global ) {
+		desc = "maxrects";
+	}
+	else {
+		desc = std::string( "maxrects " ) + heuristic_names[ attempt.heuristic ] + " by " + order_names[ attempt.order ];
+	}
+	if( attempt.rotate ) {
+		desc += " with rotation";
+	}
+	return attempt.seed != 0 ? desc + " (jittered)" : desc;
+}
+
+static void sort_tier( std::vector< size_t >& tier, const std::vector< box< size_t > >& boxes, pack_order order, uint64_t seed ) {
+	std::vector< std::pair< double, double > > keys( boxes.size() );
+	std::mt19937_64 rng( seed );
+	std::uniform_real_distribution< double > jitter( 1.0, 1.3 );
+	for( size_t i : tier ) {
+		double w = double( boxes[ i ].width );
+		double h = double( boxes[ i ].height );
+		switch( order ) {
+			case Order_Height: keys[ i ] = std::make_pair( h, w ); break;
+			case Order_Width: keys[ i ] = std::make_pair( w, h ); break;
+			case Order_Area: keys[ i ] = std::make_pair( w * h, std::max( w, h ) ); break;
+			case Order_Perimeter: keys[ i ] = std::make_pair( w + h, std::max( w, h ) ); break;
+			default: keys[ i ] = std::make_pair( std::max( w, h ), std::min( w, h ) ); break;
+		}
+		if( seed != 0 ) {
+			keys[ i ].first *= jitter( rng );
+		}
+	}
+	std::stable_sort( tier.begin(), tier.end(), [&]( size_t a, size_t b ) { return keys[ a ] > keys[ b ]; } );
+}
+
+static void run_attempt( const pack_strategy& strategy, pack_attempt& attempt, const std::vector< std::vector< size_t > >& tiers, const std::vector< box< size_t > >& boxes, const std::vector< size_t >& channels, const settings& cfg ) {
+	attempt.strategy = strategy;
+	attempt.tiers = tiers;
+	attempt.boxes = boxes;
+	attempt.channels = channels;
+
+	if( strategy.packer == Packer_MaxRects && strategy.heuristic != MaxRect_Global ) {
+		for( auto& tier : attempt.tiers ) {
+			sort_tier( tier, boxes, strategy.order, strategy.seed );
+		}
+	}
+
+	size_t num_bins = cfg.single_channel ? 4 : 1;
+	if( strategy.packer == Packer_Skyline ) {
+		attempt.left = pack_tiers( attempt.tiers, attempt.boxes, attempt.channels, num_bins, [&]() {
+			skyline_bin< size_t > bin( cfg.tex_dims.width, cfg.tex_dims.height, cfg.spacing );
+			bin.rotate = strategy.rotate;
+			return bin;
+		}, false );
+	}
+	else {
+		attempt.left = pack_tiers( attempt.tiers, attempt.boxes, attempt.channels, num_bins, [&]() {
+			max_rect_bin< size_t > bin( cfg.tex_dims.width, cfg.tex_dims.height, cfg.spacing );
+			bin.heuristic = strategy.heuristic;
+			bin.rotate = strategy.rotate;
+			return bin;
+		}, false );
+	}
+
+	std::vector< bool > unplaced( boxes.size(), false );
+	for( const auto& tier : attempt.tiers ) {
+		for( size_t i : tier ) {
+			unplaced[ i ] = true;
+		}
+	}
+
+	attempt.height = 0;
+	attempt.bins = 0;
+	for( const auto& tier : tiers ) {
+		for( size_t i : tier ) {
+			if( !unplaced[ i ] ) {
+				attempt.height = std::max( attempt.height, attempt.boxes[ i ].top() );
+				attempt.bins = std::max( attempt.bins, attempt.channels[ i ] + 1 );
+			}
+		}
+	}
+}
+
+static bool better( const pack_attempt& a, const pack_attempt& b ) {
+	if( a.left != b.left ) {
+		return a.left < b.left;
+	}
+	return a.height < b.height;
+}
+
+// keeps the best of attempts in best, earlier attempts winning ties
+static void keep_best( std::vector< pack_attempt >& attempts, pack_attempt& best, bool& have_best ) {
+	for( pack_attempt& attempt : attempts ) {
+		if( !have_best || better( attempt, best ) ) {
+			best = std::move( attempt );
+			have_best = true;
+		}
+	}
+}
+
+size_t pack_portfolio( std::vector< std::vector< size_t > >& tiers, std::vector< box< size_t > >& boxes, std::vector< size_t >& channels, const settings& cfg, bool verbose ) {
+	typedef std::chrono::steady_clock clock_type;
+	clock_type::time_point deadline = clock_type::now() + std::chrono::duration_cast< clock_type::duration >( std::chrono::duration< double >( cfg.pack_time_budget ) );
+
+	// with --rotate every packing is tried both ways, turning boxes doesn't
+	// always pay off
+	std::vector< pack_strategy > strategies;
+	for( int rotate = 0; rotate <= int( cfg.rotate ); ++rotate ) {
+		strategies.push_back( pack_strategy{ Packer_MaxRects, MaxRect_Global, Order_Height, 0, rotate != 0 } );
+		strategies.push_back( pack_strategy{ Packer_Skyline, MaxRect_Global, Order_Height, 0, rotate != 0 } );
+		for( int heuristic = MaxRect_BestShortSide; heuristic <= MaxRect_ContactPoint; ++heuristic ) {
+			for( int order = 0; order < Order_Count; ++order ) {
+				strategies.push_back( pack_strategy{ Packer_MaxRects, max_rect_heuristic( heuristic ), pack_order( order ), 0, rotate != 0 } );
+			}
+		}
+	}
+
+	std::vector< pack_attempt > attempts( strategies.size() );
+	parallel_for( attempts.size(), [&]( size_t i ) {
+		run_attempt( strategies[ i ], attempts[ i ], tiers, boxes, channels, cfg );
+	} );
+
+	size_t tried = attempts.size();
+	pack_attempt best;
+	bool have_best = false;
+	keep_best( attempts, best, have_best );
+
+	// a round of random attempts per thread at a time until time runs out
+	size_t round_size = std::max( std::thread::hardware_concurrency(), 1u );
+	std::mt19937_64 rng( 1 );
+	while( clock_type::now() < deadline ) {
+		strategies.clear();
+		for( size_t i = 0; i < round_size; ++i ) {
+			max_rect_heuristic heuristic = max_rect_heuristic( MaxRect_BestShortSide + rng() % MaxRect_ContactPoint );
+			pack_order order = pack_order( rng() % Order_Count );
+			uint64_t seed = rng() | 1;
+			strategies.push_back( pack_strategy{ Packer_MaxRects, heuristic, order, seed, cfg.rotate && rng() % 2 == 0 } );
+		}
+
+		attempts.clear();
+		attempts.resize( strategies.size() );
+		parallel_for( attempts.size(), [&]( size_t i ) {
+			run_attempt( strategies[ i ], attempts[ i ], tiers, boxes, channels, cfg );
+		} );
+
+		tried += attempts.size();
+		keep_best( attempts, best, have_best );
+	}
+
+	if( verbose ) {
+		size_t area = 0;
+		for( const auto& tier : tiers ) {
+			for( size_t i : tier ) {
+				area += boxes[ i ].width * boxes[ i ].height;
+			}
+		}
+
+		std::cout << "tried " << tried << " packings, best is " << describe( best.strategy );
+		if( best.left == 0 && best.height > 0 ) {
+			double occupancy = 100.0 * area / ( double( cfg.tex_dims.width ) * best.height * best.bins );
+			std::ostringstream percent;
+			percent << std::fixed << std::setprecision( 1 ) << occupancy;
+			std::cout << ", " << best.height << " texels tall with " << percent.str() << "% occupancy";
+		}
+		std::cout << ".\n";
+	}
+
+	tiers = best.tiers;
+	boxes = best.boxes;
+	channels = best.channels;
+	return best.left;
+}
+
+size_t pack_boxes( std::vector< std::vector< size_t > >& tiers, std::vector< box< size_t > >& boxes, std::vector< size_t >& channels, const settings& cfg, bool verbose ) {
+	if( cfg.packer == Packer_Portfolio ) {
+		return pack_portfolio( tiers, boxes, channels, cfg, verbose );
+	}
+
+	size_t num_bins = cfg.single_channel ? 4 : 1;
+	if( cfg.packer == Packer_Skyline ) {
+		return pack_tiers( tiers, boxes, channels, num_bins, [&]() {
+			skyline_bin< size_t > bin( cfg.tex_dims.width, cfg.tex_dims.height, cfg.spacing );
+			bin.rotate = cfg.rotate;
+			return bin;
+		}, verbose );
+	}
+	return pack_tiers( tiers, boxes, channels, num_bins, [&]() {
+		max_rect_bin< size_t > bin( cfg.tex_dims.width, cfg.tex_dims.height, cfg.spacing );
+		bin.rotate = cfg.rotate;
+		return bin;
+	}, verbose );
+}
+
+// texture sizes of the given kind from lo to hi, smallest first
+static std::vector< size_t > fit_sizes( texture_fit fit, size_t lo, size_t hi ) {
+	std::vector< size_t > sizes;
+	lo = std::max< size_t >( lo, 1 );
+	if( fit == Fit_PowerOfTwo ) {
+		for( size_t size = 1; size <= hi; size *= 2 ) {
+			if( size >= lo ) {
+				sizes.push_back( size );
+			}
+		}
+		return sizes;
+	}
+
+	size_t step = fit == Fit_MultipleOf4 ? 4 : 1;
+	for( size_t size = ( lo + step - 1 ) / step * step; size <= hi; size += step ) {
+		sizes.push_back( size );
+	}
+	return sizes;
+}
+
+// widths searched at once. fixed rather than one per core, so the answer
+// doesn't depend on the machine
+static constexpr size_t FitRound = 16;
+
+bool fit_texture( const std::vector< std::vector< size_t > >& tiers, const std::vector< box< size_t > >& boxes, const std::vector< size_t >& channels, const settings& cfg, texture_dimensions& dims, size_t& tried ) {
+	size_t num_bins = cfg.single_channel ? 4 : 1;
+
+	// every box keeps spacing free to its right and top, and a bin gets
+	// that back along its own right and top edges (see skyline_bin), so
+	// the grown boxes have to fit into grown bins
+	size_t grown_area = 0;
+	size_t min_width = 1;
+	size_t min_height = 1;
+	for( const auto& tier : tiers ) {
+		for( size_t i : tier ) {
+			const box< size_t >& b = boxes[ i ];
+			grown_area += ( b.width + cfg.spacing ) * ( b.height + cfg.spacing );
+			if( cfg.rotate ) {
+				min_width = std::max( min_width, std::min( b.width, b.height ) );
+				min_height = std::max( min_height, std::min( b.width, b.height ) );
+			}
+			else {
+				min_width = std::max( min_width, b.width );
+				min_height = std::max( min_height, b.height );
+			}
+		}
+	}
+
+	std::vector< size_t > widths = fit_sizes( cfg.fit_texture, min_width, cfg.tex_dims.width );
+	std::vector< size_t > heights = fit_sizes( cfg.fit_texture, min_height, cfg.tex_dims.height );
+
+	std::atomic< size_t > trials( 0 );
+	auto fits = [&]( size_t width, size_t height ) {
+		settings trial = cfg;
+		trial.tex_dims = texture_dimensions { width, height };
+		// the real packing gets the time budget, and can only do better
+		trial.pack_time_budget = 0;
+
+		std::vector< std::vector< size_t > > trial_tiers = tiers;
+		std::vector< box< size_t > > trial_boxes = boxes;
+		std::vector< size_t > trial_channels = channels;
+		++trials;
+		return pack_boxes( trial_tiers, trial_boxes, trial_channels, trial, false ) == 0;
+	};
+
+	dims = cfg.tex_dims;
+	if( widths.empty() || heights.empty() ) {
+		tried = 0;
+		return false;
+	}
+	dims = texture_dimensions { widths.back(), heights.back() };
+	if( !fits( dims.width, dims.height ) ) {
+		tried = trials;
+		return false;
+	}
+
+	// widths near the square that would hold everything with nothing to
+	// spare usually win, and going first they rule out the most heights
+	// for the rest
+	double side = std::sqrt( double( grown_area ) / num_bins );
+	std::stable_sort( widths.begin(), widths.end(), [&]( size_t a, size_t b ) {
+		return std::abs( double( a ) - side ) < std::abs( double( b ) - side );
+	} );
+
+	for( size_t start = 0; start < widths.size(); start += FitRound ) {
+		size_t count = std::min( FitRound, widths.size() - start );
+		size_t best_area = dims.width * dims.height;
+		std::vector< size_t > found( count, 0 );
+
+		parallel_for( count, [&]( size_t k ) {
+			size_t width = widths[ start + k ];
+
+			// heights from lo up to hi are worth trying: anything lower
+			// can't hold the area, anything higher doesn't beat the best
+			// so far. least area alone would pick long thin strips, so
+			// neither side gets more than twice the other
+			size_t row = num_bins * ( width + cfg.spacing );
+			size_t needed = ( grown_area + row - 1 ) / row;
+			needed = std::max( needed > cfg.spacing ? needed - cfg.spacing : 0, ( width + 1 ) / 2 );
+			size_t lo = std::lower_bound( heights.begin(), heights.end(), needed ) - heights.begin();
+			size_t hi = std::lower_bound( heights.begin(), heights.end(), std::min( ( best_area + width - 1 ) / width, 2 * width + 1 ) ) - heights.begin();
+			if( lo >= hi || !fits( width, heights[ hi - 1 ] ) ) {
+				return;
+			}
+
+			// taking fitting as monotonic in height, which the packers
+			// nearly are
+			hi--;
+			while( lo < hi ) {
+				size_t mid = ( lo + hi ) / 2;
+				if( fits( width, heights[ mid ] ) ) {
+					hi = mid;
+				}
+				else {
+					lo = mid + 1;
+				}
+			}
+			found[ k ] = heights[ hi ];
+		} );
+
+		// ties go to the squarer texture
+		for( size_t k = 0; k < count; ++k ) {
+			size_t width = widths[ start + k ];
+			size_t height = found[ k ];
+			size_t area = width * height;
+			if( height > 0 && ( area < dims.width * dims.height || ( area == dims.width * dims.height && std::max( width, height ) < std::max( dims.width, dims.height ) ) ) ) {
+				dims = texture_dimensions { width, height };
+			}
+		}
+	}
+
+	tried = trials;
+	return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include "atlas.h"
+#include "box.h"
+
+// packs tiers of boxes, given as indices into boxes, hottest tier first
+// into bins from make_bin. with num_bins > 1 whatever doesn't fit one bin
+// spills into the next, and channels says which bin a box went into.
+// tiers is left holding the boxes that didn't fit anywhere, and the
+// return value is how many that is
+template< typename MakeBin >
+size_t pack_tiers( std::vector< std::vector< size_t > >& tiers, std::vector< box< size_t > >& boxes, std::vector< size_t >& channels, size_t num_bins, MakeBin make_bin, bool progress ) {
+	size_t left = 0;
+	for( const auto& tier : tiers ) {
+		left += tier.size();
+	}
+
+	for( size_t channel = 0; channel < num_bins && left > 0; ++channel ) {
+		auto bin = make_bin();
+		bin.progress = progress;
+
+		left = 0;
+		for( auto& tier : tiers ) {
+			std::vector< box< size_t >* > placerefs;
+			for( size_t i : tier ) {
+				channels[ i ] = channel;
+				placerefs.push_back( &boxes[ i ] );
+			}
+
+			bin.insert( placerefs );
+
+			tier.clear();
+			for( box< size_t >* b : placerefs ) {
+				tier.push_back( b - boxes.data() );
+			}
+			left += tier.size();
+		}
+		if( progress ) {
+			std::cout << "\n";
+		}
+	}
+
+	return left;
+}
+
+// --packer portfolio. packs the tiers lots of ways at once, with every
+// max_rect_bin heuristic over several box orders plus the global maxrects
+// and skyline packers, and keeps the one with the fewest boxes left over
+// and then the lowest top. with --pack-time-budget it then keeps trying
+// randomly jittered orders until the time is up. verbose prints which one
+// won. same contract as pack_tiers
+size_t pack_portfolio( std::vector< std::vector< size_t > >& tiers, std::vector< box< size_t > >& boxes, std::vector< size_t >& channels, const settings& cfg, bool verbose );
+
+// packs into cfg.tex_dims sized bins with whichever packer cfg asks for,
+// one per channel with --single-channel. verbose prints progress. same
+// contract as pack_tiers
+size_t pack_boxes( std::vector< std::vector< size_t > >& tiers, std::vector< box< size_t > >& boxes, std::vector< size_t >& channels, const settings& cfg, bool verbose );
+
+// --fit-texture. finds the smallest texture of cfg.fit_texture's kind, no
+// bigger than cfg.tex_dims, that pack_boxes gets everything into. only
+// packs, so it's cheap next to generating the tiles. false if not even
+// the biggest allowed texture is big enough. tried counts trial packings
+bool fit_texture( const std::vector< std::vector< size_t > >& tiers, const std::vector< box< size_t > >& boxes, const std::vector< size_t >& channels, const settings& cfg, texture_dimensions& dims, size_t& tried );
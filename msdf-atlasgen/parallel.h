@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// threads parallel_for has started and not joined yet, over every call.
+// nested calls share hardware_concurrency between them through this
+// rather than each starting a full set
+inline std::atomic< size_t >& parallel_for_threads() {
+	static std::atomic< size_t > threads( 0 );
+	return threads;
+}
+
+// calls f( i ) for every i in [0, n) on up to hardware_concurrency threads.
+// the calling thread does work too, so n == 1 doesn't spawn anything, and
+// a call made from inside another only gets the threads that are still
+// free, running serially when there are none
+template< typename F >
+void parallel_for( size_t n, F f ) {
+	size_t max_threads = std::max( std::thread::hardware_concurrency(), 1u );
+	size_t wanted = std::min( max_threads, n ) - std::min< size_t >( n, 1 );
+	std::atomic< size_t >& started = parallel_for_threads();
+	size_t extra = 0;
+	for( size_t busy = started.load(); wanted > 0 && busy < max_threads - 1; ) {
+		extra = std::min( wanted, max_threads - 1 - busy );
+		if( started.compare_exchange_weak( busy, busy + extra ) ) {
+			break;
+		}
+		extra = 0;
+	}
+
+	std::atomic< size_t > next( 0 );
+
+	auto worker = [&]() {
+		for( size_t i = next++; i < n; i = next++ ) {
+			f( i );
+		}
+	};
+
+	std::vector< std::thread > threads;
+	for( size_t i = 0; i < extra; i++ ) {
+		threads.emplace_back( worker );
+	}
+	worker();
+
+	for( std::thread & thread : threads ) {
+		thread.join();
+	}
+	started -= extra;
+}
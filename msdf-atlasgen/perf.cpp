@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string.h>
+#include <vector>
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "alloc.h"
+#include "perf.h"
+
+static const char* const StageNames[ PerfStage_Count ] = {
+	"outline load",
+	"coloring",
+	"generation",
+	"error correction",
+	"packing",
+	"encode",
+};
+
+static bool enabled = false;
+static bool available[ PerfCounter_Count ] = { };
+
+struct stage_totals {
+	perf_sample sample;
+	uint64_t pixels = 0;
+	size_t calls = 0;
+};
+
+struct glyph_totals {
+	perf_sample sample;
+	uint64_t pixels = 0;
+};
+
+static std::mutex totals_mutex;
+static stage_totals stages[ PerfStage_Count ];
+static std::map< uint32_t, glyph_totals > glyphs;
+
+perf_sample& perf_sample::operator += ( const perf_sample& other ) {
+	for( size_t i = 0; i < PerfCounter_Count; i++ ) {
+		values[ i ] += other.values[ i ];
+	}
+	return *this;
+}
+
+perf_sample perf_sample::operator - ( const perf_sample& other ) const {
+	perf_sample result;
+	for( size_t i = 0; i < PerfCounter_Count; i++ ) {
+		// multiplexed counters are scaled, which can make them step backwards
+		result.values[ i ] = values[ i ] > other.values[ i ] ? values[ i ] - other.values[ i ] : 0;
+	}
+	return result;
+}
+
+#ifdef __linux__
+
+static int open_counter( perf_counter counter ) {
+	static const struct { uint32_t type; uint64_t config; } events[ PerfCounter_Count ] = {
+		{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+
+	perf_event_attr attr;
+	memset( &attr, 0, sizeof( attr ) );
+	attr.size = sizeof( attr );
+	attr.type = events[ counter ].type;
+	attr.config = events[ counter ].config;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	// user space only, so it works without lowering perf_event_paranoid
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	// this thread, on whatever cpu it runs on
+	return int( syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 ) );
+}
+
+// counters only count the thread that opened them, so every thread that
+// reads them gets its own set, closed again when the thread exits
+struct thread_counters {
+	int fds[ PerfCounter_Count ];
+
+	thread_counters() {
+		for( size_t i = 0; i < PerfCounter_Count; i++ ) {
+			fds[ i ] = available[ i ] ? open_counter( perf_counter( i ) ) : -1;
+		}
+	}
+
+	~thread_counters() {
+		for( int fd : fds ) {
+			if( fd != -1 ) {
+				close( fd );
+			}
+		}
+	}
+
+	perf_sample read_all() const {
+		perf_sample sample;
+		for( size_t i = 0; i < PerfCounter_Count; i++ ) {
+			uint64_t data[ 3 ];
+			if( fds[ i ] == -1 || read( fds[ i ], data, sizeof( data ) ) != sizeof( data ) ) {
+				continue;
+			}
+
+			// with more events than the pmu has counters the kernel takes
+			// turns, so extrapolate to the whole time the counter was enabled
+			uint64_t value = data[ 0 ], time_enabled = data[ 1 ], time_running = data[ 2 ];
+			if( time_running > 0 && time_running < time_enabled ) {
+				value = uint64_t( double( value ) * time_enabled / time_running );
+			}
+			sample.values[ i ] = value;
+		}
+		return sample;
+	}
+};
+
+bool enable_perf_counters() {
+	static const char* const names[ PerfCounter_Count ] = { "task clock", "cycles", "instructions", "cache misses", "branch misses" };
+
+	bool any = false;
+	for( size_t i = 0; i < PerfCounter_Count; i++ ) {
+		int fd = open_counter( perf_counter( i ) );
+		if( fd == -1 ) {
+			std::cout << "warning: can't count " << names[ i ] << ": " << strerror( errno ) << ".\n";
+			continue;
+		}
+		close( fd );
+		available[ i ] = true;
+		any = true;
+	}
+
+	enabled = any;
+	return any;
+}
+
+perf_sample read_perf_counters() {
+	if( !enabled ) {
+		return perf_sample();
+	}
+
+	static thread_local thread_counters counters;
+	return counters.read_all();
+}
+
+#else
+
+bool enable_perf_counters() {
+	std::cout << "warning: --perf-counters needs linux perf_event_open.\n";
+	return false;
+}
+
+perf_sample read_perf_counters() {
+	return perf_sample();
+}
+
+#endif
+
+bool perf_counters_enabled() {
+	return enabled;
+}
+
+perf_scope::perf_scope( perf_stage s, uint64_t p ) : stage( s ), pixels( p ), active( enabled ) {
+	mark = enter_stage( stage );
+	if( active ) {
+		start = read_perf_counters();
+	}
+}
+
+perf_scope::~perf_scope() {
+	leave_stage( stage, mark );
+	if( !active ) {
+		return;
+	}
+
+	perf_sample sample = elapsed();
+
+	std::lock_guard< std::mutex > lock( totals_mutex );
+	stages[ stage ].sample += sample;
+	stages[ stage ].pixels += pixels;
+	stages[ stage ].calls++;
+}
+
+perf_sample perf_scope::elapsed() const {
+	return active ? read_perf_counters() - start : perf_sample();
+}
+
+void record_glyph( uint32_t id, const perf_sample& sample, uint64_t pixels ) {
+	if( !enabled ) {
+		return;
+	}
+
+	std::lock_guard< std::mutex > lock( totals_mutex );
+	glyph_totals& totals = glyphs[ id ];
+	totals.sample += sample;
+	totals.pixels += pixels;
+}
+
+// prints a counter, or n/a when the kernel didn't give us it
+static void print_count( const perf_sample& sample, perf_counter counter, int width ) {
+	std::cout << std::setw( width );
+	if( available[ counter ] ) {
+		std::cout << sample.values[ counter ];
+	}
+	else {
+		std::cout << "n/a";
+	}
+}
+
+static void print_ratio( const perf_sample& sample, perf_counter counter, perf_counter per, int width, int precision ) {
+	std::cout << std::setw( width );
+	if( available[ counter ] && available[ per ] && sample.values[ per ] > 0 ) {
+		std::cout << std::fixed << std::setprecision( precision ) << double( sample.values[ counter ] ) / sample.values[ per ];
+	}
+	else {
+		std::cout << "-";
+	}
+}
+
+static void print_per_pixel( const perf_sample& sample, perf_counter counter, uint64_t pixels, int width ) {
+	std::cout << std::setw( width );
+	if( available[ counter ] && pixels > 0 ) {
+		std::cout << std::fixed << std::setprecision( 4 ) << double( sample.values[ counter ] ) / pixels;
+	}
+	else {
+		std::cout << "-";
+	}
+}
+
+static void print_row( const perf_sample& sample, uint64_t pixels ) {
+	std::cout << std::setw( 10 ) << std::fixed << std::setprecision( 3 ) << sample.values[ PerfCounter_TaskClock ] * 1e-6;
+	print_count( sample, PerfCounter_Cycles, 14 );
+	print_count( sample, PerfCounter_Instructions, 14 );
+	print_ratio( sample, PerfCounter_Instructions, PerfCounter_Cycles, 6, 2 );
+	print_count( sample, PerfCounter_CacheMisses, 12 );
+	print_count( sample, PerfCounter_BranchMisses, 12 );
+	print_per_pixel( sample, PerfCounter_CacheMisses, pixels, 12 );
+	print_per_pixel( sample, PerfCounter_BranchMisses, pixels, 12 );
+	std::cout << "\n";
+}
+
+static void print_header( const char* first_column ) {
+	std::cout << std::left << std::setw( 18 ) << first_column << std::right;
+	std::cout << std::setw( 10 ) << "ms" << std::setw( 14 ) << "cycles" << std::setw( 14 ) << "instructions" << std::setw( 6 ) << "ipc";
+	std::cout << std::setw( 12 ) << "cache miss" << std::setw( 12 ) << "branch miss" << std::setw( 12 ) << "cache/px" << std::setw( 12 ) << "branch/px" << "\n";
+}
+
+void print_perf_stats( size_t slowest_glyphs ) {
+	if( !enabled ) {
+		return;
+	}
+
+	std::lock_guard< std::mutex > lock( totals_mutex );
+	std::ios::fmtflags flags = std::cout.flags();
+	std::streamsize precision = std::cout.precision();
+
+	// times are cpu time summed over threads, so stages that run in
+	// parallel add up to more than the wall clock
+	std::cout << "\nperf counters (user space, summed over threads):\n";
+	print_header( "stage" );
+	for( size_t i = 0; i < PerfStage_Count; i++ ) {
+		if( stages[ i ].calls == 0 ) {
+			continue;
+		}
+		std::cout << std::left << std::setw( 18 ) << StageNames[ i ] << std::right;
+		print_row( stages[ i ].sample, stages[ i ].pixels );
+	}
+
+	// cycles tell slow glyphs apart best, but fall back to time without them
+	perf_counter key = available[ PerfCounter_Cycles ] ? PerfCounter_Cycles : PerfCounter_TaskClock;
+	std::vector< std::pair< uint32_t, const glyph_totals* > > sorted;
+	for( const auto& kv : glyphs ) {
+		sorted.emplace_back( kv.first, &kv.second );
+	}
+	size_t count = std::min( slowest_glyphs, sorted.size() );
+	std::partial_sort( sorted.begin(), sorted.begin() + count, sorted.end(), [key]( const auto& a, const auto& b ) {
+		return a.second->sample.values[ key ] > b.second->sample.values[ key ];
+	} );
+
+	if( count > 0 ) {
+		std::cout << "\nslowest " << count << " of " << sorted.size() << " glyphs:\n";
+		print_header( "glyph" );
+		for( size_t i = 0; i < count; i++ ) {
+			std::cout << std::left << std::setw( 18 ) << sorted[ i ].first << std::right;
+			print_row( sorted[ i ].second->sample, sorted[ i ].second->pixels );
+		}
+	}
+
+	std::cout.flags( flags );
+	std::cout.precision( precision );
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// pipeline stages --perf-counters reports on
+enum perf_stage {
+	PerfStage_OutlineLoad,
+	PerfStage_Coloring,
+	PerfStage_Generation,
+	PerfStage_ErrorCorrection,
+	PerfStage_Packing,
+	PerfStage_Encode,
+	PerfStage_Count
+};
+
+enum perf_counter {
+	// nanoseconds on the cpu, a software counter that works even where the
+	// hardware ones aren't exposed (most VMs)
+	PerfCounter_TaskClock,
+	PerfCounter_Cycles,
+	PerfCounter_Instructions,
+	PerfCounter_CacheMisses,
+	PerfCounter_BranchMisses,
+	PerfCounter_Count
+};
+
+// where a stage scope started, so the thread can be handed back to the
+// stage it was in before. the allocation tracker fills it in
+struct stage_mark {
+	perf_stage previous;
+};
+
+struct perf_sample {
+	uint64_t values[ PerfCounter_Count ] = { };
+
+	perf_sample& operator += ( const perf_sample& other );
+	perf_sample operator - ( const perf_sample& other ) const;
+};
+
+// checks which counters the kernel lets us have and turns counting on.
+// returns false if there are none, in which case counting stays off
+bool enable_perf_counters();
+bool perf_counters_enabled();
+
+// what the calling thread has done so far. every thread gets its own
+// counters the first time it asks
+perf_sample read_perf_counters();
+
+// counts what the calling thread does until it goes out of scope and adds
+// it to the stage's totals. also tells the allocation tracker which stage
+// the thread is in
+class perf_scope {
+public:
+	explicit perf_scope( perf_stage stage, uint64_t pixels = 0 );
+	~perf_scope();
+
+	perf_sample elapsed() const;
+
+private:
+	perf_stage stage;
+	uint64_t pixels;
+	bool active;
+	perf_sample start;
+	stage_mark mark;
+};
+
+// adds to a glyph's totals, so the slowest glyphs can be listed
+void record_glyph( uint32_t id, const perf_sample& sample, uint64_t pixels );
+
+void print_perf_stats( size_t slowest_glyphs );
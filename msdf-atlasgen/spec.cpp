@@ -0,0 +1,236 @@
+#include <fstream>
+#include <iterator>
+#include <string.h>
+
+#include "spec.h"
+
+void Serialize( SerializationBuffer * buf, Glyph & glyph ) {
+	*buf & glyph.bounds & glyph.uv_bounds & glyph.advance & glyph.channel & glyph.page;
+}
+
+void Serialize( SerializationBuffer * buf, GlyphComponent & component ) {
+	*buf & component.glyph & component.component & component.offset;
+}
+
+// a u32 count followed by the elements, checking the count against what's
+// left before trusting it
+template< typename T >
+static void SerializeArray( SerializationBuffer * buf, std::vector< T > & arr, size_t element_size ) {
+	u32 count = arr.size();
+	*buf & count;
+	if( !buf->serializing ) {
+		if( buf->error || size_t( buf->end - buf->cursor ) / element_size < count ) {
+			buf->error = true;
+			return;
+		}
+		arr.resize( count );
+	}
+
+	for( T & x : arr ) {
+		*buf & x;
+	}
+}
+
+void Serialize( SerializationBuffer * buf, Font & font ) {
+	*buf & font.glyph_padding & font.dSDF_dUV & font.ascent & font.flags & font.num_pages;
+
+	SerializeArray( buf, font.glyphs, SerializedGlyphSize );
+
+	if( font.flags & FontFlag_Composites ) {
+		SerializeArray( buf, font.component_glyphs, SerializedGlyphSize );
+		SerializeArray( buf, font.components, SerializedComponentSize );
+	}
+
+	if( font.flags & FontFlag_Grid ) {
+		*buf & font.grid_first & font.grid_columns & font.grid_cell_uv & font.grid_pitch_uv;
+	}
+
+	if( font.flags & FontFlag_Rotated ) {
+		for( Glyph & glyph : font.glyphs ) {
+			*buf & glyph.rotated;
+		}
+		for( Glyph & glyph : font.component_glyphs ) {
+			*buf & glyph.rotated;
+		}
+	}
+}
+
+static size_t align_spec( size_t offset ) {
+	return ( offset + SpecAlignment - 1 ) / SpecAlignment * SpecAlignment;
+}
+
+// byte by byte so the file comes out little endian on any machine
+struct SpecWriter {
+	std::vector< char > & out;
+	size_t cursor;
+
+	void put( u32 x, size_t bytes ) {
+		for( size_t i = 0; i < bytes; ++i ) {
+			out[ cursor++ ] = char( x >> ( 8 * i ) );
+		}
+	}
+	void put( float x ) {
+		u32 bits;
+		memcpy( &bits, &x, sizeof( bits ) );
+		put( bits, sizeof( bits ) );
+	}
+	void put( const Vec2 & v ) {
+		put( v.x );
+		put( v.y );
+	}
+	void put( const MinMax2 & b ) {
+		put( b.mins );
+		put( b.maxs );
+	}
+	void put( const Glyph & glyph ) {
+		put( glyph.bounds );
+		put( glyph.uv_bounds );
+		put( glyph.advance );
+		put( glyph.page, sizeof( u16 ) );
+		put( glyph.channel, sizeof( u8 ) );
+		put( glyph.rotated, sizeof( u8 ) );
+	}
+	void put( const GlyphComponent & component ) {
+		put( component.glyph, sizeof( u32 ) );
+		put( component.component, sizeof( u32 ) );
+		put( component.offset );
+	}
+};
+
+std::vector< char > serialize_specification( const Font & font ) {
+	bool composites = ( font.flags & FontFlag_Composites ) != 0;
+	bool grid = ( font.flags & FontFlag_Grid ) != 0;
+	size_t num_sections = 1 + ( composites ? 2 : 0 ) + ( grid ? 1 : 0 );
+
+	std::vector< SpecSection > sections;
+	size_t offset = align_spec( sizeof( SpecHeader ) + num_sections * sizeof( SpecSection ) );
+	auto add = [&]( u32 tag, size_t count, size_t element_size ) {
+		sections.push_back( SpecSection { tag, u32( offset ), u32( count ), u32( element_size ) } );
+		offset = align_spec( offset + count * element_size );
+	};
+	add( SpecSection_Glyphs, font.glyphs.size(), sizeof( SpecGlyph ) );
+	if( composites ) {
+		add( SpecSection_ComponentGlyphs, font.component_glyphs.size(), sizeof( SpecGlyph ) );
+		add( SpecSection_Components, font.components.size(), sizeof( SpecComponent ) );
+	}
+	if( grid ) {
+		add( SpecSection_Grid, 1, sizeof( SpecGrid ) );
+	}
+
+	std::vector< char > out( offset, 0 );
+	SpecWriter writer = { out, 0 };
+	writer.put( SpecMagic, sizeof( u32 ) );
+	writer.put( SpecVersion, sizeof( u16 ) );
+	writer.put( sizeof( SpecHeader ), sizeof( u16 ) );
+	writer.put( SpecByteOrder, sizeof( u32 ) );
+	writer.put( u32( out.size() ), sizeof( u32 ) );
+	writer.put( font.glyph_padding );
+	writer.put( font.dSDF_dUV );
+	writer.put( font.ascent );
+	writer.put( font.flags, sizeof( u32 ) );
+	writer.put( font.num_pages, sizeof( u32 ) );
+	writer.put( u32( num_sections ), sizeof( u32 ) );
+	writer.put( sizeof( SpecHeader ), sizeof( u32 ) );
+	writer.put( 0, sizeof( u32 ) );
+
+	for( const SpecSection & section : sections ) {
+		writer.put( section.tag, sizeof( u32 ) );
+		writer.put( section.offset, sizeof( u32 ) );
+		writer.put( section.count, sizeof( u32 ) );
+		writer.put( section.element_size, sizeof( u32 ) );
+	}
+
+	for( const SpecSection & section : sections ) {
+		writer.cursor = section.offset;
+		switch( section.tag ) {
+			case SpecSection_Glyphs:
+				for( const Glyph & glyph : font.glyphs ) {
+					writer.put( glyph );
+				}
+				break;
+			case SpecSection_ComponentGlyphs:
+				for( const Glyph & glyph : font.component_glyphs ) {
+					writer.put( glyph );
+				}
+				break;
+			case SpecSection_Components:
+				for( const GlyphComponent & component : font.components ) {
+					writer.put( component );
+				}
+				break;
+			case SpecSection_Grid:
+				writer.put( font.grid_first, sizeof( u32 ) );
+				writer.put( font.grid_columns, sizeof( u32 ) );
+				writer.put( font.grid_cell_uv );
+				writer.put( font.grid_pitch_uv );
+				break;
+		}
+	}
+
+	return out;
+}
+
+static Vec2 from_spec( const SpecVec2 & v ) {
+	return Vec2( v.x, v.y );
+}
+
+static MinMax2 from_spec( const SpecMinMax2 & b ) {
+	return MinMax2( from_spec( b.mins ), from_spec( b.maxs ) );
+}
+
+static Glyph from_spec( const SpecGlyph & spec ) {
+	Glyph glyph;
+	glyph.bounds = from_spec( spec.bounds );
+	glyph.uv_bounds = from_spec( spec.uv_bounds );
+	glyph.advance = spec.advance;
+	glyph.channel = spec.channel;
+	glyph.page = spec.page;
+	glyph.rotated = spec.rotated;
+	return glyph;
+}
+
+static bool load_spec_view( const std::vector< char > & buf, Font & font ) {
+	SpecView view;
+	if( !open_spec_view( buf.data(), buf.size(), view ) ) {
+		return false;
+	}
+
+	font = Font();
+	font.glyph_padding = view.header->glyph_padding;
+	font.dSDF_dUV = view.header->dSDF_dUV;
+	font.ascent = view.header->ascent;
+	font.flags = view.header->flags;
+	font.num_pages = view.header->num_pages;
+
+	for( uint32_t i = 0; i < view.num_glyphs; ++i ) {
+		font.glyphs.push_back( from_spec( view.glyphs[ i ] ) );
+	}
+	for( uint32_t i = 0; i < view.num_component_glyphs; ++i ) {
+		font.component_glyphs.push_back( from_spec( view.component_glyphs[ i ] ) );
+	}
+	for( uint32_t i = 0; i < view.num_components; ++i ) {
+		const SpecComponent & spec = view.components[ i ];
+		font.components.push_back( GlyphComponent { spec.glyph, spec.component, from_spec( spec.offset ) } );
+	}
+	if( view.grid != NULL ) {
+		font.grid_first = view.grid->first;
+		font.grid_columns = view.grid->columns;
+		font.grid_cell_uv = from_spec( view.grid->cell_uv );
+		font.grid_pitch_uv = from_spec( view.grid->pitch_uv );
+	}
+	return true;
+}
+
+bool load_specification( const std::string & path, Font & font ) {
+	std::ifstream file( path, std::ios::in | std::ios::binary );
+	if( !file ) {
+		return false;
+	}
+	std::vector< char > buf( ( std::istreambuf_iterator< char >( file ) ), std::istreambuf_iterator< char >() );
+
+	// version 1 files start with glyph_padding, which is never this
+	if( buf.size() >= sizeof( u32 ) && memcmp( buf.data(), "MSDF", sizeof( u32 ) ) == 0 ) {
+		return load_spec_view( buf, font );
+	}
+	return Deserialize( font, buf.data(), buf.size() );
+}
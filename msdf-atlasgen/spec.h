@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "serialization.h"
+#include "specview.h"
+
+struct Glyph {
+	MinMax2 bounds;
+	MinMax2 uv_bounds;
+	float advance;
+	u8 channel;
+	u16 page;
+	// FontFlag_Rotated only, see there in specview.h
+	u8 rotated;
+};
+
+// one quad of a composite glyph: the tile of glyph `component`, moved by
+// offset. component indexes glyphs, or component_glyphs past its end
+struct GlyphComponent {
+	u32 glyph;
+	u32 component;
+	Vec2 offset;
+};
+
+struct Font {
+	float glyph_padding;
+	float dSDF_dUV;
+	float ascent;
+	u32 flags;
+	u32 num_pages;
+
+	// indexed by codepoint or glyph index, entries that weren't generated
+	// are zeroed
+	std::vector< Glyph > glyphs;
+
+	// FontFlag_Composites only. tiles of components no codepoint maps to,
+	// and the components of every composite glyph sorted by glyph. the
+	// Glyph of a composite has bounds and advance but no tile of its own
+	std::vector< Glyph > component_glyphs;
+	std::vector< GlyphComponent > components;
+
+	// FontFlag_Grid only
+	u32 grid_first;
+	u32 grid_columns;
+	MinMax2 grid_cell_uv;
+	Vec2 grid_pitch_uv;
+};
+
+static constexpr size_t SerializedGlyphSize = 2 * sizeof( MinMax2 ) + sizeof( float ) + sizeof( u8 ) + sizeof( u16 );
+static constexpr size_t SerializedComponentSize = 2 * sizeof( u32 ) + sizeof( Vec2 );
+
+void Serialize( SerializationBuffer * buf, Glyph & glyph );
+void Serialize( SerializationBuffer * buf, GlyphComponent & component );
+// the version 1 file, which had no header: the Font fields in order, the
+// tables as a u32 count and their elements, then the grid fields and
+// rotated per glyph and per component glyph when flagged. only read now
+void Serialize( SerializationBuffer * buf, Font & font );
+
+// the version 2 file, see specview.h
+std::vector< char > serialize_specification( const Font & font );
+
+// reads either version
+bool load_specification( const std::string & path, Font & font );
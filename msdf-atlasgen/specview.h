@@ -0,0 +1,323 @@
+#pragma once
+
+// the .msdf file, version 2, and a reader that uses it in place. this
+// header stands alone so it can be dropped into a runtime that mmaps the
+// file or embeds it: nothing gets parsed, copied or allocated
+//
+// everything is little endian. the file is laid out as:
+//
+//   SpecHeader
+//   num_sections times SpecSection, at sections_offset
+//   the sections, each a plain array of count elements of the section's
+//     type, at offset
+//
+// offsets are from the start of the file and multiples of SpecAlignment,
+// with zeros in between, so with the file at an aligned address every
+// array can be used where it is. later versions may only add to this:
+// fields at the end of the header, counted in header_size, and sections
+// with new tags, which readers skip. so a reader opens any version from
+// its own on, and a file keeps working with readers older than it
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+enum FontFlags : uint32_t {
+	// each glyph is a single channel SDF living in the RGBA channel given by
+	// Glyph::channel. sample that channel instead of taking the median
+	FontFlag_ChannelPacked = 1 << 0,
+	// glyphs is indexed by glyph index rather than by codepoint
+	FontFlag_GlyphIndexed = 1 << 1,
+	// the atlas is split into num_pages square pages, stored as separate
+	// {name}.page{n}.png files. uv_bounds are relative to Glyph::page
+	FontFlag_Paged = 1 << 2,
+	// some glyphs are drawn as several quads, one per GlyphComponent. only
+	// with this flag are there component tables
+	FontFlag_Composites = 1 << 3,
+	// every glyph has the same bounds and a cell of the same size, laid out
+	// by id: glyph id's uv_bounds are grid_cell_uv moved by grid_pitch_uv
+	// times ( ( id - grid_first ) % grid_columns, ( id - grid_first ) /
+	// grid_columns ), so no table lookup is needed. only with this flag are
+	// there grid fields
+	FontFlag_Grid = 1 << 4,
+	// some tiles were turned 90 degrees clockwise to pack tighter. their
+	// uv_bounds still give the glyph's top left corner in mins and bottom
+	// right in maxs, so a quad textured from mins to maxs samples the right
+	// texels at those two corners, but the other two swap: top right is
+	// ( mins.x, maxs.y ) and bottom left ( maxs.x, mins.y ). this also makes
+	// mins.x > maxs.x, which is all a renderer needs to tell them apart.
+	// Glyph::rotated is only meaningful with this flag set
+	FontFlag_Rotated = 1 << 5,
+};
+
+constexpr uint32_t SpecTag( char a, char b, char c, char d ) {
+	return uint32_t( uint8_t( a ) ) | uint32_t( uint8_t( b ) ) << 8 | uint32_t( uint8_t( c ) ) << 16 | uint32_t( uint8_t( d ) ) << 24;
+}
+
+static constexpr uint32_t SpecMagic = SpecTag( 'M', 'S', 'D', 'F' );
+static constexpr uint16_t SpecVersion = 2;
+// reads back as 0x04030201 on a big endian machine
+static constexpr uint32_t SpecByteOrder = 0x01020304;
+static constexpr uint32_t SpecAlignment = 16;
+
+enum SpecSectionTag : uint32_t {
+	// SpecGlyph, indexed by codepoint or glyph index. entries that weren't
+	// generated are zeroed
+	SpecSection_Glyphs = SpecTag( 'G', 'L', 'Y', 'F' ),
+	// FontFlag_Composites only. SpecGlyph, tiles of components no codepoint
+	// maps to. the Glyph of a composite has bounds and advance but no tile
+	// of its own
+	SpecSection_ComponentGlyphs = SpecTag( 'C', 'G', 'L', 'Y' ),
+	// FontFlag_Composites only. SpecComponent, the components of every
+	// composite glyph sorted by glyph
+	SpecSection_Components = SpecTag( 'C', 'O', 'M', 'P' ),
+	// FontFlag_Grid only. a single SpecGrid
+	SpecSection_Grid = SpecTag( 'G', 'R', 'I', 'D' ),
+};
+
+struct SpecHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t header_size;
+	uint32_t byte_order;
+	// including the padding after the last section
+	uint32_t file_size;
+	float glyph_padding;
+	float dSDF_dUV;
+	float ascent;
+	uint32_t flags;
+	uint32_t num_pages;
+	uint32_t num_sections;
+	uint32_t sections_offset;
+	uint32_t reserved;
+};
+
+struct SpecSection {
+	uint32_t tag;
+	uint32_t offset;
+	uint32_t count;
+	// sizeof the element type, checked so a mismatched reader fails
+	// instead of misreading
+	uint32_t element_size;
+};
+
+struct SpecVec2 {
+	float x, y;
+};
+
+struct SpecMinMax2 {
+	SpecVec2 mins, maxs;
+};
+
+// Glyph in spec.h, with page ahead of channel so there's no padding
+struct SpecGlyph {
+	SpecMinMax2 bounds;
+	SpecMinMax2 uv_bounds;
+	float advance;
+	uint16_t page;
+	uint8_t channel;
+	uint8_t rotated;
+};
+
+// one quad of a composite glyph: the tile of glyph `component`, moved by
+// offset. component indexes the glyphs, or the component glyphs past
+// their end
+struct SpecComponent {
+	uint32_t glyph;
+	uint32_t component;
+	SpecVec2 offset;
+};
+
+struct SpecGrid {
+	uint32_t first;
+	uint32_t columns;
+	SpecMinMax2 cell_uv;
+	SpecVec2 pitch_uv;
+};
+
+static_assert( sizeof( SpecHeader ) == 48, "SpecHeader has to match the file" );
+static_assert( sizeof( SpecSection ) == 16, "SpecSection has to match the file" );
+static_assert( sizeof( SpecGlyph ) == 40, "SpecGlyph has to match the file" );
+static_assert( sizeof( SpecComponent ) == 16, "SpecComponent has to match the file" );
+static_assert( sizeof( SpecGrid ) == 32, "SpecGrid has to match the file" );
+
+// pointers into the file. the arrays are empty and grid is NULL when the
+// flags say they aren't there
+struct SpecView {
+	const SpecHeader * header;
+	const SpecGlyph * glyphs;
+	uint32_t num_glyphs;
+	const SpecGlyph * component_glyphs;
+	uint32_t num_component_glyphs;
+	const SpecComponent * components;
+	uint32_t num_components;
+	const SpecGrid * grid;
+};
+
+inline bool spec_host_is_little_endian() {
+	uint32_t x = SpecByteOrder;
+	uint8_t first;
+	memcpy( &first, &x, 1 );
+	return first == 0x04;
+}
+
+// checks that data holds a version 2 or later file this reader can use
+// in place and points view into it. data has to be 4 byte aligned, which
+// mmap and malloc both are, and outlive view. checked are the header,
+// that every section lies within the file, that the flags have the
+// sections they promise, and that components only index glyphs that
+// exist. big endian machines can't use the file in place, so they always
+// fail
+inline bool open_spec_view( const void * data, size_t size, SpecView & view ) {
+	memset( &view, 0, sizeof( view ) );
+
+	const char * base = static_cast< const char * >( data );
+	if( data == NULL || uintptr_t( data ) % alignof( SpecGlyph ) != 0 || size < sizeof( SpecHeader ) || !spec_host_is_little_endian() ) {
+		return false;
+	}
+
+	const SpecHeader * header = reinterpret_cast< const SpecHeader * >( base );
+	if( header->magic != SpecMagic || header->version < SpecVersion || header->byte_order != SpecByteOrder ) {
+		return false;
+	}
+	if( header->header_size < sizeof( SpecHeader ) || header->file_size > size || header->file_size < header->header_size ) {
+		return false;
+	}
+
+	uint64_t file_size = header->file_size;
+	uint64_t table_end = uint64_t( header->sections_offset ) + uint64_t( header->num_sections ) * sizeof( SpecSection );
+	if( header->sections_offset % SpecAlignment != 0 || header->sections_offset < header->header_size || table_end > file_size ) {
+		return false;
+	}
+
+	const SpecSection * sections = reinterpret_cast< const SpecSection * >( base + header->sections_offset );
+	const void * found[ 4 ] = { };
+	uint32_t counts[ 4 ] = { };
+	const uint32_t tags[ 4 ] = { SpecSection_Glyphs, SpecSection_ComponentGlyphs, SpecSection_Components, SpecSection_Grid };
+	const uint32_t sizes[ 4 ] = { sizeof( SpecGlyph ), sizeof( SpecGlyph ), sizeof( SpecComponent ), sizeof( SpecGrid ) };
+
+	for( uint32_t i = 0; i < header->num_sections; ++i ) {
+		const SpecSection & section = sections[ i ];
+		if( section.offset % SpecAlignment != 0 || section.offset < table_end ) {
+			return false;
+		}
+		if( uint64_t( section.offset ) + uint64_t( section.count ) * section.element_size > file_size ) {
+			return false;
+		}
+
+		for( size_t t = 0; t < 4; ++t ) {
+			if( section.tag != tags[ t ] ) {
+				continue;
+			}
+			if( found[ t ] != NULL || section.element_size != sizes[ t ] ) {
+				return false;
+			}
+			found[ t ] = base + section.offset;
+			counts[ t ] = section.count;
+		}
+	}
+
+	bool composites = ( header->flags & FontFlag_Composites ) != 0;
+	bool grid = ( header->flags & FontFlag_Grid ) != 0;
+	if( found[ 0 ] == NULL || ( composites && ( found[ 1 ] == NULL || found[ 2 ] == NULL ) ) || ( grid && ( found[ 3 ] == NULL || counts[ 3 ] != 1 ) ) ) {
+		return false;
+	}
+
+	view.header = header;
+	view.glyphs = static_cast< const SpecGlyph * >( found[ 0 ] );
+	view.num_glyphs = counts[ 0 ];
+	if( composites ) {
+		view.component_glyphs = static_cast< const SpecGlyph * >( found[ 1 ] );
+		view.num_component_glyphs = counts[ 1 ];
+		view.components = static_cast< const SpecComponent * >( found[ 2 ] );
+		view.num_components = counts[ 2 ];
+	}
+	if( grid ) {
+		view.grid = static_cast< const SpecGrid * >( found[ 3 ] );
+	}
+
+	uint64_t num_tiles = uint64_t( view.num_glyphs ) + view.num_component_glyphs;
+	for( uint32_t i = 0; i < view.num_components; ++i ) {
+		if( view.components[ i ].glyph >= view.num_glyphs || view.components[ i ].component >= num_tiles ) {
+			memset( &view, 0, sizeof( view ) );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// an atlas compiled into the program with msdf-atlasgen --embed, which
+// lays the tables out the same way as the file. spec.header has no file
+// behind it, so file_size and the section fields are 0. pixels are 8 bits
+// per channel with the first row at the top like the pngs, cut into bands
+// of whole rows so no single array is too big for the compiler. raw bands
+// can be uploaded where they are, a band at a time
+struct SpecEmbeddedBand {
+	const uint8_t * data;
+	uint32_t size;
+	uint32_t first_row;
+	uint32_t num_rows;
+};
+
+struct SpecEmbeddedPage {
+	uint32_t width;
+	uint32_t height;
+	uint32_t channels;
+	// the bands are run length encoded, see decode_embedded_band
+	uint32_t rle;
+	const SpecEmbeddedBand * bands;
+	uint32_t num_bands;
+};
+
+struct SpecEmbeddedFont {
+	SpecView spec;
+	const SpecEmbeddedPage * pages;
+	uint32_t num_pages;
+};
+
+// run length encoded bands are runs of whole pixels, each after a byte n.
+// below 128, n + 1 different pixels follow. from 128 up, one pixel follows
+// that repeats n - 126 times. runs never cross bands
+static constexpr uint32_t SpecMaxLiteralRun = 128;
+static constexpr uint32_t SpecMaxRepeatRun = 129;
+
+// writes band's rows to pixels, which has room for num_rows * width *
+// channels bytes. false if the band doesn't decode to exactly that
+inline bool decode_embedded_band( const SpecEmbeddedPage & page, const SpecEmbeddedBand & band, uint8_t * pixels ) {
+	size_t pixel_size = page.channels;
+	size_t size = size_t( band.num_rows ) * page.width * pixel_size;
+	if( !page.rle ) {
+		if( band.size != size ) {
+			return false;
+		}
+		memcpy( pixels, band.data, size );
+		return true;
+	}
+
+	const uint8_t * cursor = band.data;
+	const uint8_t * end = band.data + band.size;
+	uint8_t * out = pixels;
+	uint8_t * out_end = pixels + size;
+	while( cursor < end ) {
+		uint8_t n = *cursor++;
+		size_t run = n < 128 ? n + 1 : n - 126;
+		size_t in_bytes = n < 128 ? run * pixel_size : pixel_size;
+		if( size_t( end - cursor ) < in_bytes || size_t( out_end - out ) < run * pixel_size ) {
+			return false;
+		}
+
+		if( n < 128 ) {
+			memcpy( out, cursor, in_bytes );
+			out += in_bytes;
+		}
+		else {
+			for( size_t i = 0; i < run; ++i ) {
+				memcpy( out, cursor, pixel_size );
+				out += pixel_size;
+			}
+		}
+		cursor += in_bytes;
+	}
+	return out == out_end;
+}
@@ -0,0 +1,124 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "tiles.h"
+#include "types.h"
+#include "serialization.h"
+
+using namespace msdfgen;
+
+static constexpr u32 TilesMagic = 0x544c544d; // "MTLT"
+static constexpr u32 TilesVersion = 1;
+
+static constexpr size_t SerializedHeaderSize = 4 * sizeof( u32 ) + sizeof( double ) + sizeof( u32 ) + sizeof( double ) + 2 * sizeof( u8 ) + sizeof( u32 );
+static constexpr size_t SerializedTileSize = sizeof( u32 ) + 5 * sizeof( double ) + 2 * sizeof( u32 );
+
+static void Serialize( SerializationBuffer * buf, box< double > & b ) {
+	*buf & b.x & b.y & b.width & b.height;
+}
+
+static void Serialize( SerializationBuffer * buf, tile_header & header ) {
+	u32 magic = TilesMagic;
+	u32 version = TilesVersion;
+	u32 shard_index = header.shard.index;
+	u32 shard_count = header.shard.count;
+	u32 smoothpixels = header.smoothpixels;
+
+	*buf & magic & version & shard_index & shard_count;
+	*buf & header.scaling & smoothpixels & header.range & header.single_channel & header.by_glyph_index;
+
+	if( magic != TilesMagic || version != TilesVersion ) {
+		buf->error = true;
+	}
+
+	header.shard.index = shard_index;
+	header.shard.count = shard_count;
+	header.smoothpixels = smoothpixels;
+}
+
+template< typename T >
+static void SerializePixels( SerializationBuffer * buf, Bitmap< T > & bitmap, u32 width, u32 height ) {
+	if( !buf->serializing ) {
+		if( buf->error || size_t( buf->end - buf->cursor ) / sizeof( T ) < size_t( width ) * height ) {
+			buf->error = true;
+			return;
+		}
+		bitmap = Bitmap< T >( width, height );
+	}
+
+	for( u32 y = 0; y < height; y++ ) {
+		for( u32 x = 0; x < width; x++ ) {
+			float * texel = ( float * ) &bitmap( x, y );
+			for( size_t i = 0; i < sizeof( T ) / sizeof( float ); i++ ) {
+				*buf & texel[ i ];
+			}
+		}
+	}
+}
+
+static void Serialize( SerializationBuffer * buf, char_info & ch, bool single_channel ) {
+	u32 id = ch.id;
+	u32 width = ch.placement.width;
+	u32 height = ch.placement.height;
+
+	*buf & id & ch.bbox & ch.advance & width & height;
+
+	ch.id = id;
+	ch.placement.width = width;
+	ch.placement.height = height;
+
+	if( single_channel ) {
+		SerializePixels( buf, ch.sdf, width, height );
+	}
+	else {
+		SerializePixels( buf, ch.bitmap, width, height );
+	}
+}
+
+bool write_tiles( const std::string& path, const tile_header& header, const std::vector< const char_info* >& tiles ) {
+	size_t size = SerializedHeaderSize;
+	for( const char_info* ch : tiles ) {
+		size_t channels = header.single_channel ? 1 : 3;
+		size += SerializedTileSize + ch->placement.width * ch->placement.height * channels * sizeof( float );
+	}
+
+	std::vector< char > buf( size );
+	SerializationBuffer sb( SerializationMode_Serializing, buf.data(), buf.size() );
+
+	Serialize( &sb, const_cast< tile_header & >( header ) );
+	u32 num_tiles = tiles.size();
+	sb & num_tiles;
+	for( const char_info* ch : tiles ) {
+		Serialize( &sb, const_cast< char_info & >( *ch ), header.single_channel );
+	}
+	assert( !sb.error );
+
+	std::ofstream file( path, std::ios::out | std::ios::binary | std::ios::trunc );
+	file.write( buf.data(), buf.size() );
+	return bool( file );
+}
+
+bool read_tiles( const std::string& path, tile_header& header, std::vector< char_info >& charinfos ) {
+	std::ifstream file( path, std::ios::in | std::ios::binary );
+	if( !file ) {
+		return false;
+	}
+	std::vector< char > buf( ( std::istreambuf_iterator< char >( file ) ), std::istreambuf_iterator< char >() );
+
+	SerializationBuffer sb( SerializationMode_Deserializing, buf.data(), buf.size() );
+	Serialize( &sb, header );
+
+	u32 num_tiles = 0;
+	sb & num_tiles;
+	if( sb.error || size_t( sb.end - sb.cursor ) / SerializedTileSize < num_tiles ) {
+		return false;
+	}
+
+	for( u32 i = 0; i < num_tiles && !sb.error; i++ ) {
+		charinfos.emplace_back( 0, box< double >(), Shape(), 0.0 );
+		Serialize( &sb, charinfos.back(), header.single_channel );
+	}
+
+	return !sb.error;
+}
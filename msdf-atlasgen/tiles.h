@@ -0,0 +1,19 @@
+#pragma once
+
+#include "atlas.h"
+
+// tile files hold the generated glyphs of one shard, plus the settings that
+// have to agree between shards for them to be merged into one atlas
+struct tile_header {
+	shard_spec shard;
+	double scaling;
+	size_t smoothpixels;
+	double range;
+	bool single_channel;
+	bool by_glyph_index;
+};
+
+bool write_tiles( const std::string& path, const tile_header& header, const std::vector< const char_info* >& tiles );
+
+// appends the file's tiles to charinfos
+bool read_tiles( const std::string& path, tile_header& header, std::vector< char_info >& charinfos );
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+
+#include "variations.h"
+
+#include FT_MULTIPLE_MASTERS_H
+#include FT_SFNT_NAMES_H
+#include FT_TRUETYPE_IDS_H
+
+using namespace msdfgen;
+
+static void free_mm_var( FT_Face face, FT_MM_Var * mm ) {
+#if FREETYPE_MAJOR * 100 + FREETYPE_MINOR >= 209
+	FT_Done_MM_Var( face->glyph->library, mm );
+#else
+	free( mm );
+#endif
+}
+
+static std::string decode_sfnt_name( const FT_SfntName & name ) {
+	std::string result;
+	if( name.platform_id == TT_PLATFORM_MICROSOFT || name.platform_id == TT_PLATFORM_APPLE_UNICODE ) {
+		// UTF-16BE, keep the ASCII subset
+		for( FT_UInt i = 0; i + 1 < name.string_len; i += 2 ) {
+			if( name.string[ i ] == 0 && name.string[ i + 1 ] < 0x80 ) {
+				result += char( name.string[ i + 1 ] );
+			}
+		}
+	}
+	else {
+		result.assign( ( const char * ) name.string, name.string_len );
+	}
+	return result;
+}
+
+static std::string lookup_sfnt_name( FT_Face face, FT_UInt name_id ) {
+	FT_UInt count = FT_Get_Sfnt_Name_Count( face );
+	for( FT_UInt i = 0; i < count; i++ ) {
+		FT_SfntName name;
+		if( FT_Get_Sfnt_Name( face, i, &name ) == 0 && name.name_id == name_id ) {
+			return decode_sfnt_name( name );
+		}
+	}
+	return "";
+}
+
+static FT_ULong make_tag( const std::string & str ) {
+	FT_ULong tag = 0;
+	for( size_t i = 0; i < 4; i++ ) {
+		tag = ( tag << 8 ) | ( i < str.size() ? ( unsigned char ) str[ i ] : ' ' );
+	}
+	return tag;
+}
+
+static bool parse_axis_settings( FT_MM_Var * mm, const std::string & spec, font_instance & instance ) {
+	instance.coords.resize( mm->num_axis );
+	for( FT_UInt i = 0; i < mm->num_axis; i++ ) {
+		instance.coords[ i ] = mm->axis[ i ].def;
+	}
+
+	std::stringstream ss( spec );
+	std::string setting;
+	while( std::getline( ss, setting, ',' ) ) {
+		size_t eq = setting.find( '=' );
+		if( eq == std::string::npos ) {
+			return false;
+		}
+
+		FT_ULong tag = make_tag( setting.substr( 0, eq ) );
+		char * end;
+		double value = strtod( setting.c_str() + eq + 1, &end );
+		if( *end != '\0' ) {
+			return false;
+		}
+
+		bool found = false;
+		for( FT_UInt i = 0; i < mm->num_axis; i++ ) {
+			const FT_Var_Axis & axis = mm->axis[ i ];
+			if( axis.tag == tag ) {
+				FT_Fixed fixed = FT_Fixed( value * 65536.0 );
+				instance.coords[ i ] = std::max( axis.minimum, std::min( axis.maximum, fixed ) );
+				found = true;
+			}
+		}
+
+		if( !found ) {
+			std::cout << "font has no axis \"" << setting.substr( 0, eq ) << "\".\n";
+			return false;
+		}
+	}
+
+	instance.label = spec;
+	for( char & c : instance.label ) {
+		if( c == '=' || c == ',' ) {
+			c = '_';
+		}
+	}
+
+	return true;
+}
+
+bool resolve_instances( FontHandle * font, const std::vector< std::string > & specs, std::vector< font_instance > & instances ) {
+	FT_MM_Var * mm;
+	if( FT_Get_MM_Var( font->face, &mm ) != 0 ) {
+		std::cout << "font is not a variable font.\n";
+		return false;
+	}
+
+	bool ok = true;
+	for( const std::string & spec : specs ) {
+		font_instance instance;
+
+		bool named = false;
+		for( FT_UInt i = 0; i < mm->num_namedstyles; i++ ) {
+			const FT_Var_Named_Style & style = mm->namedstyle[ i ];
+			if( lookup_sfnt_name( font->face, style.strid ) == spec ) {
+				instance.label = spec;
+				instance.coords.assign( style.coords, style.coords + mm->num_axis );
+				named = true;
+				break;
+			}
+		}
+
+		if( !named && !parse_axis_settings( mm, spec, instance ) ) {
+			std::cout << "bad instance \"" << spec << "\": expected a named instance or axis=value[,axis=value...].\n";
+			ok = false;
+			break;
+		}
+
+		instances.push_back( instance );
+	}
+
+	free_mm_var( font->face, mm );
+	return ok;
+}
+
+bool apply_instance( FontHandle * font, const font_instance & instance ) {
+	std::vector< FT_Fixed > coords = instance.coords;
+	return FT_Set_Var_Design_Coordinates( font->face, FT_UInt( coords.size() ), coords.data() ) == 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "msdfgen-ext.h"
+
+// one instance of a variable font, either a named instance from fvar or an
+// explicit set of design coordinates. coords are 16.16 fixed point
+struct font_instance {
+	std::string label;
+	std::vector< FT_Fixed > coords;
+};
+
+// resolves each spec, which is either the name of a named instance ("Bold")
+// or a list of axis settings ("wght=700,wdth=87.5"). axes that aren't
+// mentioned keep their default value
+bool resolve_instances( msdfgen::FontHandle * font, const std::vector< std::string > & specs, std::vector< font_instance > & instances );
+
+bool apply_instance( msdfgen::FontHandle * font, const font_instance & instance );
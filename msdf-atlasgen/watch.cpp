@@ -0,0 +1,144 @@
+#include <string.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#include <sys/stat.h>
+#include <thread>
+#endif
+
+#include "watch.h"
+
+using namespace msdfgen;
+
+// editors tend to write a file in several steps, so wait for things to settle
+static constexpr int SettleMilliseconds = 50;
+
+#ifdef __linux__
+
+file_watcher::file_watcher( const std::string& p ) : path( p ) {
+	// watch the directory rather than the file so we still see it after
+	// it gets replaced
+	size_t slash = path.rfind( '/' );
+	std::string dir = slash == std::string::npos ? "." : path.substr( 0, slash + 1 );
+
+	fd = inotify_init1( IN_CLOEXEC );
+	wd = fd == -1 ? -1 : inotify_add_watch( fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE );
+}
+
+file_watcher::~file_watcher() {
+	if( fd != -1 ) {
+		close( fd );
+	}
+}
+
+bool file_watcher::wait_for_change() {
+	if( wd == -1 ) {
+		return false;
+	}
+
+	size_t slash = path.rfind( '/' );
+	std::string name = slash == std::string::npos ? path : path.substr( slash + 1 );
+
+	alignas( struct inotify_event ) char buf[ 4096 ];
+	bool changed = false;
+
+	while( true ) {
+		// block until something happens, then keep draining until it goes
+		// quiet for a bit
+		pollfd pfd = { fd, POLLIN, 0 };
+		int ready = poll( &pfd, 1, changed ? SettleMilliseconds : -1 );
+		if( ready < 0 ) {
+			return false;
+		}
+		if( ready == 0 ) {
+			return true;
+		}
+
+		ssize_t len = read( fd, buf, sizeof( buf ) );
+		if( len <= 0 ) {
+			return false;
+		}
+
+		for( char* cursor = buf; cursor < buf + len; ) {
+			const inotify_event* event = ( const inotify_event* ) cursor;
+			if( event->len > 0 && strcmp( event->name, name.c_str() ) == 0 ) {
+				changed = true;
+			}
+			cursor += sizeof( inotify_event ) + event->len;
+		}
+	}
+}
+
+#else
+
+static long long modification_time( const std::string& path ) {
+	struct stat st;
+	if( stat( path.c_str(), &st ) != 0 ) {
+		return -1;
+	}
+	return ( long long ) st.st_mtime;
+}
+
+file_watcher::file_watcher( const std::string& p ) : path( p ) {
+	last_mtime = modification_time( path );
+}
+
+file_watcher::~file_watcher() { }
+
+bool file_watcher::wait_for_change() {
+	while( true ) {
+		std::this_thread::sleep_for( std::chrono::milliseconds( 250 ) );
+		long long mtime = modification_time( path );
+		if( mtime != -1 && mtime != last_mtime ) {
+			last_mtime = mtime;
+			std::this_thread::sleep_for( std::chrono::milliseconds( SettleMilliseconds ) );
+			return true;
+		}
+	}
+}
+
+#endif
+
+static void hash_bytes( uint64_t& hash, const void* data, size_t size ) {
+	// FNV-1a
+	const unsigned char* bytes = ( const unsigned char* ) data;
+	for( size_t i = 0; i < size; i++ ) {
+		hash ^= bytes[ i ];
+		hash *= 1099511628211ull;
+	}
+}
+
+static void hash_points( uint64_t& hash, const Point2* points, size_t n ) {
+	hash_bytes( hash, &n, sizeof( n ) );
+	for( size_t i = 0; i < n; i++ ) {
+		hash_bytes( hash, &points[ i ].x, sizeof( double ) );
+		hash_bytes( hash, &points[ i ].y, sizeof( double ) );
+	}
+}
+
+uint64_t hash_shape( const Shape& shape ) {
+	uint64_t hash = 14695981039346656037ull;
+
+	for( const Contour& contour : shape.contours ) {
+		size_t num_edges = contour.edges.size();
+		hash_bytes( hash, &num_edges, sizeof( num_edges ) );
+
+		for( const EdgeHolder& edge : contour.edges ) {
+			if( const LinearSegment* linear = dynamic_cast< const LinearSegment* >( &*edge ) ) {
+				hash_points( hash, linear->p, 2 );
+			}
+			else if( const QuadraticSegment* quadratic = dynamic_cast< const QuadraticSegment* >( &*edge ) ) {
+				hash_points( hash, quadratic->p, 3 );
+			}
+			else if( const CubicSegment* cubic = dynamic_cast< const CubicSegment* >( &*edge ) ) {
+				hash_points( hash, cubic->p, 4 );
+			}
+		}
+	}
+
+	return hash;
+}
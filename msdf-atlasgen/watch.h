@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "msdfgen.h"
+
+// blocks until a file changes. uses inotify on linux, which also catches
+// editors that save by writing a new file and renaming it over the old
+// one, and falls back to polling the modification time elsewhere
+class file_watcher {
+public:
+	explicit file_watcher( const std::string& path );
+	~file_watcher();
+
+	bool wait_for_change();
+
+private:
+	std::string path;
+#ifdef __linux__
+	int fd;
+	int wd;
+#else
+	long long last_mtime;
+#endif
+};
+
+// hash of a shape's geometry, for spotting which glyphs changed between
+// two versions of a font
+uint64_t hash_shape( const msdfgen::Shape& shape );
@@ -0,0 +1,105 @@
+#include <chrono>
+#include <stdio.h>
+
+#include "writer.h"
+
+typedef std::chrono::steady_clock clock_type;
+
+static double seconds_since( clock_type::time_point start ) {
+	return std::chrono::duration< double >( clock_type::now() - start ).count();
+}
+
+static bool replace_file( const std::string& tmp_path, const std::string& path ) {
+#ifdef _WIN32
+	remove( path.c_str() );
+#endif
+	return rename( tmp_path.c_str(), path.c_str() ) == 0;
+}
+
+output_writer::output_writer( size_t cap ) : capacity( cap ), atlases( 0 ), in_flight( 0 ), quit( false ) {
+	thread = std::thread( [this]() { worker(); } );
+}
+
+output_writer::~output_writer() {
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		quit = true;
+	}
+	not_empty.notify_all();
+	thread.join();
+}
+
+void output_writer::push( const std::string& path, write_function write ) {
+	std::lock_guard< std::mutex > lock( mutex );
+	queue.push_back( job { path, write, false } );
+	not_empty.notify_one();
+}
+
+void output_writer::end_atlas() {
+	std::unique_lock< std::mutex > lock( mutex );
+
+	// if the worker already took the last job the atlas is as good as
+	// written and doesn't need counting
+	if( queue.empty() || queue.back().ends_atlas ) {
+		return;
+	}
+	queue.back().ends_atlas = true;
+	atlases++;
+
+	if( atlases > capacity ) {
+		clock_type::time_point start = clock_type::now();
+		not_full.wait( lock, [this]() { return atlases <= capacity; } );
+		totals.stall_seconds += seconds_since( start );
+	}
+}
+
+void output_writer::flush() {
+	std::unique_lock< std::mutex > lock( mutex );
+	not_full.wait( lock, [this]() { return queue.empty() && in_flight == 0; } );
+}
+
+writer_stats output_writer::stats() {
+	std::lock_guard< std::mutex > lock( mutex );
+	return totals;
+}
+
+void output_writer::worker() {
+	std::unique_lock< std::mutex > lock( mutex );
+
+	while( true ) {
+		not_empty.wait( lock, [this]() { return quit || !queue.empty(); } );
+		if( queue.empty() ) {
+			return;
+		}
+
+		job j = queue.front();
+		queue.pop_front();
+		in_flight++;
+		not_full.notify_all();
+		lock.unlock();
+
+		// outputs are written next to their final name and renamed over it,
+		// so anything hot reloading them never sees a half written file
+		clock_type::time_point start = clock_type::now();
+		std::string tmp_path = j.path + ".tmp";
+		bool ok = j.write( tmp_path ) && replace_file( tmp_path, j.path );
+		if( !ok ) {
+			remove( tmp_path.c_str() );
+		}
+		double elapsed = seconds_since( start );
+
+		lock.lock();
+		in_flight--;
+		if( j.ends_atlas ) {
+			atlases--;
+		}
+		totals.busy_seconds += elapsed;
+		if( ok ) {
+			totals.files_written++;
+		}
+		else {
+			totals.files_failed++;
+		}
+		not_full.notify_all();
+	}
+}
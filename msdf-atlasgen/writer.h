@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct writer_stats {
+	size_t files_written = 0;
+	size_t files_failed = 0;
+	// time the writer thread spent encoding and writing
+	double busy_seconds = 0;
+	// time producers spent blocked on a full queue
+	double stall_seconds = 0;
+};
+
+// owns encoding and file I/O for the outputs so the next atlas can be
+// generated while the last one is being deflated and written. the queue is
+// bounded in atlases, since an atlas's files share its bitmaps and only free
+// them together: producers block once capacity atlases are waiting, so
+// memory use stays in check
+class output_writer {
+public:
+	// writes the file to the path it's given, which is a temporary name that
+	// gets renamed over the real one once the write succeeded
+	typedef std::function< bool( const std::string& ) > write_function;
+
+	explicit output_writer( size_t capacity );
+	~output_writer();
+
+	void push( const std::string& path, write_function write );
+	// everything pushed since the last call is one atlas. blocks while more
+	// than capacity atlases are waiting to be written
+	void end_atlas();
+	void flush();
+
+	writer_stats stats();
+
+private:
+	struct job {
+		std::string path;
+		write_function write;
+		bool ends_atlas;
+	};
+
+	void worker();
+
+	size_t capacity;
+	std::deque< job > queue;
+	// atlases with a job still queued or being written
+	size_t atlases;
+	size_t in_flight;
+	bool quit;
+	writer_stats totals;
+
+	std::mutex mutex;
+	std::condition_variable not_empty;
+	std::condition_variable not_full;
+	std::thread thread;
+};
@@ -0,0 +1,166 @@
+// synthesizes TrueType and OpenType/CFF fonts with as many glyphs, contours
+// and edges of each type as asked for, to benchmark and test msdf-atlasgen
+// at scales the sample fonts don't reach. the same options always give the
+// same file
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <boost/program_options.hpp>
+
+#include "outlines.h"
+#include "sfnt.h"
+
+struct settings {
+	std::string output_file_name;
+	std::string format;
+	size_t num_glyphs;
+	std::string family;
+	uint32_t first_codepoint;
+	// {lines}:{quadratics}:{cubics}, empty for the format's default
+	std::string mix;
+	outline_settings outlines;
+};
+
+namespace po = boost::program_options;
+
+static bool parse_mix( const std::string& str, double mix[ EdgeType_Count ] ) {
+	std::istringstream stream( str );
+	for( size_t i = 0; i < EdgeType_Count; ++i ) {
+		if( i > 0 && stream.get() != ':' ) {
+			return false;
+		}
+		if( !( stream >> mix[ i ] ) || mix[ i ] < 0 ) {
+			return false;
+		}
+	}
+	return stream.peek() == std::char_traits< char >::eof() && mix[ 0 ] + mix[ 1 ] + mix[ 2 ] > 0;
+}
+
+bool parse_options( int argc, char* argv[], settings& cfg ) {
+	std::string first_codepoint;
+	uint16_t units_per_em;
+
+	po::options_description desc( "Allowed options" );
+	desc.add_options()
+		("help", "produce help message")
+		("output,O",        po::value< std::string >(&cfg.output_file_name)->required(), "font file to write")
+		("format",          po::value< std::string >(&cfg.format)->default_value("ttf"), "ttf for glyf outlines (lines and quadratics), otf for CID-keyed CFF outlines (lines and cubics, quadratics are elevated)")
+		("glyphs,n",        po::value< size_t >(&cfg.num_glyphs)->default_value(1000), "number of glyphs including .notdef, at most 65535")
+		("contours",        po::value< size_t >(&cfg.outlines.contours)->default_value(2), "contours per glyph")
+		("edges",           po::value< size_t >(&cfg.outlines.edges)->default_value(8), "edges per contour")
+		("mix",             po::value< std::string >(&cfg.mix), "relative weights of lines, quadratics and cubics as {lines}:{quadratics}:{cubics}. defaults to 1:1:0 for ttf and 1:0:1 for otf")
+		("self-overlap",    po::value< double >(&cfg.outlines.self_overlap)->default_value(0.0), "fraction of glyphs whose contours cross themselves and each other")
+		("tiny-edges",      po::value< double >(&cfg.outlines.tiny_edges)->default_value(0.0), "fraction of glyphs with one unit long edges between the regular ones")
+		("first-codepoint", po::value< std::string >(&first_codepoint)->default_value("0x4e00"), "codepoint of glyph 1, the rest follow in order skipping surrogates")
+		("units-per-em",    po::value< uint16_t >(&units_per_em)->default_value(1000), "font units per em, ttf only. CFF fonts are always 1000")
+		("family",          po::value< std::string >(&cfg.family)->default_value("Synthetic"), "family name")
+		("seed",            po::value< uint32_t >(&cfg.outlines.seed)->default_value(1), "random seed")
+		;
+
+	po::variables_map vm;
+	po::store( po::parse_command_line( argc, argv, desc ), vm );
+
+	if( vm.count( "help" ) ) {
+		desc.print( std::cout );
+		return false;
+	}
+	po::notify( vm );
+
+	if( cfg.format != "ttf" && cfg.format != "otf" ) {
+		std::cout << "--format has to be ttf or otf\n";
+		return false;
+	}
+	bool cff = cfg.format == "otf";
+
+	if( cfg.num_glyphs < 1 || cfg.num_glyphs > 65535 ) {
+		std::cout << "--glyphs has to be between 1 and 65535\n";
+		return false;
+	}
+
+	if( cfg.outlines.edges < 3 && cfg.outlines.contours > 0 ) {
+		std::cout << "--edges has to be at least 3\n";
+		return false;
+	}
+
+	if( cfg.outlines.self_overlap < 0 || cfg.outlines.self_overlap > 1 || cfg.outlines.tiny_edges < 0 || cfg.outlines.tiny_edges > 1 ) {
+		std::cout << "--self-overlap and --tiny-edges are fractions between 0 and 1\n";
+		return false;
+	}
+
+	char* end;
+	cfg.first_codepoint = strtoul( first_codepoint.c_str(), &end, 0 );
+	if( end == first_codepoint.c_str() || *end != '\0' || cfg.first_codepoint > 0x10ffff ) {
+		std::cout << "bad first codepoint \"" << first_codepoint << "\".\n";
+		return false;
+	}
+
+	if( cfg.mix.empty() ) {
+		cfg.mix = cff ? "1:0:1" : "1:1:0";
+	}
+	if( !parse_mix( cfg.mix, cfg.outlines.mix ) ) {
+		std::cout << "bad edge mix \"" << cfg.mix << "\".\n";
+		return false;
+	}
+	if( !cff && cfg.outlines.mix[ EdgeType_Cubic ] > 0 ) {
+		std::cout << "TrueType outlines can't have cubics, use --format otf\n";
+		return false;
+	}
+
+	if( cff && units_per_em != 1000 ) {
+		std::cout << "--units-per-em can't be combined with --format otf\n";
+		return false;
+	}
+	// coordinates have to fit glyf's 16 bit deltas
+	if( units_per_em < 16 || units_per_em > 16384 ) {
+		std::cout << "--units-per-em has to be between 16 and 16384\n";
+		return false;
+	}
+	cfg.outlines.units_per_em = units_per_em;
+
+	return true;
+}
+
+int main( int argc, char* argv[] ) {
+	settings cfg;
+	try {
+		if( !parse_options( argc, argv, cfg ) ) {
+			return 0;
+		}
+	} catch( po::error& err ) {
+		std::cout << err.what() << "\n";
+		return 0;
+	}
+
+	font_description desc;
+	desc.cff = cfg.format == "otf";
+	desc.units_per_em = cfg.outlines.units_per_em;
+	desc.family = cfg.family;
+	desc.codepoints = assign_codepoints( cfg.num_glyphs - 1, cfg.first_codepoint );
+	if( desc.codepoints.size() < cfg.num_glyphs - 1 ) {
+		std::cout << "error: not enough codepoints after 0x" << std::hex << cfg.first_codepoint << std::dec << " for " << cfg.num_glyphs << " glyphs.\n";
+		return 1;
+	}
+
+	std::vector< glyph_outline > glyphs;
+	glyphs.push_back( notdef_outline( cfg.outlines ) );
+	for( size_t i = 1; i < cfg.num_glyphs; ++i ) {
+		glyphs.push_back( random_outline( cfg.outlines, i ) );
+	}
+
+	std::vector< uint8_t > font = build_font( glyphs, desc );
+	std::ofstream file( cfg.output_file_name, std::ios::out | std::ios::binary | std::ios::trunc );
+	file.write( reinterpret_cast< const char* >( font.data() ), font.size() );
+	if( !file ) {
+		std::cout << "error: couldn't write \"" << cfg.output_file_name << "\".\n";
+		return 1;
+	}
+
+	std::cout << "wrote " << cfg.num_glyphs << " glyphs to \"" << cfg.output_file_name << "\"";
+	if( !desc.codepoints.empty() ) {
+		std::cout << std::hex << ", mapped to 0x" << desc.codepoints.front() << "-0x" << desc.codepoints.back() << std::dec;
+	}
+	std::cout << ".\n";
+	return 0;
+}
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "outlines.h"
+
+static const double Pi = 3.14159265358979323846;
+
+// where glyphs are drawn, in ems. the advance is a whole em
+static const double BoxLeft = 0.05;
+static const double BoxBottom = -0.15;
+static const double BoxSize = 0.9;
+
+static point make_point( double x, double y ) {
+	return point { int32_t( lround( x ) ), int32_t( lround( y ) ) };
+}
+
+static bool operator==( const point& a, const point& b ) {
+	return a.x == b.x && a.y == b.y;
+}
+
+static contour polygon( const std::vector< point >& vertices ) {
+	contour result;
+	result.start = vertices.front();
+	for( size_t i = 0; i < vertices.size(); ++i ) {
+		edge e = { };
+		e.type = EdgeType_Line;
+		e.end = vertices[ ( i + 1 ) % vertices.size() ];
+		result.edges.push_back( e );
+	}
+	return result;
+}
+
+glyph_outline notdef_outline( const outline_settings& cfg ) {
+	double em = cfg.units_per_em;
+	point outer[] = { make_point( 0.1 * em, 0 ), make_point( 0.1 * em, 0.7 * em ), make_point( 0.5 * em, 0.7 * em ), make_point( 0.5 * em, 0 ) };
+	point inner[] = { make_point( 0.15 * em, 0.05 * em ), make_point( 0.45 * em, 0.05 * em ), make_point( 0.45 * em, 0.65 * em ), make_point( 0.15 * em, 0.65 * em ) };
+
+	glyph_outline glyph;
+	glyph.advance = uint16_t( lround( 0.6 * em ) );
+	glyph.contours.push_back( polygon( std::vector< point >( std::begin( outer ), std::end( outer ) ) ) );
+	glyph.contours.push_back( polygon( std::vector< point >( std::begin( inner ), std::end( inner ) ) ) );
+	return glyph;
+}
+
+// a star shaped contour around the center, so it doesn't cross itself
+// unless the vertices get shuffled
+static std::vector< point > random_vertices( std::mt19937& rng, size_t count, double cx, double cy, double rx, double ry ) {
+	std::uniform_real_distribution< double > jitter( -0.3, 0.3 );
+	std::uniform_real_distribution< double > radius( 0.6, 1.0 );
+
+	double step = 2.0 * Pi / count;
+	double phase = std::uniform_real_distribution< double >( 0.0, step )( rng );
+
+	std::vector< point > vertices;
+	for( size_t i = 0; i < count; ++i ) {
+		// clockwise
+		double angle = -( phase + ( i + jitter( rng ) ) * step );
+		double r = radius( rng );
+		point p = make_point( cx + rx * r * cos( angle ), cy + ry * r * sin( angle ) );
+		if( vertices.empty() || !( p == vertices.back() ) ) {
+			vertices.push_back( p );
+		}
+	}
+	while( vertices.size() > 1 && vertices.front() == vertices.back() ) {
+		vertices.pop_back();
+	}
+	return vertices;
+}
+
+// puts a vertex a unit away after some of the others, making edges far
+// shorter than anything else in the glyph
+static void add_tiny_edges( std::mt19937& rng, std::vector< point >& vertices ) {
+	static const point steps[] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+	std::bernoulli_distribution insert( 0.3 );
+	std::uniform_int_distribution< size_t > direction( 0, 3 );
+
+	std::vector< point > result;
+	for( size_t i = 0; i < vertices.size(); ++i ) {
+		result.push_back( vertices[ i ] );
+		if( insert( rng ) ) {
+			const point& step = steps[ direction( rng ) ];
+			point p { vertices[ i ].x + step.x, vertices[ i ].y + step.y };
+			if( !( p == vertices[ ( i + 1 ) % vertices.size() ] ) ) {
+				result.push_back( p );
+			}
+		}
+	}
+	vertices.swap( result );
+}
+
+// turns the polygon's sides into edges of random type. curves bulge
+// mostly away from the center, sometimes towards it
+static contour curved_contour( std::mt19937& rng, const std::vector< point >& vertices, double cx, double cy, const outline_settings& cfg ) {
+	std::discrete_distribution< int > type( std::begin( cfg.mix ), std::end( cfg.mix ) );
+	std::uniform_real_distribution< double > bulge( -0.1, 0.3 );
+	std::uniform_real_distribution< double > swing( -0.2, 0.3 );
+
+	contour result;
+	result.start = vertices.front();
+	for( size_t i = 0; i < vertices.size(); ++i ) {
+		const point& from = vertices[ i ];
+		const point& to = vertices[ ( i + 1 ) % vertices.size() ];
+		double dx = to.x - from.x;
+		double dy = to.y - from.y;
+
+		// the normal pointing away from the center
+		double nx = dy, ny = -dx;
+		if( ( ( from.x + to.x ) * 0.5 - cx ) * nx + ( ( from.y + to.y ) * 0.5 - cy ) * ny < 0 ) {
+			nx = -nx;
+			ny = -ny;
+		}
+
+		edge e = { };
+		e.type = edge_type( type( rng ) );
+		e.end = to;
+		if( e.type == EdgeType_Quadratic ) {
+			double b = bulge( rng );
+			e.controls[ 0 ] = make_point( from.x + dx * 0.5 + nx * b, from.y + dy * 0.5 + ny * b );
+		}
+		else if( e.type == EdgeType_Cubic ) {
+			double b1 = swing( rng ), b2 = swing( rng );
+			e.controls[ 0 ] = make_point( from.x + dx / 3.0 + nx * b1, from.y + dy / 3.0 + ny * b1 );
+			e.controls[ 1 ] = make_point( from.x + dx * 2.0 / 3.0 + nx * b2, from.y + dy * 2.0 / 3.0 + ny * b2 );
+		}
+		result.edges.push_back( e );
+	}
+	return result;
+}
+
+glyph_outline random_outline( const outline_settings& cfg, size_t index ) {
+	std::seed_seq seed { cfg.seed, uint32_t( index ), uint32_t( index >> 32 ) };
+	std::mt19937 rng( seed );
+	std::uniform_real_distribution< double > unit( 0.0, 1.0 );
+
+	double em = cfg.units_per_em;
+	bool overlap = unit( rng ) < cfg.self_overlap;
+	bool tiny = unit( rng ) < cfg.tiny_edges;
+
+	glyph_outline glyph;
+	glyph.advance = cfg.units_per_em;
+	// --contours 0 makes blank glyphs
+	if( cfg.contours == 0 ) {
+		return glyph;
+	}
+
+	// regular glyphs give every contour a cell of its own so they stay
+	// apart, overlapping ones put them all in the same place
+	size_t columns = overlap ? 1 : size_t( ceil( sqrt( double( cfg.contours ) ) ) );
+	size_t rows = overlap ? 1 : ( cfg.contours + columns - 1 ) / columns;
+	double cell_width = BoxSize * em / columns;
+	double cell_height = BoxSize * em / rows;
+
+	for( size_t c = 0; c < cfg.contours; ++c ) {
+		size_t cell = overlap ? 0 : c;
+		double cx = BoxLeft * em + ( cell % columns + 0.5 + 0.2 * ( unit( rng ) - 0.5 ) ) * cell_width;
+		double cy = BoxBottom * em + ( cell / columns + 0.5 + 0.2 * ( unit( rng ) - 0.5 ) ) * cell_height;
+		double rx = cell_width * ( 0.2 + 0.15 * unit( rng ) );
+		double ry = cell_height * ( 0.2 + 0.15 * unit( rng ) );
+
+		std::vector< point > vertices = random_vertices( rng, cfg.edges, cx, cy, rx, ry );
+		if( overlap ) {
+			std::shuffle( vertices.begin(), vertices.end(), rng );
+		}
+		if( tiny ) {
+			add_tiny_edges( rng, vertices );
+		}
+		if( vertices.size() < 3 ) {
+			continue;
+		}
+
+		glyph.contours.push_back( curved_contour( rng, vertices, cx, cy, cfg ) );
+	}
+
+	return glyph;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// font units, y up
+struct point {
+	int32_t x, y;
+};
+
+enum edge_type {
+	EdgeType_Line,
+	EdgeType_Quadratic,
+	EdgeType_Cubic,
+	EdgeType_Count
+};
+
+// an edge starts where the previous one ended. quadratics use
+// controls[ 0 ], cubics both
+struct edge {
+	edge_type type;
+	point controls[ 2 ];
+	point end;
+};
+
+// closed, the last edge ends at start. filled contours run clockwise like
+// TrueType wants. CFF fills either way round, but msdfgen goes by the
+// winding, so CFF fonts get the same
+struct contour {
+	point start;
+	std::vector< edge > edges;
+};
+
+struct glyph_outline {
+	std::vector< contour > contours;
+	uint16_t advance;
+};
+
+struct outline_settings {
+	uint16_t units_per_em;
+	size_t contours;
+	size_t edges;
+	// relative weights of the edge types
+	double mix[ EdgeType_Count ];
+	// fraction of glyphs with self-intersecting, overlapping contours
+	double self_overlap;
+	// fraction of glyphs with edges a unit long between the regular ones
+	double tiny_edges;
+	uint32_t seed;
+};
+
+// a hollow box, like most fonts' .notdef
+glyph_outline notdef_outline( const outline_settings& cfg );
+
+// random outlines. the same settings and index always give the same glyph,
+// whatever else gets generated
+glyph_outline random_outline( const outline_settings& cfg, size_t index );
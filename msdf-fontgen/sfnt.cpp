@@ -0,0 +1,650 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include "sfnt.h"
+
+// big endian, like everything in an sfnt
+class byte_buffer {
+public:
+	std::vector< uint8_t > data;
+
+	void u8( uint32_t v ) { data.push_back( uint8_t( v ) ); }
+	void u16( uint32_t v ) { u8( v >> 8 ); u8( v ); }
+	void s16( int32_t v ) { u16( uint16_t( v ) ); }
+	void u32( uint32_t v ) { u16( v >> 16 ); u16( v ); }
+
+	void append( const std::vector< uint8_t >& other ) {
+		data.insert( data.end(), other.begin(), other.end() );
+	}
+
+	void pad( size_t alignment ) {
+		while( data.size() % alignment != 0 ) {
+			u8( 0 );
+		}
+	}
+
+	void put_u32( size_t offset, uint32_t v ) {
+		for( size_t i = 0; i < 4; ++i ) {
+			data[ offset + i ] = uint8_t( v >> ( 24 - 8 * i ) );
+		}
+	}
+
+	size_t size() const { return data.size(); }
+};
+
+struct glyph_bounds {
+	int32_t x_min, y_min, x_max, y_max;
+	bool empty;
+};
+
+// over every point, off-curve ones included, which is what glyf stores
+static glyph_bounds outline_bounds( const glyph_outline& glyph ) {
+	glyph_bounds b = { 0, 0, 0, 0, true };
+	auto add = [&]( const point& p ) {
+		if( b.empty ) {
+			b = glyph_bounds { p.x, p.y, p.x, p.y, false };
+			return;
+		}
+		b.x_min = std::min( b.x_min, p.x );
+		b.y_min = std::min( b.y_min, p.y );
+		b.x_max = std::max( b.x_max, p.x );
+		b.y_max = std::max( b.y_max, p.y );
+	};
+
+	for( const contour& c : glyph.contours ) {
+		add( c.start );
+		for( const edge& e : c.edges ) {
+			if( e.type != EdgeType_Line ) {
+				add( e.controls[ 0 ] );
+			}
+			if( e.type == EdgeType_Cubic ) {
+				add( e.controls[ 1 ] );
+			}
+			add( e.end );
+		}
+	}
+	return b;
+}
+
+std::vector< uint32_t > assign_codepoints( size_t count, uint32_t first ) {
+	std::vector< uint32_t > result;
+	for( uint32_t cp = first; result.size() < count && cp <= 0x10ffff; ++cp ) {
+		bool surrogate = cp >= 0xd800 && cp <= 0xdfff;
+		bool noncharacter = ( cp & 0xfffe ) == 0xfffe;
+		if( !surrogate && !noncharacter ) {
+			result.push_back( cp );
+		}
+	}
+	return result;
+}
+
+// TrueType
+
+static void write_glyf_entry( byte_buffer& glyf, const glyph_outline& glyph, const glyph_bounds& b ) {
+	if( glyph.contours.empty() ) {
+		return;
+	}
+
+	std::vector< point > points;
+	std::vector< bool > on_curve;
+	std::vector< size_t > contour_ends;
+	for( const contour& c : glyph.contours ) {
+		points.push_back( c.start );
+		on_curve.push_back( true );
+		for( size_t i = 0; i < c.edges.size(); ++i ) {
+			const edge& e = c.edges[ i ];
+			if( e.type == EdgeType_Quadratic ) {
+				points.push_back( e.controls[ 0 ] );
+				on_curve.push_back( false );
+			}
+			else if( e.type == EdgeType_Cubic ) {
+				// glyf has no cubics, main doesn't ask for them. the
+				// quadratic closest at the midpoint will do
+				const point& from = i == 0 ? c.start : c.edges[ i - 1 ].end;
+				point control = {
+					int32_t( lround( ( 3.0 * ( e.controls[ 0 ].x + e.controls[ 1 ].x ) - from.x - e.end.x ) / 4.0 ) ),
+					int32_t( lround( ( 3.0 * ( e.controls[ 0 ].y + e.controls[ 1 ].y ) - from.y - e.end.y ) / 4.0 ) ),
+				};
+				points.push_back( control );
+				on_curve.push_back( false );
+			}
+			// the last edge ends at the start, which the contour closes to
+			if( i + 1 < c.edges.size() ) {
+				points.push_back( e.end );
+				on_curve.push_back( true );
+			}
+		}
+		contour_ends.push_back( points.size() - 1 );
+	}
+
+	glyf.s16( int32_t( glyph.contours.size() ) );
+	glyf.s16( b.x_min );
+	glyf.s16( b.y_min );
+	glyf.s16( b.x_max );
+	glyf.s16( b.y_max );
+	for( size_t end : contour_ends ) {
+		glyf.u16( uint32_t( end ) );
+	}
+	// no instructions
+	glyf.u16( 0 );
+
+	// every coordinate as a 16 bit delta, so the flags are just on curve
+	for( bool on : on_curve ) {
+		glyf.u8( on ? 0x01 : 0x00 );
+	}
+	point previous = { 0, 0 };
+	for( const point& p : points ) {
+		glyf.s16( p.x - previous.x );
+		previous.x = p.x;
+	}
+	for( const point& p : points ) {
+		glyf.s16( p.y - previous.y );
+		previous.y = p.y;
+	}
+}
+
+// CFF
+
+static void cff_number( byte_buffer& out, int32_t v ) {
+	out.u8( 28 );
+	out.s16( v );
+}
+
+// always 5 bytes, so dicts can be sized before the offsets in them are known
+static void cff_dict_int( byte_buffer& out, int32_t v ) {
+	out.u8( 29 );
+	out.u32( uint32_t( v ) );
+}
+
+static void cff_index( byte_buffer& out, const std::vector< std::vector< uint8_t > >& objects ) {
+	out.u16( uint32_t( objects.size() ) );
+	if( objects.empty() ) {
+		return;
+	}
+
+	out.u8( 4 );
+	uint32_t offset = 1;
+	out.u32( offset );
+	for( const auto& object : objects ) {
+		offset += uint32_t( object.size() );
+		out.u32( offset );
+	}
+	for( const auto& object : objects ) {
+		out.append( object );
+	}
+}
+
+static std::vector< uint8_t > cff_charstring( const glyph_outline& glyph ) {
+	enum { rlineto = 5, rrcurveto = 8, endchar = 14, rmoveto = 21 };
+
+	byte_buffer out;
+	point pen = { 0, 0 };
+	auto to = [&]( const point& p ) {
+		cff_number( out, p.x - pen.x );
+		cff_number( out, p.y - pen.y );
+		pen = p;
+	};
+
+	for( const contour& c : glyph.contours ) {
+		to( c.start );
+		out.u8( rmoveto );
+
+		for( const edge& e : c.edges ) {
+			if( e.type == EdgeType_Line ) {
+				to( e.end );
+				out.u8( rlineto );
+				continue;
+			}
+
+			point c1 = e.controls[ 0 ], c2 = e.controls[ 1 ];
+			if( e.type == EdgeType_Quadratic ) {
+				// degree elevation, exact up to rounding
+				const point& q = e.controls[ 0 ];
+				c1 = point { int32_t( lround( pen.x + 2.0 * ( q.x - pen.x ) / 3.0 ) ), int32_t( lround( pen.y + 2.0 * ( q.y - pen.y ) / 3.0 ) ) };
+				c2 = point { int32_t( lround( e.end.x + 2.0 * ( q.x - e.end.x ) / 3.0 ) ), int32_t( lround( e.end.y + 2.0 * ( q.y - e.end.y ) / 3.0 ) ) };
+			}
+			to( c1 );
+			to( c2 );
+			to( e.end );
+			out.u8( rrcurveto );
+		}
+	}
+
+	out.u8( endchar );
+	return out.data;
+}
+
+static std::vector< uint8_t > build_cff( const std::vector< glyph_outline >& glyphs, const font_description& desc ) {
+	enum {
+		op_charset = 15,
+		op_charstrings = 17,
+		op_private = 18,
+		op_default_width_x = 20,
+		op_escape = 12,
+		op_ros = 30,
+		op_cid_count = 34,
+		op_fd_array = 36,
+		op_fd_select = 37,
+	};
+
+	uint32_t num_glyphs = uint32_t( glyphs.size() );
+	std::string ps_name = desc.family;
+	ps_name.erase( std::remove( ps_name.begin(), ps_name.end(), ' ' ), ps_name.end() );
+
+	auto top_dict = [&]( int32_t charset, int32_t charstrings, int32_t fd_array, int32_t fd_select ) {
+		byte_buffer dict;
+		// the first two custom strings, "Adobe" and "Identity"
+		cff_dict_int( dict, 391 );
+		cff_dict_int( dict, 392 );
+		cff_dict_int( dict, 0 );
+		dict.u8( op_escape );
+		dict.u8( op_ros );
+		cff_dict_int( dict, int32_t( num_glyphs ) );
+		dict.u8( op_escape );
+		dict.u8( op_cid_count );
+		cff_dict_int( dict, charset );
+		dict.u8( op_charset );
+		cff_dict_int( dict, charstrings );
+		dict.u8( op_charstrings );
+		cff_dict_int( dict, fd_array );
+		dict.u8( op_escape );
+		dict.u8( op_fd_array );
+		cff_dict_int( dict, fd_select );
+		dict.u8( op_escape );
+		dict.u8( op_fd_select );
+		return dict.data;
+	};
+
+	auto font_dict = [&]( int32_t private_size, int32_t private_offset ) {
+		byte_buffer dict;
+		cff_dict_int( dict, private_size );
+		cff_dict_int( dict, private_offset );
+		dict.u8( op_private );
+		return dict.data;
+	};
+
+	byte_buffer private_dict;
+	cff_dict_int( private_dict, 0 );
+	private_dict.u8( op_default_width_x );
+
+	// glyph n is CID n
+	byte_buffer charset;
+	charset.u8( 2 );
+	if( num_glyphs > 1 ) {
+		charset.u16( 1 );
+		charset.u16( num_glyphs - 2 );
+	}
+
+	// every glyph uses font dict 0
+	byte_buffer fd_select;
+	fd_select.u8( 3 );
+	fd_select.u16( 1 );
+	fd_select.u16( 0 );
+	fd_select.u8( 0 );
+	fd_select.u16( num_glyphs );
+
+	std::vector< std::vector< uint8_t > > charstrings;
+	for( const glyph_outline& glyph : glyphs ) {
+		charstrings.push_back( cff_charstring( glyph ) );
+	}
+	byte_buffer charstring_index;
+	cff_index( charstring_index, charstrings );
+
+	byte_buffer head;
+	head.u8( 1 );
+	head.u8( 0 );
+	head.u8( 4 );
+	head.u8( 4 );
+	cff_index( head, { std::vector< uint8_t >( ps_name.begin(), ps_name.end() ) } );
+
+	byte_buffer strings;
+	cff_index( strings, { { 'A', 'd', 'o', 'b', 'e' }, { 'I', 'd', 'e', 'n', 't', 'i', 't', 'y' } } );
+	// no global subroutines
+	strings.u16( 0 );
+
+	// the top dict is the same size whatever the offsets are
+	byte_buffer sizing;
+	cff_index( sizing, { top_dict( 0, 0, 0, 0 ) } );
+
+	size_t charset_offset = head.size() + sizing.size() + strings.size();
+	size_t fd_select_offset = charset_offset + charset.size();
+	size_t charstrings_offset = fd_select_offset + fd_select.size();
+	size_t fd_array_offset = charstrings_offset + charstring_index.size();
+	byte_buffer fd_array;
+	cff_index( fd_array, { font_dict( 0, 0 ) } );
+	size_t private_offset = fd_array_offset + fd_array.size();
+
+	fd_array = byte_buffer();
+	cff_index( fd_array, { font_dict( int32_t( private_dict.size() ), int32_t( private_offset ) ) } );
+
+	byte_buffer cff = head;
+	cff_index( cff, { top_dict( int32_t( charset_offset ), int32_t( charstrings_offset ), int32_t( fd_array_offset ), int32_t( fd_select_offset ) ) } );
+	cff.append( strings.data );
+	cff.append( charset.data );
+	cff.append( fd_select.data );
+	cff.append( charstring_index.data );
+	cff.append( fd_array.data );
+	cff.append( private_dict.data );
+	return cff.data;
+}
+
+// the other tables
+
+static std::vector< uint8_t > build_cmap( const font_description& desc ) {
+	// runs of consecutive codepoints on consecutive glyphs
+	struct group { uint32_t first, last, glyph; };
+	std::vector< group > groups;
+	for( size_t i = 0; i < desc.codepoints.size(); ++i ) {
+		uint32_t cp = desc.codepoints[ i ];
+		uint32_t glyph = uint32_t( i + 1 );
+		if( !groups.empty() && groups.back().last + 1 == cp && groups.back().glyph + ( cp - groups.back().first ) == glyph ) {
+			groups.back().last = cp;
+		}
+		else {
+			groups.push_back( group { cp, cp, glyph } );
+		}
+	}
+
+	byte_buffer cmap;
+	cmap.u16( 0 );
+	cmap.u16( 1 );
+	// windows, full unicode
+	cmap.u16( 3 );
+	cmap.u16( 10 );
+	cmap.u32( 12 );
+
+	cmap.u16( 12 );
+	cmap.u16( 0 );
+	cmap.u32( uint32_t( 16 + 12 * groups.size() ) );
+	cmap.u32( 0 );
+	cmap.u32( uint32_t( groups.size() ) );
+	for( const group& g : groups ) {
+		cmap.u32( g.first );
+		cmap.u32( g.last );
+		cmap.u32( g.glyph );
+	}
+	return cmap.data;
+}
+
+static std::vector< uint8_t > build_name( const font_description& desc ) {
+	std::string ps_name = desc.family;
+	ps_name.erase( std::remove( ps_name.begin(), ps_name.end(), ' ' ), ps_name.end() );
+
+	const std::pair< uint16_t, std::string > names[] = {
+		{ 1, desc.family },
+		{ 2, "Regular" },
+		{ 3, ps_name },
+		{ 4, desc.family },
+		{ 6, ps_name },
+	};
+	const size_t count = sizeof( names ) / sizeof( names[ 0 ] );
+
+	byte_buffer table, strings;
+	table.u16( 0 );
+	table.u16( uint32_t( count ) );
+	table.u16( uint32_t( 6 + 12 * count ) );
+	for( const auto& name : names ) {
+		// windows, unicode bmp, en-US
+		table.u16( 3 );
+		table.u16( 1 );
+		table.u16( 0x409 );
+		table.u16( name.first );
+		table.u16( uint32_t( 2 * name.second.size() ) );
+		table.u16( uint32_t( strings.size() ) );
+		for( char c : name.second ) {
+			strings.u16( uint8_t( c ) );
+		}
+	}
+	table.append( strings.data );
+	return table.data;
+}
+
+static uint32_t checksum( const std::vector< uint8_t >& data, size_t offset, size_t length ) {
+	uint32_t sum = 0;
+	for( size_t i = 0; i < length; i += 4 ) {
+		uint32_t word = 0;
+		for( size_t j = 0; j < 4; ++j ) {
+			word = word << 8 | ( i + j < length ? data[ offset + i + j ] : 0 );
+		}
+		sum += word;
+	}
+	return sum;
+}
+
+std::vector< uint8_t > build_font( const std::vector< glyph_outline >& glyphs, const font_description& desc ) {
+	const int32_t em = desc.units_per_em;
+	const int32_t ascender = int32_t( lround( 0.8 * em ) );
+	const int32_t descender = -int32_t( lround( 0.2 * em ) );
+
+	std::vector< glyph_bounds > bounds;
+	glyph_bounds font_bounds = { 0, 0, 0, 0, true };
+	uint32_t max_advance = 0;
+	int32_t min_lsb = 0, min_rsb = 0, max_extent = 0;
+	size_t max_points = 0, max_contours = 0;
+	bool have_metrics = false;
+
+	for( const glyph_outline& glyph : glyphs ) {
+		glyph_bounds b = outline_bounds( glyph );
+		bounds.push_back( b );
+		max_advance = std::max< uint32_t >( max_advance, glyph.advance );
+		max_contours = std::max( max_contours, glyph.contours.size() );
+
+		size_t points = 0;
+		for( const contour& c : glyph.contours ) {
+			for( const edge& e : c.edges ) {
+				points += e.type == EdgeType_Line ? 1 : 2;
+			}
+		}
+		max_points = std::max( max_points, points );
+
+		if( b.empty ) {
+			continue;
+		}
+		if( font_bounds.empty ) {
+			font_bounds = b;
+		}
+		font_bounds.x_min = std::min( font_bounds.x_min, b.x_min );
+		font_bounds.y_min = std::min( font_bounds.y_min, b.y_min );
+		font_bounds.x_max = std::max( font_bounds.x_max, b.x_max );
+		font_bounds.y_max = std::max( font_bounds.y_max, b.y_max );
+
+		int32_t lsb = b.x_min, rsb = int32_t( glyph.advance ) - b.x_max;
+		min_lsb = have_metrics ? std::min( min_lsb, lsb ) : lsb;
+		min_rsb = have_metrics ? std::min( min_rsb, rsb ) : rsb;
+		max_extent = have_metrics ? std::max( max_extent, b.x_max ) : b.x_max;
+		have_metrics = true;
+	}
+
+	std::map< std::string, std::vector< uint8_t > > tables;
+
+	byte_buffer head;
+	head.u32( 0x00010000 );
+	head.u32( 0x00010000 );
+	// checkSumAdjustment, filled in at the end
+	head.u32( 0 );
+	head.u32( 0x5f0f3cf5 );
+	// baseline at y = 0, left side bearing at x = xMin
+	head.u16( 0x0003 );
+	head.u16( desc.units_per_em );
+	head.u32( 0 );
+	head.u32( 0 );
+	head.u32( 0 );
+	head.u32( 0 );
+	head.s16( font_bounds.x_min );
+	head.s16( font_bounds.y_min );
+	head.s16( font_bounds.x_max );
+	head.s16( font_bounds.y_max );
+	head.u16( 0 );
+	head.u16( 8 );
+	head.s16( 2 );
+	// long loca offsets
+	head.s16( desc.cff ? 0 : 1 );
+	head.s16( 0 );
+	tables[ "head" ] = head.data;
+
+	byte_buffer hhea;
+	hhea.u32( 0x00010000 );
+	hhea.s16( ascender );
+	hhea.s16( descender );
+	hhea.s16( 0 );
+	hhea.u16( max_advance );
+	hhea.s16( min_lsb );
+	hhea.s16( min_rsb );
+	hhea.s16( max_extent );
+	hhea.s16( 1 );
+	hhea.s16( 0 );
+	hhea.s16( 0 );
+	for( size_t i = 0; i < 4; ++i ) {
+		hhea.s16( 0 );
+	}
+	hhea.s16( 0 );
+	hhea.u16( uint32_t( glyphs.size() ) );
+	tables[ "hhea" ] = hhea.data;
+
+	byte_buffer hmtx;
+	for( size_t i = 0; i < glyphs.size(); ++i ) {
+		hmtx.u16( glyphs[ i ].advance );
+		hmtx.s16( bounds[ i ].x_min );
+	}
+	tables[ "hmtx" ] = hmtx.data;
+
+	byte_buffer maxp;
+	if( desc.cff ) {
+		maxp.u32( 0x00005000 );
+		maxp.u16( uint32_t( glyphs.size() ) );
+	}
+	else {
+		maxp.u32( 0x00010000 );
+		maxp.u16( uint32_t( glyphs.size() ) );
+		maxp.u16( uint32_t( max_points ) );
+		maxp.u16( uint32_t( max_contours ) );
+		// no composites
+		maxp.u16( 0 );
+		maxp.u16( 0 );
+		// zones, then no twilight points, storage, functions, instructions
+		// or components
+		maxp.u16( 2 );
+		for( size_t i = 0; i < 8; ++i ) {
+			maxp.u16( 0 );
+		}
+	}
+	tables[ "maxp" ] = maxp.data;
+
+	uint32_t first_char = desc.codepoints.empty() ? 0 : desc.codepoints.front();
+	uint32_t last_char = desc.codepoints.empty() ? 0 : desc.codepoints.back();
+
+	byte_buffer os2;
+	os2.u16( 4 );
+	os2.s16( int32_t( max_advance ) );
+	// regular weight, normal width, installable
+	os2.u16( 400 );
+	os2.u16( 5 );
+	os2.u16( 0 );
+	// sub- and superscript size and offset
+	os2.s16( em * 65 / 100 );
+	os2.s16( em * 60 / 100 );
+	os2.s16( 0 );
+	os2.s16( em * 7 / 100 );
+	os2.s16( em * 65 / 100 );
+	os2.s16( em * 60 / 100 );
+	os2.s16( 0 );
+	os2.s16( em * 35 / 100 );
+	// strikeout size and position
+	os2.s16( em * 5 / 100 );
+	os2.s16( em * 30 / 100 );
+	os2.s16( 0 );
+	for( size_t i = 0; i < 10; ++i ) {
+		os2.u8( 0 );
+	}
+	for( size_t i = 0; i < 4; ++i ) {
+		os2.u32( 0 );
+	}
+	os2.u8( 'N' );
+	os2.u8( 'O' );
+	os2.u8( 'N' );
+	os2.u8( 'E' );
+	// regular
+	os2.u16( 0x0040 );
+	os2.u16( std::min< uint32_t >( first_char, 0xffff ) );
+	os2.u16( std::min< uint32_t >( last_char, 0xffff ) );
+	os2.s16( ascender );
+	os2.s16( descender );
+	os2.s16( 0 );
+	os2.u16( uint32_t( ascender ) );
+	os2.u16( uint32_t( -descender ) );
+	os2.u32( 0 );
+	os2.u32( 0 );
+	// x height, cap height, default and break char, max context
+	os2.s16( em / 2 );
+	os2.s16( em * 7 / 10 );
+	os2.u16( 0 );
+	os2.u16( 32 );
+	os2.u16( 0 );
+	tables[ "OS/2" ] = os2.data;
+
+	byte_buffer post;
+	post.u32( 0x00030000 );
+	post.u32( 0 );
+	post.s16( -em / 10 );
+	post.s16( em / 20 );
+	for( size_t i = 0; i < 5; ++i ) {
+		post.u32( 0 );
+	}
+	tables[ "post" ] = post.data;
+
+	tables[ "cmap" ] = build_cmap( desc );
+	tables[ "name" ] = build_name( desc );
+
+	if( desc.cff ) {
+		tables[ "CFF " ] = build_cff( glyphs, desc );
+	}
+	else {
+		byte_buffer glyf, loca;
+		for( size_t i = 0; i < glyphs.size(); ++i ) {
+			loca.u32( uint32_t( glyf.size() ) );
+			write_glyf_entry( glyf, glyphs[ i ], bounds[ i ] );
+			glyf.pad( 4 );
+		}
+		loca.u32( uint32_t( glyf.size() ) );
+		tables[ "glyf" ] = glyf.data;
+		tables[ "loca" ] = loca.data;
+	}
+
+	// the table directory, sorted by tag, which std::map already is
+	uint16_t num_tables = uint16_t( tables.size() );
+	uint16_t entry_selector = 0;
+	while( ( 2u << entry_selector ) <= num_tables ) {
+		entry_selector++;
+	}
+	uint16_t search_range = uint16_t( 16u << entry_selector );
+
+	byte_buffer font;
+	font.u32( desc.cff ? 0x4f54544f : 0x00010000 );
+	font.u16( num_tables );
+	font.u16( search_range );
+	font.u16( entry_selector );
+	font.u16( num_tables * 16 - search_range );
+
+	size_t offset = 12 + 16 * tables.size();
+	size_t head_offset = 0;
+	for( const auto& table : tables ) {
+		for( char c : table.first ) {
+			font.u8( uint8_t( c ) );
+		}
+		font.u32( checksum( table.second, 0, table.second.size() ) );
+		font.u32( uint32_t( offset ) );
+		font.u32( uint32_t( table.second.size() ) );
+		if( table.first == "head" ) {
+			head_offset = offset;
+		}
+		offset += ( table.second.size() + 3 ) & ~size_t( 3 );
+	}
+	for( const auto& table : tables ) {
+		font.append( table.second );
+		font.pad( 4 );
+	}
+
+	font.put_u32( head_offset + 8, 0xb1b0afba - checksum( font.data, 0, font.size() ) );
+	return font.data;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "outlines.h"
+
+struct font_description {
+	// CFF outlines in an OpenType (.otf) wrapper instead of glyf/loca
+	bool cff;
+	uint16_t units_per_em;
+	std::string family;
+	// codepoint of glyph n, from 1 on. glyph 0 is .notdef and unmapped
+	std::vector< uint32_t > codepoints;
+};
+
+// the codepoints of count glyphs numbered from first, skipping surrogates
+// and the noncharacters at the end of every plane
+std::vector< uint32_t > assign_codepoints( size_t count, uint32_t first );
+
+// the tables FreeType and the native decoder need, plus OS/2, name and post
+// so other tools accept the file too. CFF fonts are CID-keyed, since name
+// keyed ones need a glyph name for every glyph
+std::vector< uint8_t > build_font( const std::vector< glyph_outline >& glyphs, const font_description& desc );
@@ -0,0 +1,408 @@
+// packs rectangle sets with each of msdf-atlasgen's packers and prints how
+// long that took, how much memory it needed and how well the boxes filled
+// the texture as CSV, one row per set and packer, to keep track of the
+// packers over time. the sets are the tiles of real fonts at several char
+// heights, measured the way msdf-atlasgen does, and synthetic ones drawn
+// from a few size distributions. the same options always give the same
+// sets
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <boost/program_options.hpp>
+
+#include "msdfgen.h"
+#include "msdfgen-ext.h"
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "alloc.h"
+#include "atlas.h"
+#include "box.h"
+#include "packing.h"
+
+struct bench_settings {
+	std::vector< std::string > fonts;
+	std::string charset;
+	std::vector< size_t > char_heights;
+	size_t smoothpixels;
+	size_t spacing;
+	// boxes in each synthetic set
+	size_t num_boxes;
+	size_t width;
+	std::vector< packer_kind > packers;
+	// also run every packer with rotation
+	bool rotate;
+	// each packing is timed this many times and the fastest counts
+	size_t repeat;
+	uint32_t seed;
+};
+
+struct rect_set {
+	std::string name;
+	std::vector< box< size_t > > boxes;
+};
+
+namespace po = boost::program_options;
+
+// "16,32,64"
+static bool parse_list( const std::string& str, std::vector< size_t >& values ) {
+	std::istringstream stream( str );
+	size_t value;
+	while( stream >> value ) {
+		values.push_back( value );
+		if( stream.peek() == ',' ) {
+			stream.get();
+		}
+		else {
+			break;
+		}
+	}
+	return !values.empty() && stream.peek() == std::char_traits< char >::eof();
+}
+
+// "32-126,0xa0,0x4e00-0x9fff", like msdf-atlasgen's --charset
+static bool parse_ranges( const std::string& str, std::vector< uint32_t >& ids ) {
+	const char* cursor = str.c_str();
+	while( *cursor != '\0' ) {
+		char* end;
+		uint32_t first = strtoul( cursor, &end, 0 );
+		uint32_t last = first;
+		if( end == cursor ) return false;
+		cursor = end;
+
+		if( *cursor == '-' ) {
+			++cursor;
+			last = strtoul( cursor, &end, 0 );
+			if( end == cursor || last < first ) return false;
+			cursor = end;
+		}
+
+		for( uint32_t i = first; i <= last && i >= first; ++i ) {
+			ids.push_back( i );
+		}
+
+		if( *cursor == ',' ) {
+			++cursor;
+		}
+		else if( *cursor != '\0' ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static const char* packer_name( packer_kind packer ) {
+	switch( packer ) {
+		case Packer_MaxRects: return "maxrects";
+		case Packer_Skyline: return "skyline";
+		case Packer_Portfolio: return "portfolio";
+	}
+	return "";
+}
+
+bool parse_options( int argc, char* argv[], bench_settings& cfg ) {
+	std::string char_heights, packers;
+
+	po::options_description desc( "Allowed options" );
+	desc.add_options()
+		("help", "produce help message")
+		("font,F",          po::value< std::vector< std::string > >(&cfg.fonts)->multitoken(), "fonts whose tiles make up the real world sets")
+		("charset,C",       po::value< std::string >(&cfg.charset)->default_value("0-0x24f"), "codepoints to take from every font as ranges, e.g. 32-126,0xa0-0xff")
+		("char-heights",    po::value< std::string >(&char_heights)->default_value("16,32,64"), "char heights to measure the fonts at")
+		("smooth-pixels",   po::value< size_t >(&cfg.smoothpixels)->default_value(2), "smoothing pixels around every font tile")
+		("spacing",         po::value< size_t >(&cfg.spacing)->default_value(2), "inter-character spacing in texels")
+		("boxes,n",         po::value< size_t >(&cfg.num_boxes)->default_value(2000), "boxes in every synthetic set, 0 for none")
+		("width,W",         po::value< size_t >(&cfg.width)->default_value(2048), "texture width. the height is whatever the boxes need")
+		("packers",         po::value< std::string >(&packers)->default_value("maxrects,skyline,portfolio"), "packers to run, out of maxrects, skyline and portfolio")
+		("rotate",          po::bool_switch(&cfg.rotate), "also run every packer with tiles allowed to turn 90 degrees")
+		("repeat,r",        po::value< size_t >(&cfg.repeat)->default_value(3), "times to run every packing, the fastest counts")
+		("seed",            po::value< uint32_t >(&cfg.seed)->default_value(1), "random seed for the synthetic sets")
+		;
+
+	po::positional_options_description positional;
+	positional.add( "font", -1 );
+
+	po::variables_map vm;
+	po::store( po::command_line_parser( argc, argv ).options( desc ).positional( positional ).run(), vm );
+
+	if( vm.count( "help" ) ) {
+		desc.print( std::cout );
+		return false;
+	}
+	po::notify( vm );
+
+	if( !parse_list( char_heights, cfg.char_heights ) || std::count( cfg.char_heights.begin(), cfg.char_heights.end(), 0 ) > 0 ) {
+		std::cout << "bad char heights \"" << char_heights << "\".\n";
+		return false;
+	}
+
+	std::istringstream stream( packers );
+	std::string name;
+	while( std::getline( stream, name, ',' ) ) {
+		if( name == "maxrects" ) cfg.packers.push_back( Packer_MaxRects );
+		else if( name == "skyline" ) cfg.packers.push_back( Packer_Skyline );
+		else if( name == "portfolio" ) cfg.packers.push_back( Packer_Portfolio );
+		else {
+			std::cout << "unknown packer \"" << name << "\".\n";
+			return false;
+		}
+	}
+	if( cfg.packers.empty() ) {
+		std::cout << "--packers needs at least one packer\n";
+		return false;
+	}
+
+	if( cfg.width < 64 || cfg.repeat < 1 ) {
+		std::cout << "--width has to be at least 64 and --repeat at least 1\n";
+		return false;
+	}
+
+	return true;
+}
+
+// the font's tiles at every char height, sized like msdf-atlasgen's
+// measure_charset: the tallest glyph gets char height texels, plus the
+// smoothing pixels on every side. blank glyphs don't get tiles
+static bool font_sets( msdfgen::FreetypeHandle* ft, const std::string& path, const bench_settings& cfg, std::vector< rect_set >& sets ) {
+	msdfgen::FontHandle* font = msdfgen::loadFont( ft, path.c_str() );
+	if( font == NULL ) {
+		std::cout << "error: couldn't load \"" << path << "\".\n";
+		return false;
+	}
+
+	std::vector< uint32_t > ids;
+	parse_ranges( cfg.charset, ids );
+
+	std::vector< box< double > > bboxes;
+	double maxheight = 0;
+	for( uint32_t id : ids ) {
+		msdfgen::Shape shape;
+		if( FT_Get_Char_Index( font->face, id ) == 0 || !msdfgen::loadGlyph( shape, font, id ) || shape.contours.empty() ) {
+			continue;
+		}
+		double l = 500000, b = 500000, r = -500000, t = -500000;
+		shape.bounds( l, b, r, t );
+		if( r > l ) {
+			bboxes.push_back( box< double >{ l, b, r - l, t - b } );
+			maxheight = std::max( maxheight, t - b );
+		}
+	}
+	msdfgen::destroyFont( font );
+
+	std::string base = path.substr( path.find_last_of( "/\\" ) + 1 );
+	for( size_t char_height : cfg.char_heights ) {
+		rect_set set;
+		set.name = base + "@" + std::to_string( char_height );
+		double scaling = double( char_height ) / maxheight;
+		for( const box< double >& bbox : bboxes ) {
+			set.boxes.push_back( box< size_t >{ 0, 0, size_t( ceil( bbox.width * scaling ) ) + 2 * cfg.smoothpixels, size_t( ceil( bbox.height * scaling ) ) + 2 * cfg.smoothpixels } );
+		}
+		sets.push_back( set );
+	}
+	return true;
+}
+
+// rng() % n rather than the std distributions, whose output differs
+// between standard libraries
+static size_t between( std::mt19937& rng, size_t lo, size_t hi ) {
+	return lo + rng() % ( hi - lo + 1 );
+}
+
+// uniform: widths and heights evenly spread from 8 to 64, like a mixed
+// bag of icons. cjk: near squares of 36 to 40, like ideographs at char
+// height 32. long tail: mostly small boxes, with a pareto distributed few
+// up to a quarter of the texture wide
+static std::vector< rect_set > synthetic_sets( const bench_settings& cfg ) {
+	std::vector< rect_set > sets;
+	if( cfg.num_boxes == 0 ) {
+		return sets;
+	}
+	std::mt19937 rng( cfg.seed );
+
+	rect_set uniform{ "uniform", {} };
+	for( size_t i = 0; i < cfg.num_boxes; ++i ) {
+		uniform.boxes.push_back( box< size_t >{ 0, 0, between( rng, 8, 64 ), between( rng, 8, 64 ) } );
+	}
+	sets.push_back( uniform );
+
+	rect_set cjk{ "cjk", {} };
+	for( size_t i = 0; i < cfg.num_boxes; ++i ) {
+		size_t side = between( rng, 36, 40 );
+		cjk.boxes.push_back( box< size_t >{ 0, 0, side - between( rng, 0, 2 ), side - between( rng, 0, 2 ) } );
+	}
+	sets.push_back( cjk );
+
+	rect_set long_tail{ "long-tail", {} };
+	double max_side = double( cfg.width / 4 );
+	for( size_t i = 0; i < cfg.num_boxes; ++i ) {
+		double u = ( double( rng() ) + 0.5 ) / 4294967296.0;
+		double side = std::min( 8.0 / pow( u, 1 / 1.5 ), max_side );
+		// aspect ratios from 1:2 to 2:1
+		double aspect = double( between( rng, 50, 200 ) ) / 100;
+		size_t width = std::max< size_t >( size_t( std::min( side * sqrt( aspect ), max_side ) ), 1 );
+		size_t height = std::max< size_t >( size_t( std::min( side / sqrt( aspect ), max_side ) ), 1 );
+		long_tail.boxes.push_back( box< size_t >{ 0, 0, width, height } );
+	}
+	sets.push_back( long_tail );
+
+	return sets;
+}
+
+struct pack_result {
+	// the smallest height everything fit into
+	size_t height;
+	// packings it took to find that height
+	size_t trials;
+	double seconds;
+	int64_t peak_bytes;
+};
+
+// packs set once into a bin of pack_cfg's size. seconds and peak_bytes
+// are only set when everything fit
+static bool pack_once( const rect_set& set, const settings& pack_cfg, double& seconds, int64_t& peak_bytes ) {
+	std::vector< std::vector< size_t > > tiers( 1 );
+	for( size_t i = 0; i < set.boxes.size(); ++i ) {
+		tiers[ 0 ].push_back( i );
+	}
+	std::vector< box< size_t > > boxes = set.boxes;
+	std::vector< size_t > channels( boxes.size(), 0 );
+
+	// the peak of a packing is the most bytes live at once on top of what
+	// was live before it started
+	int64_t before = live_allocated_bytes();
+	reset_peak_allocated_bytes();
+	auto start = std::chrono::steady_clock::now();
+	size_t left = pack_boxes( tiers, boxes, channels, pack_cfg, false );
+	seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+	peak_bytes = peak_allocated_bytes() - before;
+	return left == 0;
+}
+
+// finds the lowest cfg.width wide bin the packer gets all of set into,
+// doubling the height from twice the area's lower bound until it fits and
+// then searching down, like --fit-texture with any size. the packing at
+// that height is then timed cfg.repeat times
+static pack_result run_packer( const rect_set& set, packer_kind packer, bool rotate, const bench_settings& cfg ) {
+	size_t area = 0, tallest = 0;
+	for( const box< size_t >& b : set.boxes ) {
+		area += ( b.width + cfg.spacing ) * ( b.height + cfg.spacing );
+		tallest = std::max( tallest, rotate ? std::min( b.width, b.height ) : b.height );
+	}
+
+	settings pack_cfg = settings();
+	pack_cfg.packer = packer;
+	pack_cfg.rotate = rotate;
+	pack_cfg.spacing = cfg.spacing;
+	pack_cfg.tex_dims.width = cfg.width;
+
+	pack_result result = { 0, 0, 0, 0 };
+	double seconds;
+	int64_t peak;
+
+	// lo never fits, hi always does
+	// spaced boxes take up at most ( width + spacing ) * ( height + spacing )
+	size_t lo = std::max( area / ( cfg.width + cfg.spacing ), tallest + cfg.spacing ) - cfg.spacing - 1;
+	size_t hi = 2 * lo + 2;
+	for( ;; ) {
+		pack_cfg.tex_dims.height = hi;
+		++result.trials;
+		if( pack_once( set, pack_cfg, seconds, peak ) ) {
+			break;
+		}
+		lo = hi;
+		hi *= 2;
+	}
+	while( hi - lo > 1 ) {
+		size_t mid = lo + ( hi - lo ) / 2;
+		pack_cfg.tex_dims.height = mid;
+		++result.trials;
+		if( pack_once( set, pack_cfg, seconds, peak ) ) {
+			hi = mid;
+		}
+		else {
+			lo = mid;
+		}
+	}
+
+	result.height = pack_cfg.tex_dims.height = hi;
+	for( size_t run = 0; run < cfg.repeat; ++run ) {
+		pack_once( set, pack_cfg, seconds, peak );
+		if( run == 0 || seconds < result.seconds ) {
+			result.seconds = seconds;
+		}
+		result.peak_bytes = std::max( result.peak_bytes, peak );
+	}
+	return result;
+}
+
+int main( int argc, char* argv[] ) {
+	// from the start, so blocks freed during a packing were counted when
+	// they were allocated
+	enable_allocation_tracking();
+
+	bench_settings cfg;
+	try {
+		if( !parse_options( argc, argv, cfg ) ) {
+			return 0;
+		}
+	} catch( po::error& err ) {
+		std::cout << err.what() << "\n";
+		return 0;
+	}
+
+	std::vector< uint32_t > ids;
+	if( !parse_ranges( cfg.charset, ids ) ) {
+		std::cout << "bad charset \"" << cfg.charset << "\".\n";
+		return 0;
+	}
+
+	std::vector< rect_set > sets;
+	if( !cfg.fonts.empty() ) {
+		msdfgen::FreetypeHandle* ft = msdfgen::initializeFreetype();
+		for( const std::string& path : cfg.fonts ) {
+			if( !font_sets( ft, path, cfg, sets ) ) {
+				return 1;
+			}
+		}
+		msdfgen::deinitializeFreetype( ft );
+	}
+	for( rect_set& set : synthetic_sets( cfg ) ) {
+		sets.push_back( set );
+	}
+
+	// occupancy is the boxes' area without spacing over the area of the
+	// smallest bin they fit into
+	std::cout << "set,boxes,packer,rotate,width,height,occupancy,trials,seconds,peak_bytes\n";
+	for( const rect_set& set : sets ) {
+		size_t area = 0, widest = 0;
+		for( const box< size_t >& b : set.boxes ) {
+			area += b.width * b.height;
+			widest = std::max( widest, b.width );
+		}
+		if( set.boxes.empty() ) {
+			std::cout << "skipping " << set.name << ", it has no boxes.\n";
+			continue;
+		}
+		if( widest > cfg.width ) {
+			std::cout << "skipping " << set.name << ", it has boxes wider than the texture.\n";
+			continue;
+		}
+
+		for( packer_kind packer : cfg.packers ) {
+			for( int rotate = 0; rotate <= int( cfg.rotate ); ++rotate ) {
+				pack_result result = run_packer( set, packer, rotate != 0, cfg );
+				double occupancy = double( area ) / ( double( cfg.width ) * result.height );
+				std::cout << set.name << "," << set.boxes.size() << "," << packer_name( packer ) << "," << rotate << ","
+					<< cfg.width << "," << result.height << "," << occupancy << "," << result.trials << ","
+					<< result.seconds << "," << result.peak_bytes << std::endl;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,263 @@
+// round trips made up fonts through every .msdf reader: the version 2 file
+// through open_spec_view and load_specification, a file as a later version
+// with a bigger header and a section this reader doesn't know could write
+// it, and the version 1 file through load_specification. prints a line per
+// check and fails if any of them did
+//
+// with --blank ids file, checks an msdf-atlasgen output instead: that each
+// of the comma separated ids is in it as a blank glyph, with an advance
+// but no outline
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string.h>
+#include <vector>
+
+#include "spec.h"
+
+static int failures = 0;
+
+static void check( bool ok, const std::string& what ) {
+	std::cout << ( ok ? "ok: " : "FAILED: " ) << what << "\n";
+	if( !ok ) {
+		failures++;
+	}
+}
+
+static Glyph make_glyph( float x, u16 page, u8 channel, u8 rotated ) {
+	Glyph glyph;
+	glyph.bounds = MinMax2( Vec2( -x, -2 * x ), Vec2( 3 * x, 4 * x ) );
+	glyph.uv_bounds = MinMax2( Vec2( x / 8, x / 16 ), Vec2( x / 4, x / 2 ) );
+	glyph.advance = 5 * x;
+	glyph.page = page;
+	glyph.channel = channel;
+	glyph.rotated = rotated;
+	return glyph;
+}
+
+// some glyphs, a zeroed one, and whatever tables flags asks for
+static Font make_font( u32 flags ) {
+	Font font = Font();
+	font.glyph_padding = 0.125f;
+	font.dSDF_dUV = 12.5f;
+	font.ascent = 0.75f;
+	font.flags = flags;
+	font.num_pages = ( flags & FontFlag_Paged ) ? 3 : 1;
+
+	bool rotated = ( flags & FontFlag_Rotated ) != 0;
+	for( u32 i = 0; i < 40; ++i ) {
+		font.glyphs.push_back( i % 7 == 3 ? Glyph() : make_glyph( 0.01f * ( i + 1 ), u16( i % font.num_pages ), u8( i % 4 ), u8( rotated && i % 3 == 0 ) ) );
+	}
+	if( flags & FontFlag_Composites ) {
+		for( u32 i = 0; i < 5; ++i ) {
+			font.component_glyphs.push_back( make_glyph( 0.3f + 0.01f * i, 0, 0, u8( rotated && i % 2 == 0 ) ) );
+		}
+		font.components.push_back( GlyphComponent { 3, 40, Vec2( 0.25f, 0 ) } );
+		font.components.push_back( GlyphComponent { 3, 1, Vec2( -0.5f, 0.125f ) } );
+		font.components.push_back( GlyphComponent { 10, 44, Vec2( 0, 0 ) } );
+	}
+	if( flags & FontFlag_Grid ) {
+		font.grid_first = 32;
+		font.grid_columns = 8;
+		font.grid_cell_uv = MinMax2( Vec2( 0.001f, 0.9f ), Vec2( 0.12f, 0.999f ) );
+		font.grid_pitch_uv = Vec2( 0.125f, -0.1f );
+	}
+	return font;
+}
+
+static bool same( const MinMax2& a, const MinMax2& b ) {
+	return a.mins.x == b.mins.x && a.mins.y == b.mins.y && a.maxs.x == b.maxs.x && a.maxs.y == b.maxs.y;
+}
+
+static bool same( const Glyph& a, const Glyph& b, bool rotated ) {
+	return same( a.bounds, b.bounds ) && same( a.uv_bounds, b.uv_bounds ) && a.advance == b.advance
+		&& a.page == b.page && a.channel == b.channel && ( !rotated || a.rotated == b.rotated );
+}
+
+static bool same( const std::vector< Glyph >& a, const std::vector< Glyph >& b, bool rotated ) {
+	if( a.size() != b.size() ) {
+		return false;
+	}
+	for( size_t i = 0; i < a.size(); ++i ) {
+		if( !same( a[ i ], b[ i ], rotated ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool same( const Font& a, const Font& b ) {
+	if( a.glyph_padding != b.glyph_padding || a.dSDF_dUV != b.dSDF_dUV || a.ascent != b.ascent || a.flags != b.flags || a.num_pages != b.num_pages ) {
+		return false;
+	}
+	bool rotated = ( a.flags & FontFlag_Rotated ) != 0;
+	if( !same( a.glyphs, b.glyphs, rotated ) || !same( a.component_glyphs, b.component_glyphs, rotated ) || a.components.size() != b.components.size() ) {
+		return false;
+	}
+	for( size_t i = 0; i < a.components.size(); ++i ) {
+		const GlyphComponent& x = a.components[ i ];
+		const GlyphComponent& y = b.components[ i ];
+		if( x.glyph != y.glyph || x.component != y.component || x.offset.x != y.offset.x || x.offset.y != y.offset.y ) {
+			return false;
+		}
+	}
+	if( a.flags & FontFlag_Grid ) {
+		return a.grid_first == b.grid_first && a.grid_columns == b.grid_columns && same( a.grid_cell_uv, b.grid_cell_uv )
+			&& a.grid_pitch_uv.x == b.grid_pitch_uv.x && a.grid_pitch_uv.y == b.grid_pitch_uv.y;
+	}
+	return true;
+}
+
+// what the view points at, to compare against the font it was written from
+static Font font_from_view( const SpecView& view ) {
+	Font font = Font();
+	font.glyph_padding = view.header->glyph_padding;
+	font.dSDF_dUV = view.header->dSDF_dUV;
+	font.ascent = view.header->ascent;
+	font.flags = view.header->flags;
+	font.num_pages = view.header->num_pages;
+
+	auto glyph = []( const SpecGlyph& spec ) {
+		Glyph glyph;
+		glyph.bounds = MinMax2( Vec2( spec.bounds.mins.x, spec.bounds.mins.y ), Vec2( spec.bounds.maxs.x, spec.bounds.maxs.y ) );
+		glyph.uv_bounds = MinMax2( Vec2( spec.uv_bounds.mins.x, spec.uv_bounds.mins.y ), Vec2( spec.uv_bounds.maxs.x, spec.uv_bounds.maxs.y ) );
+		glyph.advance = spec.advance;
+		glyph.page = spec.page;
+		glyph.channel = spec.channel;
+		glyph.rotated = spec.rotated;
+		return glyph;
+	};
+	for( uint32_t i = 0; i < view.num_glyphs; ++i ) {
+		font.glyphs.push_back( glyph( view.glyphs[ i ] ) );
+	}
+	for( uint32_t i = 0; i < view.num_component_glyphs; ++i ) {
+		font.component_glyphs.push_back( glyph( view.component_glyphs[ i ] ) );
+	}
+	for( uint32_t i = 0; i < view.num_components; ++i ) {
+		const SpecComponent& spec = view.components[ i ];
+		font.components.push_back( GlyphComponent { spec.glyph, spec.component, Vec2( spec.offset.x, spec.offset.y ) } );
+	}
+	if( view.grid != NULL ) {
+		font.grid_first = view.grid->first;
+		font.grid_columns = view.grid->columns;
+		font.grid_cell_uv = MinMax2( Vec2( view.grid->cell_uv.mins.x, view.grid->cell_uv.mins.y ), Vec2( view.grid->cell_uv.maxs.x, view.grid->cell_uv.maxs.y ) );
+		font.grid_pitch_uv = Vec2( view.grid->pitch_uv.x, view.grid->pitch_uv.y );
+	}
+	return font;
+}
+
+static size_t align( size_t offset ) {
+	return ( offset + SpecAlignment - 1 ) / SpecAlignment * SpecAlignment;
+}
+
+// the same file as a later version would write it: the header grows by 16
+// bytes and there's a section with a tag nobody knows ahead of the others
+static std::vector< char > as_later_version( const std::vector< char >& file ) {
+	SpecHeader header;
+	memcpy( &header, file.data(), sizeof( header ) );
+	std::vector< SpecSection > sections( header.num_sections );
+	memcpy( sections.data(), file.data() + header.sections_offset, sections.size() * sizeof( SpecSection ) );
+
+	const size_t header_size = sizeof( SpecHeader ) + 16;
+	sections.insert( sections.begin(), SpecSection { SpecTag( 'N', 'E', 'X', 'T' ), 0, 3, 8 } );
+	size_t offset = align( header_size + sections.size() * sizeof( SpecSection ) );
+
+	std::vector< char > data;
+	for( SpecSection& section : sections ) {
+		size_t size = size_t( section.count ) * section.element_size;
+		data.resize( offset + size, 0x55 );
+		if( section.offset != 0 ) {
+			memcpy( data.data() + offset, file.data() + section.offset, size );
+		}
+		section.offset = u32( offset );
+		offset = align( offset + size );
+	}
+	data.resize( offset, 0 );
+
+	header.version = SpecVersion + 1;
+	header.header_size = u16( header_size );
+	header.file_size = u32( data.size() );
+	header.num_sections = u32( sections.size() );
+	header.sections_offset = u32( header_size );
+	memcpy( data.data(), &header, sizeof( header ) );
+	memset( data.data() + sizeof( header ), 0x77, header_size - sizeof( header ) );
+	memcpy( data.data() + header_size, sections.data(), sections.size() * sizeof( SpecSection ) );
+	return data;
+}
+
+static std::vector< char > as_version_1( const Font& font ) {
+	std::vector< char > data( 64 * 1024 );
+	SerializationBuffer buf( SerializationMode_Serializing, data.data(), data.size() );
+	Serialize( &buf, const_cast< Font& >( font ) );
+	data.resize( buf.error ? 0 : buf.cursor - data.data() );
+	return data;
+}
+
+static bool load_from_file( const std::vector< char >& data, const std::string& path, Font& font ) {
+	{
+		std::ofstream file( path, std::ios::out | std::ios::binary | std::ios::trunc );
+		file.write( data.data(), data.size() );
+		if( !file ) {
+			return false;
+		}
+	}
+	bool ok = load_specification( path, font );
+	remove( path.c_str() );
+	return ok;
+}
+
+static void check_font( const std::string& name, const Font& font, const std::string& path ) {
+	// vector data comes from operator new, aligned enough for the view
+	std::vector< char > file = serialize_specification( font );
+	SpecView view;
+	check( open_spec_view( file.data(), file.size(), view ) && same( font_from_view( view ), font ), name + ": version 2 through open_spec_view" );
+
+	Font loaded;
+	check( load_from_file( file, path, loaded ) && same( loaded, font ), name + ": version 2 through load_specification" );
+
+	std::vector< char > later = as_later_version( file );
+	check( open_spec_view( later.data(), later.size(), view ) && same( font_from_view( view ), font ), name + ": later version through open_spec_view" );
+
+	std::vector< char > old = as_version_1( font );
+	check( !old.empty() && load_from_file( old, path, loaded ) && same( loaded, font ), name + ": version 1 through load_specification" );
+
+	std::vector< char > truncated( file.begin(), file.end() - 1 );
+	check( !open_spec_view( truncated.data(), truncated.size(), view ), name + ": truncated file rejected" );
+}
+
+static void check_blank( const std::string& ids, const std::string& path ) {
+	Font font;
+	if( !load_specification( path, font ) ) {
+		check( false, "loading " + path );
+		return;
+	}
+
+	std::istringstream stream( ids );
+	std::string id;
+	while( std::getline( stream, id, ',' ) ) {
+		size_t i = std::stoul( id, NULL, 0 );
+		bool blank = i < font.glyphs.size() && font.glyphs[ i ].advance != 0 && same( font.glyphs[ i ].bounds, MinMax2( Vec2( 0 ), Vec2( 0 ) ) );
+		check( blank, path + ": glyph " + id + " is blank" );
+	}
+}
+
+int main( int argc, char** argv ) {
+	if( argc == 4 && std::string( argv[ 1 ] ) == "--blank" ) {
+		check_blank( argv[ 2 ], argv[ 3 ] );
+		return failures == 0 ? 0 : 1;
+	}
+
+	// scratch file for the loaders, which only read from disk
+	std::string path = argc > 1 ? argv[ 1 ] : "msdf-speccheck.msdf";
+
+	check_font( "plain", make_font( 0 ), path );
+	check_font( "paged channel packed", make_font( FontFlag_Paged | FontFlag_ChannelPacked ), path );
+	check_font( "composites rotated", make_font( FontFlag_Composites | FontFlag_Rotated ), path );
+	check_font( "grid", make_font( FontFlag_Grid | FontFlag_GlyphIndexed ), path );
+	check_font( "everything", make_font( FontFlag_Paged | FontFlag_Composites | FontFlag_Grid | FontFlag_Rotated ), path );
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+# a font that maps neither space nor tab still gets them as blank glyphs,
+# and not as a second copy of .notdef. run by ctest with the tools' paths
+# in FONTGEN, ATLASGEN and SPECCHECK and a scratch directory in WORK
+
+file(MAKE_DIRECTORY "${WORK}")
+
+execute_process(COMMAND "${FONTGEN}" -O "${WORK}/font.ttf" --glyphs 20 RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "msdf-fontgen failed")
+endif()
+
+execute_process(COMMAND "${ATLASGEN}" -F "${WORK}/font.ttf" -O "${WORK}/atlas" -C 9,32,0x4e00-0x4e10 -T 256x256 RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "msdf-atlasgen failed")
+endif()
+
+execute_process(COMMAND "${SPECCHECK}" --blank 9,32 "${WORK}/atlas.msdf" RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "space or tab isn't a blank glyph")
+endif()